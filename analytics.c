@@ -0,0 +1,289 @@
+#include "prose_code.h"
+
+/* ── Writing analytics ──
+ * Each document keeps one record per paragraph (a run of non-blank
+ * lines) with its word, sentence and syllable counts, sorted by start.
+ * The edit hook widens an edit to the paragraphs around it, measures
+ * those again and splices them over the old records, shifting the rest;
+ * the totals follow from the records that changed. A paragraph that
+ * keeps growing past ANALYTICS_MAX_SPAN around an edit is not prose, so
+ * the document stops being tracked until its text is replaced.
+ *
+ * Word deltas from documents the user is editing also go into a ring of
+ * timestamped samples, coalesced per ANALYTICS_SAMPLE_MS, which the
+ * stats screen reads as a typing-rate timeline. */
+
+#define ANALYTICS_MAX_SPAN  65536
+#define ANALYTICS_RING      720      /* an hour at one sample per 5 s */
+#define ANALYTICS_SAMPLE_MS 5000
+
+typedef struct {
+    DWORD tick;
+    int words;
+} TypingSample;
+
+static TypingSample g_typing[ANALYTICS_RING];
+static int g_typing_head;   /* next slot to write */
+static int g_typing_count;
+
+/* ── Measuring ── */
+
+static int is_vowel(wchar_t c) {
+    return c == L'a' || c == L'e' || c == L'i' || c == L'o' || c == L'u' || c == L'y';
+}
+
+/* Vowel groups, less a silent final e ("make" but not "table") */
+static int syllables(const wchar_t *w, bpos n) {
+    int count = 0, prev = 0;
+    for (bpos i = 0; i < n; i++) {
+        int v = is_vowel(ch_fold(w[i]));
+        count += v && !prev;
+        prev = v;
+    }
+    if (count > 1 && n >= 3 && ch_fold(w[n - 1]) == L'e' &&
+        !(ch_fold(w[n - 2]) == L'l' && !is_vowel(ch_fold(w[n - 3]))))
+        count--;
+    return count ? count : 1;
+}
+
+static int is_word_char(wchar_t c) {
+    return ch_isalpha(c) || c == L'\'' || c == L'-';
+}
+
+/* A sentence ends at a run of . ! ? after a word, unless a letter or
+ * digit follows ("3.5", "e.g" mid-word). An unterminated tail counts. */
+static void para_measure(const wchar_t *t, bpos n, ParaStats *ps) {
+    int words = 0, sentences = 0, syl = 0, open = 0;
+    bpos i = 0;
+    while (i < n) {
+        wchar_t c = t[i];
+        if (is_word_char(c)) {
+            bpos ws = i;
+            int letters = 0;
+            while (i < n && is_word_char(t[i])) letters += ch_isalpha(t[i++]) != 0;
+            if (letters) {
+                words++;
+                syl += syllables(t + ws, i - ws);
+                open = 1;
+            }
+            continue;
+        }
+        if ((c == L'.' || c == L'!' || c == L'?') && open) {
+            while (i < n && (t[i] == L'.' || t[i] == L'!' || t[i] == L'?')) i++;
+            if (i >= n || !ch_isalnum(t[i])) { sentences++; open = 0; }
+            continue;
+        }
+        i++;
+    }
+    ps->words = words;
+    ps->sentences = sentences + open;
+    ps->syllables = syl;
+}
+
+/* Paragraph records for text[0..n), which starts at base */
+static int para_split(const wchar_t *t, bpos n, bpos base, ParaStats **out) {
+    ParaStats *v = NULL;
+    int count = 0, cap = 0;
+    bpos ps = -1, pe = 0;
+    for (bpos ls = 0; ls <= n; ) {
+        bpos le = ls;
+        int blank = 1;
+        while (le < n && t[le] != L'\n') blank &= ch_isspace(t[le++]) != 0;
+        if (!blank) {
+            if (ps < 0) ps = ls;
+            pe = le;
+        }
+        if ((blank || le >= n) && ps >= 0) {
+            if (count == cap) {
+                cap = cap ? cap * 2 : 8;
+                ParaStats *nv = (ParaStats *)realloc(v, cap * sizeof(ParaStats));
+                if (!nv) { free(v); return -1; }
+                v = nv;
+            }
+            ParaStats *p = &v[count++];
+            p->start = base + ps;
+            p->len = pe - ps;
+            para_measure(t + ps, pe - ps, p);
+            ps = -1;
+        }
+        ls = le + 1;
+    }
+    *out = v;
+    return count;
+}
+
+/* ── Paragraph bounds in the buffer ── */
+
+static int line_blank(GapBuffer *gb, bpos ls, bpos le) {
+    for (bpos i = ls; i < le; i++) {
+        if (!ch_isspace(gb_char_at(gb, i))) return 0;
+    }
+    return 1;
+}
+
+/* Start of the paragraph holding pos, spending *budget per character */
+static bpos para_start(GapBuffer *gb, bpos pos, bpos *budget) {
+    bpos s = pos;
+    while (s > 0 && gb_char_at(gb, s - 1) != L'\n') s--;
+    *budget -= pos - s;
+    while (s > 0 && *budget >= 0) {
+        bpos p = s - 1;
+        while (p > 0 && gb_char_at(gb, p - 1) != L'\n') p--;
+        *budget -= s - p;
+        if (line_blank(gb, p, s - 1)) break;
+        s = p;
+    }
+    return s;
+}
+
+static bpos para_end(GapBuffer *gb, bpos pos, bpos len, bpos *budget) {
+    bpos e = pos;
+    while (e < len && gb_char_at(gb, e) != L'\n') e++;
+    *budget -= e - pos;
+    while (e < len && *budget >= 0) {
+        bpos p = e + 1;
+        while (p < len && gb_char_at(gb, p) != L'\n') p++;
+        *budget -= p - e;
+        if (line_blank(gb, e + 1, p)) break;
+        e = p;
+    }
+    return e;
+}
+
+/* ── Records ── */
+
+/* First record ending at or after pos */
+static int para_lower_bound(const DocAnalytics *an, bpos pos) {
+    int lo = 0, hi = an->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (an->paras[mid].start + an->paras[mid].len < pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void analytics_clear(DocAnalytics *an) {
+    free(an->paras);
+    an->paras = NULL;
+    an->count = an->cap = 0;
+    an->words = an->sentences = an->syllables = 0;
+}
+
+void analytics_free(DocAnalytics *an) {
+    analytics_clear(an);
+}
+
+static void typing_push(int words) {
+    DWORD now = GetTickCount();
+    if (g_typing_count > 0) {
+        TypingSample *last = &g_typing[(g_typing_head + ANALYTICS_RING - 1) % ANALYTICS_RING];
+        if (now - last->tick < ANALYTICS_SAMPLE_MS) {
+            last->words += words;
+            return;
+        }
+    }
+    g_typing[g_typing_head].tick = now;
+    g_typing[g_typing_head].words = words;
+    g_typing_head = (g_typing_head + 1) % ANALYTICS_RING;
+    if (g_typing_count < ANALYTICS_RING) g_typing_count++;
+}
+
+void analytics_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted) {
+    DocAnalytics *an = &doc->analytics;
+    GapBuffer *gb = &doc->gb;
+    if (!gb->buf) {
+        /* gb_free: new text is not typing until the next baseline */
+        analytics_clear(an);
+        an->off = 0;
+        an->live = 0;
+        return;
+    }
+    if (an->off) return;
+
+    bpos len = gb_length(gb);
+    bpos delta = inserted - removed;
+    bpos budget = ANALYTICS_MAX_SPAN;
+    bpos s = para_start(gb, pos, &budget);
+    bpos e = para_end(gb, pos + inserted, len, &budget);
+    if (budget < 0) {
+        analytics_clear(an);
+        an->off = 1;
+        return;
+    }
+
+    /* Old records in [a, b) touch [s, e) in pre-edit coordinates */
+    int a = para_lower_bound(an, s);
+    int b = a;
+    while (b < an->count && an->paras[b].start <= e - delta) b++;
+    if (a < b) {
+        if (an->paras[a].start < s) s = an->paras[a].start;
+        bpos old_end = an->paras[b - 1].start + an->paras[b - 1].len;
+        if (old_end >= pos + removed && old_end + delta > e) e = old_end + delta;
+    }
+
+    ParaStats *fresh = NULL;
+    int k = 0;
+    if (e > s) {
+        wchar_t *text = gb_extract_alloc(gb, s, e - s);
+        k = text ? para_split(text, e - s, s, &fresh) : -1;
+        free(text);
+    }
+    int total = k < 0 ? -1 : an->count - (b - a) + k;
+    if (total > an->cap) {
+        int ncap = an->cap ? an->cap : 64;
+        while (ncap < total) ncap *= 2;
+        ParaStats *np = (ParaStats *)realloc(an->paras, ncap * sizeof(ParaStats));
+        if (np) { an->paras = np; an->cap = ncap; }
+        else total = -1;
+    }
+    if (total < 0) {
+        free(fresh);
+        analytics_clear(an);
+        an->off = 1;
+        return;
+    }
+
+    bpos words_before = an->words;
+    for (int i = a; i < b; i++) {
+        an->words -= an->paras[i].words;
+        an->sentences -= an->paras[i].sentences;
+        an->syllables -= an->paras[i].syllables;
+    }
+    if (b < an->count)   /* paras may still be NULL when there is no tail */
+        memmove(an->paras + a + k, an->paras + b, (an->count - b) * sizeof(ParaStats));
+    for (int i = a + k; i < total; i++) an->paras[i].start += delta;
+    for (int i = 0; i < k; i++) {
+        an->paras[a + i] = fresh[i];
+        an->words += fresh[i].words;
+        an->sentences += fresh[i].sentences;
+        an->syllables += fresh[i].syllables;
+    }
+    an->count = total;
+    free(fresh);
+
+    if (an->live && !doc->is_results && an->words != words_before)
+        typing_push((int)(an->words - words_before));
+}
+
+/* ── Reporting ── */
+
+/* Flesch reading ease: higher is easier, 60-70 is plain English */
+double analytics_reading_ease(bpos words, bpos sentences, bpos syllables) {
+    if (words <= 0 || sentences <= 0) return 0.0;
+    return 206.835 - 1.015 * ((double)words / (double)sentences)
+                   - 84.6 * ((double)syllables / (double)words);
+}
+
+/* Net words typed in each of the last n buckets of bucket_ms, oldest
+ * first */
+void analytics_timeline(int *words, int n, DWORD bucket_ms) {
+    DWORD now = GetTickCount();
+    memset(words, 0, n * sizeof(int));
+    for (int i = 0; i < g_typing_count; i++) {
+        const TypingSample *t = &g_typing[(g_typing_head + ANALYTICS_RING - 1 - i) % ANALYTICS_RING];
+        DWORD age = (now - t->tick) / bucket_ms;
+        if (age >= (DWORD)n) break;
+        words[n - 1 - age] += t->words;
+    }
+}
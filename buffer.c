@@ -31,12 +31,15 @@ void gb_init(GapBuffer *gb, bpos initial_cap) {
     if (!gb->buf) { gb->total = 0; }
     gb->gap_start = 0;
     gb->gap_end = gb->total;
+    gb->mutation++;
 }
 
 void gb_free(GapBuffer *gb) {
+    bpos old_len = gb_length(gb);
     free(gb->buf);
     gb->buf = NULL;
     gb->total = gb->gap_start = gb->gap_end = 0;
+    if (gb->on_edit && old_len > 0) gb->on_edit(gb->edit_ctx, 0, old_len, 0);
 }
 
 bpos gb_length(GapBuffer *gb) {
@@ -93,6 +96,7 @@ void gb_insert(GapBuffer *gb, bpos pos, const wchar_t *text, bpos len) {
     memcpy(gb->buf + gb->gap_start, text, len * sizeof(wchar_t));
     gb->gap_start += len;
     gb->mutation++;
+    if (gb->on_edit) gb->on_edit(gb->edit_ctx, pos, 0, len);
 }
 
 void gb_delete(GapBuffer *gb, bpos pos, bpos len) {
@@ -106,6 +110,25 @@ void gb_delete(GapBuffer *gb, bpos pos, bpos len) {
     gb->gap_end += len;
     if (gb->gap_end > gb->total) gb->gap_end = gb->total;
     gb->mutation++;
+    if (gb->on_edit) gb->on_edit(gb->edit_ctx, pos, len, 0);
+}
+
+/* Writing straight into the buffer: reserve room for len units after the
+ * text, fill some of it, then commit them as one insert at the end. */
+wchar_t *gb_append_reserve(GapBuffer *gb, bpos len) {
+    /* Repeated appends (a followed log) grow the buffer geometrically */
+    if (gb->gap_end - gb->gap_start < len) gb_grow(gb, len + gb->total / 2);
+    if (gb->gap_end - gb->gap_start < len) return NULL;
+    gb_move_gap(gb, gb_length(gb));
+    return gb->buf + gb->gap_start;
+}
+
+void gb_append_commit(GapBuffer *gb, bpos len) {
+    if (len <= 0) return;
+    bpos pos = gb->gap_start;
+    gb->gap_start += len;
+    gb->mutation++;
+    if (gb->on_edit) gb->on_edit(gb->edit_ctx, pos, 0, len);
 }
 
 void gb_copy_range(GapBuffer *gb, bpos start, bpos len, wchar_t *dst) {
@@ -190,6 +213,32 @@ void lc_rebuild(LineCache *lc, GapBuffer *gb) {
     lc->dirty = 0;
 }
 
+/* Takes ownership of line start offsets built elsewhere */
+void lc_adopt(LineCache *lc, bpos *offsets, bpos count, bpos capacity) {
+    free(lc->offsets);
+    lc->offsets = offsets;
+    lc->count = count;
+    lc->capacity = capacity;
+    lc->dirty = 0;
+}
+
+/* Adds the line starts of text appended at the end; 0 if the cache is
+ * stale or could not grow */
+int lc_notify_append(LineCache *lc, const bpos *starts, bpos count) {
+    if (lc->dirty) return 0;
+    if (lc->count + count > lc->capacity) {
+        bpos new_cap = lc->capacity ? lc->capacity : 1024;
+        while (new_cap < lc->count + count) new_cap *= 2;
+        bpos *tmp = (bpos *)realloc(lc->offsets, new_cap * sizeof(bpos));
+        if (!tmp) return 0;
+        lc->offsets = tmp;
+        lc->capacity = new_cap;
+    }
+    memcpy(lc->offsets + lc->count, starts, count * sizeof(bpos));
+    lc->count += count;
+    return 1;
+}
+
 bpos lc_line_of(LineCache *lc, bpos pos) {
     bpos lo = 0, hi = lc->count - 1;
     while (lo < hi) {
@@ -300,9 +349,8 @@ void wc_push(WrapCache *wc, bpos pos, bpos line) {
     wc->count++;
 }
 
-void wc_rebuild(WrapCache *wc, GapBuffer *gb, LineCache *lc, int wrap_col) {
-    wc->count = 0;
-    wc->wrap_col = wrap_col;
+/* Wraps logical lines from `first` to the end */
+static void wc_wrap_lines(WrapCache *wc, GapBuffer *gb, LineCache *lc, bpos first, int wrap_col) {
     if (wrap_col <= 0) wrap_col = 80;
 
     wchar_t *buf = gb->buf;
@@ -310,7 +358,7 @@ void wc_rebuild(WrapCache *wc, GapBuffer *gb, LineCache *lc, int wrap_col) {
     bpos goff = gb->gap_end - gb->gap_start;
     #define WC_CHAR(pos) (buf[(pos) < gs ? (pos) : (pos) + goff])
 
-    for (bpos ln = 0; ln < lc->count; ln++) {
+    for (bpos ln = first; ln < lc->count; ln++) {
         bpos ls = lc->offsets[ln];
         bpos le = (ln + 1 < lc->count) ? lc->offsets[ln + 1] - 1 : gb_length(gb);
         bpos line_len = le - ls;
@@ -356,6 +404,19 @@ void wc_rebuild(WrapCache *wc, GapBuffer *gb, LineCache *lc, int wrap_col) {
     #undef WC_CHAR
 }
 
+void wc_rebuild(WrapCache *wc, GapBuffer *gb, LineCache *lc, int wrap_col) {
+    wc->count = 0;
+    wc->wrap_col = wrap_col;
+    wc_wrap_lines(wc, gb, lc, 0, wrap_col);
+}
+
+/* After text was appended: wraps logical line `from`, which the text may
+ * have lengthened, and every line after it again */
+void wc_extend(WrapCache *wc, GapBuffer *gb, LineCache *lc, bpos from) {
+    while (wc->count > 0 && wc->entries[wc->count - 1].line >= from) wc->count--;
+    wc_wrap_lines(wc, gb, lc, from, wc->wrap_col);
+}
+
 bpos wc_visual_line_of(WrapCache *wc, bpos pos) {
     if (wc->count == 0) return 0;
     bpos lo = 0, hi = wc->count - 1;
@@ -0,0 +1,56 @@
+/*
+ * chartab.h — Table-driven case folding and character classes
+ * Portable C with no Win32 dependencies; tables are generated into
+ * chartab.c by tools/gen_chartab.py and cover the whole BMP.
+ *
+ * These replace towlower/isw* in hot loops: each lookup is two array
+ * reads instead of a CRT call.
+ */
+#ifndef PROSE_CHARTAB_H
+#define PROSE_CHARTAB_H
+
+#include <stddef.h>
+#include <wchar.h>
+
+#define CH_ALPHA  0x01   /* letters and combining marks */
+#define CH_DIGIT  0x02   /* decimal digits (Nd) */
+#define CH_UPPER  0x04
+#define CH_LOWER  0x08
+#define CH_SPACE  0x10
+#define CH_XDIGIT 0x20   /* ASCII hex digits */
+
+extern const unsigned char  ch_fold_index[256];
+extern const unsigned short ch_fold_blocks[][256];
+extern const unsigned char  ch_class_index[256];
+extern const unsigned char  ch_class_blocks[][256];
+
+static inline unsigned ch_class(wchar_t c) {
+#if WCHAR_MAX > 0xFFFF
+    if ((unsigned)c > 0xFFFF) return 0;
+#endif
+    unsigned u = (unsigned short)c;
+    return ch_class_blocks[ch_class_index[u >> 8]][u & 0xFF];
+}
+
+/* Simple case fold: equal after folding means equal ignoring case. */
+static inline wchar_t ch_fold(wchar_t c) {
+#if WCHAR_MAX > 0xFFFF
+    if ((unsigned)c > 0xFFFF) return c;
+#endif
+    unsigned u = (unsigned short)c;
+    return (wchar_t)(unsigned short)(u + ch_fold_blocks[ch_fold_index[u >> 8]][u & 0xFF]);
+}
+
+static inline int ch_isalpha(wchar_t c)  { return (ch_class(c) & CH_ALPHA) != 0; }
+static inline int ch_isdigit(wchar_t c)  { return (ch_class(c) & CH_DIGIT) != 0; }
+static inline int ch_isalnum(wchar_t c)  { return (ch_class(c) & (CH_ALPHA | CH_DIGIT)) != 0; }
+static inline int ch_isupper(wchar_t c)  { return (ch_class(c) & CH_UPPER) != 0; }
+static inline int ch_islower(wchar_t c)  { return (ch_class(c) & CH_LOWER) != 0; }
+static inline int ch_isspace(wchar_t c)  { return (ch_class(c) & CH_SPACE) != 0; }
+static inline int ch_isxdigit(wchar_t c) { return (ch_class(c) & CH_XDIGIT) != 0; }
+
+/* Fold n units from src into dst (which may equal src). ASCII runs are
+ * folded eight units at a time where SSE2 is available. */
+void ch_fold_run(const wchar_t *src, wchar_t *dst, ptrdiff_t n);
+
+#endif /* PROSE_CHARTAB_H */
@@ -0,0 +1,755 @@
+/*
+ * dict.c — Spelling dictionary loader and DAWG
+ *
+ * Dictionary words, with their affixed forms expanded, are folded,
+ * sorted and fed to the incremental construction for sorted input
+ * (Daciuk et al.). When the next word leaves part of the previous
+ * word's path, that part is minimised bottom-up against a register of
+ * finished nodes, so shared endings ("-ing", "-ness", plurals) are
+ * stored once. The automaton is then flattened breadth-first into three
+ * arrays, and a lookup is one short binary search per character.
+ */
+#include "dict.h"
+#include "chartab.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DICT_MAX_AFFIX  32
+#define DICT_MAX_FLAGS  64
+#define DICT_MAX_FIELDS 8
+
+struct Dict {
+    unsigned *first;     /* node n: edges [first[n] >> 1, first[n + 1] >> 1); low bit = final */
+    wchar_t  *label;     /* edge characters, ascending within a node */
+    unsigned *target;
+    size_t nodes;
+    ptrdiff_t words;
+};
+
+/* ── Decoding ── */
+
+/* Raw bytes to wide text: UTF-8, or one unit per byte for Latin-1.
+ * A leading BOM is dropped and malformed UTF-8 becomes U+FFFD. */
+static wchar_t *decode(const char *src, size_t n, int latin1, size_t *out_len) {
+    const unsigned char *s = (const unsigned char *)src;
+    wchar_t *out = (wchar_t *)malloc((n + 1) * sizeof(wchar_t));
+    if (!out) return NULL;
+    size_t i = 0, j = 0;
+    if (!latin1 && n >= 3 && s[0] == 0xEF && s[1] == 0xBB && s[2] == 0xBF) i = 3;
+    while (i < n) {
+        unsigned c = s[i++];
+        if (latin1 || c < 0x80) { out[j++] = (wchar_t)c; continue; }
+        int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : -1;
+        unsigned cp = extra == 3 ? c & 0x07 : extra == 2 ? c & 0x0F : c & 0x1F;
+        for (int k = 0; k < extra; k++) {
+            if (i >= n || (s[i] & 0xC0) != 0x80) { extra = -1; break; }
+            cp = cp << 6 | (s[i++] & 0x3F);
+        }
+        if (extra < 0 || cp > 0x10FFFF) cp = 0xFFFD;
+        if (cp > 0xFFFF && sizeof(wchar_t) == 2) {
+            cp -= 0x10000;
+            out[j++] = (wchar_t)(0xD800 + (cp >> 10));
+            out[j++] = (wchar_t)(0xDC00 + (cp & 0x3FF));
+        } else {
+            out[j++] = (wchar_t)cp;
+        }
+    }
+    out[j] = 0;
+    *out_len = j;
+    return out;
+}
+
+/* Cut the next line out of text in place; returns NULL at the end. */
+static wchar_t *next_line(wchar_t **cursor, wchar_t *end) {
+    wchar_t *p = *cursor;
+    if (p >= end) return NULL;
+    wchar_t *line = p;
+    while (p < end && *p != L'\n') p++;
+    if (p > line && p[-1] == L'\r') p[-1] = 0;
+    if (p < end) *p++ = 0;
+    *cursor = p;
+    return line;
+}
+
+static int split_fields(wchar_t *line, wchar_t **f, int max) {
+    int n = 0;
+    wchar_t *p = line;
+    while (*p && n < max) {
+        while (*p == L' ' || *p == L'\t') *p++ = 0;
+        if (!*p) break;
+        f[n++] = p;
+        while (*p && *p != L' ' && *p != L'\t') p++;
+    }
+    return n;
+}
+
+static int wlen(const wchar_t *s) {
+    int n = 0;
+    while (s[n]) n++;
+    return n;
+}
+
+static int wequal(const wchar_t *a, const char *b) {
+    while (*a && *b && *a == (wchar_t)(unsigned char)*b) { a++; b++; }
+    return *a == 0 && *b == 0;
+}
+
+/* ── Affix rules ── */
+
+enum { FLAG_CHAR, FLAG_LONG, FLAG_NUM };
+
+typedef struct {
+    wchar_t strip[DICT_MAX_AFFIX]; int slen;
+    wchar_t add[DICT_MAX_AFFIX];   int alen;
+    wchar_t cond[DICT_MAX_AFFIX];  int clen;
+} AffRule;
+
+typedef struct {
+    unsigned flag;
+    int prefix, cross;
+    int first, count;
+} AffClass;
+
+typedef struct {
+    int flag_mode;
+    unsigned needaffix, forbidden;
+    AffClass *classes; int nclasses, ccap;
+    AffRule  *rules;   int nrules, rcap;
+} Affixes;
+
+static int parse_flags(const wchar_t *s, int mode, unsigned *out, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        if (mode == FLAG_LONG) {
+            if (!s[1]) break;
+            out[n++] = (unsigned)(unsigned short)s[0] << 16 | (unsigned short)s[1];
+            s += 2;
+        } else if (mode == FLAG_NUM) {
+            unsigned v = 0;
+            while (*s >= L'0' && *s <= L'9') v = v * 10 + (unsigned)(*s++ - L'0');
+            out[n++] = v;
+            if (*s == L',') s++;
+            else break;
+        } else {
+            out[n++] = (unsigned)*s++;
+        }
+    }
+    return n;
+}
+
+static void copy_affix(wchar_t *dst, int *dlen, const wchar_t *src) {
+    int n = 0;
+    if (!(src[0] == L'0' && src[1] == 0)) {
+        while (src[n] && src[n] != L'/' && n < DICT_MAX_AFFIX - 1) { dst[n] = src[n]; n++; }
+    }
+    dst[n] = 0;
+    *dlen = n;
+}
+
+static AffClass *find_class(Affixes *ax, unsigned flag) {
+    for (int i = 0; i < ax->nclasses; i++)
+        if (ax->classes[i].flag == flag) return &ax->classes[i];
+    return NULL;
+}
+
+/* Reads FLAG, NEEDAFFIX, FORBIDDENWORD and PFX/SFX blocks; every other
+ * directive is ignored. */
+static int parse_affixes(Affixes *ax, wchar_t *text, size_t len) {
+    wchar_t *cursor = text, *end = text + len, *line;
+    AffClass *open = NULL;   /* class whose rule lines are still expected */
+    int remaining = 0;
+    while ((line = next_line(&cursor, end)) != NULL) {
+        wchar_t *f[DICT_MAX_FIELDS];
+        int nf = split_fields(line, f, DICT_MAX_FIELDS);
+        if (nf < 2 || f[0][0] == L'#') continue;
+        unsigned flags[1];
+
+        if (wequal(f[0], "FLAG")) {
+            if (wequal(f[1], "long")) ax->flag_mode = FLAG_LONG;
+            else if (wequal(f[1], "num")) ax->flag_mode = FLAG_NUM;
+        } else if (wequal(f[0], "NEEDAFFIX")) {
+            if (parse_flags(f[1], ax->flag_mode, flags, 1)) ax->needaffix = flags[0];
+        } else if (wequal(f[0], "FORBIDDENWORD")) {
+            if (parse_flags(f[1], ax->flag_mode, flags, 1)) ax->forbidden = flags[0];
+        } else if ((wequal(f[0], "PFX") || wequal(f[0], "SFX")) && nf >= 4) {
+            if (!parse_flags(f[1], ax->flag_mode, flags, 1)) continue;
+            int prefix = f[0][0] == L'P';
+            if (!open || remaining == 0 || open->flag != flags[0] || open->prefix != prefix) {
+                /* Header: PFX flag cross_product count */
+                if (ax->nclasses == ax->ccap) {
+                    int ncap = ax->ccap ? ax->ccap * 2 : 32;
+                    AffClass *nc = (AffClass *)realloc(ax->classes, ncap * sizeof(AffClass));
+                    if (!nc) return 0;
+                    ax->classes = nc;
+                    ax->ccap = ncap;
+                }
+                open = &ax->classes[ax->nclasses++];
+                open->flag = flags[0];
+                open->prefix = prefix;
+                open->cross = f[2][0] == L'Y';
+                open->first = ax->nrules;
+                open->count = 0;
+                remaining = 0;
+                for (const wchar_t *p = f[3]; *p >= L'0' && *p <= L'9'; p++)
+                    remaining = remaining * 10 + (int)(*p - L'0');
+                continue;
+            }
+            /* Rule: PFX flag strip add [condition] */
+            if (ax->nrules == ax->rcap) {
+                int ncap = ax->rcap ? ax->rcap * 2 : 256;
+                AffRule *nr = (AffRule *)realloc(ax->rules, ncap * sizeof(AffRule));
+                if (!nr) return 0;
+                ax->rules = nr;
+                ax->rcap = ncap;
+            }
+            AffRule *r = &ax->rules[ax->nrules++];
+            copy_affix(r->strip, &r->slen, f[2]);
+            copy_affix(r->add, &r->alen, f[3]);
+            copy_affix(r->cond, &r->clen, nf >= 5 ? f[4] : L".");
+            open->count++;
+            remaining--;
+        }
+    }
+    return 1;
+}
+
+/* Number of characters a condition spans: literals, '.', [set], [^set] */
+static int cond_width(const AffRule *r) {
+    int k = 0;
+    for (int p = 0; p < r->clen; k++) {
+        if (r->cond[p] == L'[') {
+            while (p < r->clen && r->cond[p] != L']') p++;
+        }
+        p++;
+    }
+    return k;
+}
+
+static int cond_match(const AffRule *r, const wchar_t *w, int n, int prefix) {
+    if (r->clen == 1 && r->cond[0] == L'.') return 1;
+    int k = cond_width(r);
+    if (k > n) return 0;
+    int i = prefix ? 0 : n - k;
+    for (int p = 0; p < r->clen; i++) {
+        wchar_t ch = w[i];
+        if (r->cond[p] == L'[') {
+            int neg = 0, hit = 0;
+            p++;
+            if (p < r->clen && r->cond[p] == L'^') { neg = 1; p++; }
+            for (; p < r->clen && r->cond[p] != L']'; p++)
+                if (r->cond[p] == ch) hit = 1;
+            p++;
+            if (hit == neg) return 0;
+        } else {
+            if (r->cond[p] != L'.' && r->cond[p] != ch) return 0;
+            p++;
+        }
+    }
+    return 1;
+}
+
+/* Applies one rule to w; returns the new length, or 0 if it doesn't apply. */
+static int apply_rule(const AffRule *r, int prefix, const wchar_t *w, int n, wchar_t *out) {
+    if (r->slen > n || n - r->slen + r->alen >= DICT_MAX_WORD) return 0;
+    if (!cond_match(r, w, n, prefix)) return 0;
+    if (prefix) {
+        if (memcmp(w, r->strip, r->slen * sizeof(wchar_t)) != 0) return 0;
+        memcpy(out, r->add, r->alen * sizeof(wchar_t));
+        memcpy(out + r->alen, w + r->slen, (n - r->slen) * sizeof(wchar_t));
+    } else {
+        if (memcmp(w + n - r->slen, r->strip, r->slen * sizeof(wchar_t)) != 0) return 0;
+        memcpy(out, w, (n - r->slen) * sizeof(wchar_t));
+        memcpy(out + n - r->slen, r->add, r->alen * sizeof(wchar_t));
+    }
+    return n - r->slen + r->alen;
+}
+
+/* ── Word list ── */
+
+typedef struct {
+    wchar_t *buf;  size_t len, cap;
+    size_t *off;   size_t count, ocap;
+} WordList;
+
+static int wl_add(WordList *wl, const wchar_t *w, int n) {
+    if (n <= 0 || n >= DICT_MAX_WORD) return 1;
+    if (wl->len + n + 1 > wl->cap) {
+        size_t ncap = wl->cap ? wl->cap * 2 : 1 << 16;
+        while (ncap < wl->len + n + 1) ncap *= 2;
+        wchar_t *nb = (wchar_t *)realloc(wl->buf, ncap * sizeof(wchar_t));
+        if (!nb) return 0;
+        wl->buf = nb;
+        wl->cap = ncap;
+    }
+    if (wl->count == wl->ocap) {
+        size_t ncap = wl->ocap ? wl->ocap * 2 : 4096;
+        size_t *no = (size_t *)realloc(wl->off, ncap * sizeof(size_t));
+        if (!no) return 0;
+        wl->off = no;
+        wl->ocap = ncap;
+    }
+    ch_fold_run(w, wl->buf + wl->len, n);
+    wl->buf[wl->len + n] = 0;
+    wl->off[wl->count++] = wl->len;
+    wl->len += n + 1;
+    return 1;
+}
+
+static int has_flag(const unsigned *flags, int nflags, unsigned flag) {
+    for (int i = 0; i < nflags; i++) if (flags[i] == flag) return 1;
+    return 0;
+}
+
+/* Adds a dictionary entry and every affixed form its flags allow. */
+static int expand_word(WordList *wl, Affixes *ax, const wchar_t *w, int n,
+                       const unsigned *flags, int nflags) {
+    if (ax->forbidden && has_flag(flags, nflags, ax->forbidden)) return 1;
+    if (!(ax->needaffix && has_flag(flags, nflags, ax->needaffix)) && !wl_add(wl, w, n)) return 0;
+
+    wchar_t sfx[DICT_MAX_WORD], both[DICT_MAX_WORD];
+    for (int i = 0; i < nflags; i++) {
+        AffClass *c = find_class(ax, flags[i]);
+        if (!c) continue;
+        for (int r = c->first; r < c->first + c->count; r++) {
+            int m = apply_rule(&ax->rules[r], c->prefix, w, n, sfx);
+            if (!m) continue;
+            if (!wl_add(wl, sfx, m)) return 0;
+            if (c->prefix || !c->cross) continue;
+            /* Cross product: prefixes that also allow it */
+            for (int j = 0; j < nflags; j++) {
+                AffClass *p = find_class(ax, flags[j]);
+                if (!p || !p->prefix || !p->cross) continue;
+                for (int q = p->first; q < p->first + p->count; q++) {
+                    int b = apply_rule(&ax->rules[q], 1, sfx, m, both);
+                    if (b && !wl_add(wl, both, b)) return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+static int parse_dic(WordList *wl, Affixes *ax, wchar_t *text, size_t len) {
+    wchar_t *cursor = text, *end = text + len, *line;
+    int first = 1;
+    while ((line = next_line(&cursor, end)) != NULL) {
+        if (first) {
+            /* Hunspell files open with a word count; plain lists don't */
+            first = 0;
+            const wchar_t *p = line;
+            while (*p >= L'0' && *p <= L'9') p++;
+            if (p > line && (*p == 0 || *p == L' ' || *p == L'\t')) continue;
+        }
+        if (line[0] == L'#' || line[0] == L'\t') continue;
+        wchar_t *f[1];
+        if (split_fields(line, f, 1) < 1) continue;
+
+        wchar_t *w = f[0];
+        unsigned flags[DICT_MAX_FLAGS];
+        int nflags = 0;
+        wchar_t *slash = w;
+        while (*slash && *slash != L'/') slash++;
+        if (*slash) {
+            *slash = 0;
+            if (ax) nflags = parse_flags(slash + 1, ax->flag_mode, flags, DICT_MAX_FLAGS);
+        }
+        int n = wlen(w);
+        if (!(ax ? expand_word(wl, ax, w, n, flags, nflags) : wl_add(wl, w, n))) return 0;
+    }
+    return 1;
+}
+
+/* ── Construction ── */
+
+typedef struct { wchar_t ch; int to; } BEdge;
+typedef struct { BEdge *e; int n, cap; int final; } BNode;
+
+typedef struct {
+    BNode *nodes; int count, cap;
+    int *reg; int reg_count, reg_cap;   /* open-addressed set of node ids, -1 empty */
+    int path[DICT_MAX_WORD + 1];        /* previous word's nodes; path[0] is the root */
+    int depth;
+    int failed;
+} Builder;
+
+static int b_new_node(Builder *b) {
+    if (b->count == b->cap) {
+        int ncap = b->cap ? b->cap * 2 : 4096;
+        BNode *nn = (BNode *)realloc(b->nodes, ncap * sizeof(BNode));
+        if (!nn) { b->failed = 1; return -1; }
+        b->nodes = nn;
+        b->cap = ncap;
+    }
+    memset(&b->nodes[b->count], 0, sizeof(BNode));
+    return b->count++;
+}
+
+static int b_add_edge(Builder *b, int from, wchar_t ch, int to) {
+    BNode *nd = &b->nodes[from];
+    if (nd->n == nd->cap) {
+        int ncap = nd->cap ? nd->cap * 2 : 2;
+        BEdge *ne = (BEdge *)realloc(nd->e, ncap * sizeof(BEdge));
+        if (!ne) { b->failed = 1; return 0; }
+        nd->e = ne;
+        nd->cap = ncap;
+    }
+    nd->e[nd->n].ch = ch;
+    nd->e[nd->n].to = to;
+    nd->n++;
+    return 1;
+}
+
+static unsigned b_hash(const BNode *nd) {
+    unsigned h = 2166136261u ^ (unsigned)nd->final;
+    for (int i = 0; i < nd->n; i++) {
+        h = (h ^ (unsigned)nd->e[i].ch) * 16777619u;
+        h = (h ^ (unsigned)nd->e[i].to) * 16777619u;
+    }
+    return h;
+}
+
+static int b_equal(const BNode *a, const BNode *c) {
+    if (a->final != c->final || a->n != c->n) return 0;
+    for (int i = 0; i < a->n; i++)
+        if (a->e[i].ch != c->e[i].ch || a->e[i].to != c->e[i].to) return 0;
+    return 1;
+}
+
+/* Returns the registered node equal to id, registering id if none is. */
+static int b_register(Builder *b, int id) {
+    if ((b->reg_count + 1) * 2 > b->reg_cap) {
+        int ncap = b->reg_cap ? b->reg_cap * 2 : 1 << 14;
+        int *nr = (int *)malloc(ncap * sizeof(int));
+        if (!nr) { b->failed = 1; return id; }
+        for (int i = 0; i < ncap; i++) nr[i] = -1;
+        for (int i = 0; i < b->reg_cap; i++) {
+            int v = b->reg[i];
+            if (v < 0) continue;
+            unsigned s = b_hash(&b->nodes[v]) & (ncap - 1);
+            while (nr[s] >= 0) s = (s + 1) & (ncap - 1);
+            nr[s] = v;
+        }
+        free(b->reg);
+        b->reg = nr;
+        b->reg_cap = ncap;
+    }
+    BNode *nd = &b->nodes[id];
+    unsigned s = b_hash(nd) & (b->reg_cap - 1);
+    for (; b->reg[s] >= 0; s = (s + 1) & (b->reg_cap - 1))
+        if (b_equal(&b->nodes[b->reg[s]], nd)) return b->reg[s];
+    b->reg[s] = id;
+    b->reg_count++;
+    return id;
+}
+
+/* Minimise the previous word's path below depth `keep`. */
+static void b_minimize(Builder *b, int keep) {
+    for (; b->depth > keep; b->depth--) {
+        int child = b->path[b->depth];
+        int parent = b->path[b->depth - 1];
+        int r = b_register(b, child);
+        if (r != child) {
+            BNode *p = &b->nodes[parent];
+            p->e[p->n - 1].to = r;
+            free(b->nodes[child].e);
+            b->nodes[child].e = NULL;
+            b->nodes[child].n = 0;
+        }
+    }
+}
+
+/* Words must arrive in ascending unit order without duplicates. */
+static void b_insert(Builder *b, const wchar_t *w, const wchar_t *prev) {
+    int common = 0;
+    if (prev) while (common < b->depth && w[common] && w[common] == prev[common]) common++;
+    b_minimize(b, common);
+    for (int i = common; w[i] && !b->failed; i++) {
+        int nd = b_new_node(b);
+        if (nd < 0 || !b_add_edge(b, b->path[i], w[i], nd)) return;
+        b->path[i + 1] = nd;
+        b->depth = i + 1;
+    }
+    b->nodes[b->path[b->depth]].final = 1;
+}
+
+static int cmp_words(const void *a, const void *b) {
+    const wchar_t *x = *(const wchar_t *const *)a;
+    const wchar_t *y = *(const wchar_t *const *)b;
+    while (*x && *x == *y) { x++; y++; }
+    return (*x > *y) - (*x < *y);
+}
+
+/* Breadth-first renumbering of the nodes reachable from the root */
+static Dict *flatten(Builder *b, ptrdiff_t words) {
+    Dict *d = (Dict *)calloc(1, sizeof(Dict));
+    int *newid = (int *)malloc(b->count * sizeof(int));
+    int *order = (int *)malloc(b->count * sizeof(int));
+    size_t edges = 0;
+    for (int i = 0; i < b->count; i++) edges += b->nodes[i].n;
+    if (d) {
+        d->first = (unsigned *)malloc((b->count + 1) * sizeof(unsigned));
+        d->label = (wchar_t *)malloc((edges + 1) * sizeof(wchar_t));
+        d->target = (unsigned *)malloc((edges + 1) * sizeof(unsigned));
+    }
+    if (!d || !newid || !order || !d->first || !d->label || !d->target) {
+        free(newid);
+        free(order);
+        dict_free(d);
+        return NULL;
+    }
+
+    for (int i = 0; i < b->count; i++) newid[i] = -1;
+    int head = 0, tail = 0;
+    size_t e = 0;
+    newid[0] = 0;
+    order[tail++] = 0;
+    while (head < tail) {
+        int id = order[head];
+        BNode *nd = &b->nodes[id];
+        d->first[head++] = (unsigned)(e << 1) | (unsigned)nd->final;
+        for (int i = 0; i < nd->n; i++) {
+            int to = nd->e[i].to;
+            if (newid[to] < 0) {
+                newid[to] = tail;
+                order[tail++] = to;
+            }
+            d->label[e] = nd->e[i].ch;
+            d->target[e] = (unsigned)newid[to];
+            e++;
+        }
+    }
+    d->first[tail] = (unsigned)(e << 1);
+    d->nodes = (size_t)tail;
+    d->words = words;
+    free(newid);
+    free(order);
+    return d;
+}
+
+Dict *dict_load(const char *dic, size_t dic_len, const char *aff, size_t aff_len,
+                const char **err) {
+    const char *msg = "out of memory";
+    Affixes ax;
+    memset(&ax, 0, sizeof(ax));
+    WordList wl;
+    memset(&wl, 0, sizeof(wl));
+    Builder b;
+    memset(&b, 0, sizeof(b));
+    const wchar_t **sorted = NULL;
+    Dict *d = NULL;
+
+    if (aff) {
+        /* SET must be known before decoding anything */
+        int latin1 = 0;
+        for (size_t i = 0; i + 8 <= aff_len; i++) {
+            if ((i == 0 || aff[i - 1] == '\n') && memcmp(aff + i, "SET ISO", 7) == 0) latin1 = 1;
+        }
+        size_t n;
+        wchar_t *text = decode(aff, aff_len, latin1, &n);
+        int ok = text && parse_affixes(&ax, text, n);
+        free(text);
+        if (!ok) goto done;
+        wchar_t *dtext = decode(dic, dic_len, latin1, &n);
+        ok = dtext && parse_dic(&wl, &ax, dtext, n);
+        free(dtext);
+        if (!ok) goto done;
+    } else {
+        size_t n;
+        wchar_t *dtext = decode(dic, dic_len, 0, &n);
+        int ok = dtext && parse_dic(&wl, NULL, dtext, n);
+        free(dtext);
+        if (!ok) goto done;
+    }
+    if (wl.count == 0) { msg = "dictionary has no words"; goto done; }
+
+    sorted = (const wchar_t **)malloc(wl.count * sizeof(wchar_t *));
+    if (!sorted) goto done;
+    for (size_t i = 0; i < wl.count; i++) sorted[i] = wl.buf + wl.off[i];
+    qsort(sorted, wl.count, sizeof(wchar_t *), cmp_words);
+
+    if (b_new_node(&b) < 0) goto done;
+    const wchar_t *prev = NULL;
+    ptrdiff_t words = 0;
+    for (size_t i = 0; i < wl.count && !b.failed; i++) {
+        if (prev && cmp_words(&prev, &sorted[i]) == 0) continue;
+        b_insert(&b, sorted[i], prev);
+        prev = sorted[i];
+        words++;
+    }
+    b_minimize(&b, 0);
+    if (!b.failed) d = flatten(&b, words);
+
+done:
+    for (int i = 0; i < b.count; i++) free(b.nodes[i].e);
+    free(b.nodes);
+    free(b.reg);
+    free(sorted);
+    free(wl.buf);
+    free(wl.off);
+    free(ax.classes);
+    free(ax.rules);
+    if (!d && err) *err = msg;
+    return d;
+}
+
+void dict_free(Dict *d) {
+    if (!d) return;
+    free(d->first);
+    free(d->label);
+    free(d->target);
+    free(d);
+}
+
+int dict_lookup(const Dict *d, const wchar_t *word, ptrdiff_t len) {
+    unsigned n = 0;
+    for (ptrdiff_t i = 0; i < len; i++) {
+        unsigned lo = d->first[n] >> 1, hi = d->first[n + 1] >> 1;
+        wchar_t c = word[i];
+        while (lo < hi) {
+            unsigned mid = (lo + hi) / 2;
+            if (d->label[mid] < c) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == d->first[n + 1] >> 1 || d->label[lo] != c) return 0;
+        n = d->target[lo];
+    }
+    return (int)(d->first[n] & 1);
+}
+
+/* ── Suggestions ──
+ * A depth-first walk of the automaton carries one row of the edit
+ * distance table per character of the path, so words sharing a prefix
+ * share its rows. A branch is abandoned once every cell of its row is
+ * over the bound, which keeps a distance-2 search to a small corner of
+ * the dictionary. Transpositions use the restricted (optimal string
+ * alignment) form. Among equal distances, words that keep the first
+ * letter and then the length rank first. */
+
+typedef struct {
+    const Dict *d;
+    const wchar_t *word;
+    int len;
+    int max_dist;
+    int limit;                                   /* deepest path explored */
+    wchar_t path[DICT_MAX_WORD];
+    unsigned char rows[DICT_MAX_WORD + 1][DICT_MAX_WORD + 1];
+    DictSuggestion *out;
+    int k, count;
+} Suggest;
+
+static int suggest_rank(const Suggest *s, const wchar_t *w, int n, int dist) {
+    int diff = n > s->len ? n - s->len : s->len - n;
+    return dist * 256 + (w[0] != s->word[0]) * 128 + (diff < 127 ? diff : 127);
+}
+
+static int suggest_bound(const Suggest *s) {
+    return s->count == s->k ? s->out[s->k - 1].dist : s->max_dist;
+}
+
+static void suggest_add(Suggest *s, int n, int dist) {
+    int rank = suggest_rank(s, s->path, n, dist);
+    int i = s->count;
+    while (i > 0 && suggest_rank(s, s->out[i - 1].word, s->out[i - 1].len, s->out[i - 1].dist) > rank) i--;
+    if (i >= s->k) return;
+    int last = s->count < s->k ? s->count : s->k - 1;
+    memmove(s->out + i + 1, s->out + i, (last - i) * sizeof(DictSuggestion));
+    memcpy(s->out[i].word, s->path, n * sizeof(wchar_t));
+    s->out[i].len = n;
+    s->out[i].dist = dist;
+    if (s->count < s->k) s->count++;
+}
+
+static void suggest_walk(Suggest *s, unsigned node, int depth, int parent_best);
+
+/* Extends the path along edge e and explores below it if in bound. */
+static void suggest_edge(Suggest *s, unsigned e, int depth) {
+    const Dict *d = s->d;
+    const wchar_t *w = s->word;
+    int len = s->len;
+    unsigned char *prev = s->rows[depth], *row = s->rows[depth + 1];
+    wchar_t c = d->label[e];
+    s->path[depth] = c;
+
+    /* Only cells within max_dist of the diagonal can stay in bound */
+    int i = depth + 1, cap = s->max_dist + 1;
+    int lo = i - s->max_dist > 1 ? i - s->max_dist : 1;
+    int hi = i + s->max_dist < len ? i + s->max_dist : len;
+    int best = row[0] = (unsigned char)(i < cap ? i : cap);
+    if (lo > 1) row[lo - 1] = (unsigned char)cap;
+    if (hi < len) row[hi + 1] = (unsigned char)cap;
+    for (int j = lo; j <= hi; j++) {
+        int v = prev[j - 1] + (c != w[j - 1]);
+        if (prev[j] + 1 < v) v = prev[j] + 1;
+        if (row[j - 1] + 1 < v) v = row[j - 1] + 1;
+        if (depth > 0 && j > 1 && c == w[j - 2] && s->path[depth - 1] == w[j - 1] &&
+            s->rows[depth - 1][j - 2] + 1 < v)
+            v = s->rows[depth - 1][j - 2] + 1;
+        if (v > cap) v = cap;
+        row[j] = (unsigned char)v;
+        if (v < best) best = v;
+    }
+
+    int bound = suggest_bound(s);
+    if (best > bound) return;
+    unsigned t = d->target[e];
+    if ((d->first[t] & 1) && hi == len && row[len] > 0 && row[len] <= bound)
+        suggest_add(s, i, row[len]);
+    if (i < s->limit) suggest_walk(s, t, i, best);
+}
+
+static void suggest_walk(Suggest *s, unsigned node, int depth, int parent_best) {
+    const Dict *d = s->d;
+    unsigned first = d->first[node] >> 1, end = d->first[node + 1] >> 1;
+    if (parent_best < suggest_bound(s)) {
+        for (unsigned e = first; e < end; e++) suggest_edge(s, e, depth);
+        return;
+    }
+
+    /* Already at the bound: only a character matching the word near
+     * this column (directly or by transposition) can stay in it, so
+     * look those up rather than trying every edge. */
+    wchar_t seen[2 * DICT_MAX_WORD];
+    int nseen = 0;
+    int from = depth - s->max_dist - 1, to = depth + s->max_dist;
+    if (from < 0) from = 0;
+    if (to > s->len - 1) to = s->len - 1;
+    for (int x = from; x <= to; x++) {
+        wchar_t c = s->word[x];
+        int dup = 0;
+        for (int k = 0; k < nseen && !dup; k++) dup = seen[k] == c;
+        if (dup) continue;
+        seen[nseen++] = c;
+        unsigned lo = first, hi = end;
+        while (lo < hi) {
+            unsigned mid = (lo + hi) / 2;
+            if (d->label[mid] < c) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo < end && d->label[lo] == c) suggest_edge(s, lo, depth);
+    }
+}
+
+int dict_suggest(const Dict *d, const wchar_t *word, ptrdiff_t len, int max_dist,
+                 DictSuggestion *out, int k) {
+    if (!d || len <= 0 || len >= DICT_MAX_WORD || k <= 0) return 0;
+    Suggest s;
+    s.d = d;
+    s.word = word;
+    s.len = (int)len;
+    s.max_dist = max_dist;
+    s.limit = len + max_dist < DICT_MAX_WORD - 1 ? (int)len + max_dist : DICT_MAX_WORD - 1;
+    s.out = out;
+    s.k = k;
+    s.count = 0;
+    for (int j = 0; j <= len; j++) s.rows[0][j] = (unsigned char)j;
+    suggest_walk(&s, 0, 0, 0);
+    return s.count;
+}
+
+ptrdiff_t dict_word_count(const Dict *d) {
+    return d->words;
+}
+
+size_t dict_node_count(const Dict *d) {
+    return d->nodes;
+}
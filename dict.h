@@ -0,0 +1,47 @@
+/*
+ * dict.h — Spelling dictionary stored as a minimal acyclic automaton
+ * Portable C with no Win32 dependencies.
+ *
+ * Loads a Hunspell .dic/.aff pair or a plain word list, one word per
+ * line. Hunspell prefix and suffix rules (including cross products) are
+ * expanded at load time; compounding, continuation classes and
+ * morphology are ignored. Words are stored case-folded through
+ * chartab.h, so lookups must be folded the same way.
+ */
+#ifndef PROSE_DICT_H
+#define PROSE_DICT_H
+
+#include <stddef.h>
+#include <wchar.h>
+
+#define DICT_MAX_WORD 64     /* longer words are not stored */
+
+typedef struct Dict Dict;
+
+typedef struct {
+    wchar_t word[DICT_MAX_WORD];   /* folded, not terminated */
+    int len;
+    int dist;
+} DictSuggestion;
+
+/* Builds a dictionary from the raw bytes of a .dic file (Hunspell or a
+ * plain list) and, optionally, its .aff file. Both are UTF-8 unless the
+ * .aff says SET ISO8859-1. Returns NULL and points *err at a message if
+ * nothing could be loaded. */
+Dict *dict_load(const char *dic, size_t dic_len, const char *aff, size_t aff_len,
+                const char **err);
+void  dict_free(Dict *d);
+
+/* 1 if the folded word is in the dictionary. */
+int dict_lookup(const Dict *d, const wchar_t *word, ptrdiff_t len);
+
+/* Fills out[] with up to k dictionary words within max_dist edits of
+ * the folded word, best first, and returns how many. An edit inserts,
+ * deletes or substitutes one character, or swaps two adjacent ones. */
+int dict_suggest(const Dict *d, const wchar_t *word, ptrdiff_t len, int max_dist,
+                 DictSuggestion *out, int k);
+
+ptrdiff_t dict_word_count(const Dict *d);
+size_t    dict_node_count(const Dict *d);
+
+#endif /* PROSE_DICT_H */
@@ -0,0 +1,262 @@
+/*
+ * diff.c — Line diff of two texts
+ *
+ * The bisection follows Myers' "An O(ND) Difference Algorithm and Its
+ * Variations" (1986): forward and reverse searches run from both corners
+ * until their paths overlap, and the two halves of the edit graph on
+ * either side of the meeting point are diffed in turn. Diagonals that
+ * leave the graph are dropped from the search as in diff-match-patch.
+ */
+#include "diff.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const int *a, *b;        /* line ids; equal lines share an id */
+    ptrdiff_t *v1, *v2;      /* furthest x per diagonal, forward and reverse */
+    DiffHunk *hunks;         /* in lines until diff_text converts them */
+    ptrdiff_t count, cap;
+    int failed;
+} Diff;
+
+/* ── Lines ── */
+
+/* Start of each line of t[0..n), then n */
+static ptrdiff_t *split_lines(const wchar_t *t, ptrdiff_t n, ptrdiff_t *count) {
+    ptrdiff_t lines = 0;
+    for (ptrdiff_t i = 0; i < n; i++) lines += t[i] == L'\n';
+    if (n > 0 && t[n - 1] != L'\n') lines++;
+    ptrdiff_t *starts = (ptrdiff_t *)malloc((lines + 1) * sizeof(ptrdiff_t));
+    if (!starts) return NULL;
+    ptrdiff_t k = 0;
+    for (ptrdiff_t i = 0; i < n; i++) {
+        if (i == 0 || t[i - 1] == L'\n') starts[k++] = i;
+    }
+    starts[k] = n;
+    *count = lines;
+    return starts;
+}
+
+static unsigned line_hash(const wchar_t *s, ptrdiff_t n) {
+    unsigned h = 2166136261u;
+    for (ptrdiff_t i = 0; i < n; i++) h = (h ^ (unsigned)s[i]) * 16777619u;
+    return h;
+}
+
+typedef struct {
+    const wchar_t *text;
+    ptrdiff_t len;
+    unsigned hash;
+} LineClass;
+
+/* Gives each line of both texts the id of the first line equal to it */
+static int assign_ids(const wchar_t *a, const ptrdiff_t *la, ptrdiff_t na,
+                      const wchar_t *b, const ptrdiff_t *lb, ptrdiff_t nb,
+                      int *ida, int *idb) {
+    size_t size = 16;
+    while (size < (size_t)(na + nb) * 2) size *= 2;
+    int *slots = (int *)malloc(size * sizeof(int));
+    LineClass *classes = (LineClass *)malloc((na + nb) * sizeof(LineClass));
+    if (!slots || !classes) {
+        free(slots);
+        free(classes);
+        return 0;
+    }
+    memset(slots, -1, size * sizeof(int));
+    int nclasses = 0;
+    for (int side = 0; side < 2; side++) {
+        const wchar_t *t = side ? b : a;
+        const ptrdiff_t *ls = side ? lb : la;
+        ptrdiff_t n = side ? nb : na;
+        int *ids = side ? idb : ida;
+        for (ptrdiff_t i = 0; i < n; i++) {
+            const wchar_t *s = t + ls[i];
+            ptrdiff_t len = ls[i + 1] - ls[i];
+            unsigned h = line_hash(s, len);
+            size_t slot = h & (size - 1);
+            for (;;) {
+                int c = slots[slot];
+                if (c < 0) {
+                    classes[nclasses].text = s;
+                    classes[nclasses].len = len;
+                    classes[nclasses].hash = h;
+                    slots[slot] = c = nclasses++;
+                }
+                if (classes[c].hash == h && classes[c].len == len &&
+                    memcmp(classes[c].text, s, len * sizeof(wchar_t)) == 0) {
+                    ids[i] = c;
+                    break;
+                }
+                slot = (slot + 1) & (size - 1);
+            }
+        }
+    }
+    free(slots);
+    free(classes);
+    return 1;
+}
+
+/* ── Myers ── */
+
+static void add_hunk(Diff *d, ptrdiff_t a0, ptrdiff_t a1, ptrdiff_t b0, ptrdiff_t b1) {
+    if (d->count > 0) {
+        DiffHunk *last = &d->hunks[d->count - 1];
+        if (last->a_pos + last->a_len == a0 && last->b_pos + last->b_len == b0) {
+            last->a_len = a1 - last->a_pos;
+            last->b_len = b1 - last->b_pos;
+            return;
+        }
+    }
+    if (d->count == d->cap) {
+        ptrdiff_t ncap = d->cap ? d->cap * 2 : 16;
+        DiffHunk *nh = (DiffHunk *)realloc(d->hunks, ncap * sizeof(DiffHunk));
+        if (!nh) { d->failed = 1; return; }
+        d->hunks = nh;
+        d->cap = ncap;
+    }
+    DiffHunk *h = &d->hunks[d->count++];
+    h->a_pos = a0;
+    h->a_len = a1 - a0;
+    h->b_pos = b0;
+    h->b_len = b1 - b0;
+}
+
+/* Finds a point on a shortest edit path through a[a0..a1) and
+ * b[b0..b1), both nonempty with different first and last lines, other
+ * than either corner. Returns 0 past DIFF_MAX_COST. */
+static int bisect(Diff *d, ptrdiff_t a0, ptrdiff_t a1, ptrdiff_t b0, ptrdiff_t b1,
+                  ptrdiff_t *sx, ptrdiff_t *sy) {
+    const int *A = d->a + a0, *B = d->b + b0;
+    ptrdiff_t n = a1 - a0, m = b1 - b0, delta = n - m;
+    ptrdiff_t max_d = (n + m + 1) / 2;
+    if (max_d > DIFF_MAX_COST) max_d = DIFF_MAX_COST;
+    ptrdiff_t off = max_d, len = 2 * max_d + 2;
+    ptrdiff_t *v1 = d->v1, *v2 = d->v2;
+    for (ptrdiff_t i = 0; i < len; i++) v1[i] = v2[i] = -1;
+    v1[off + 1] = 0;
+    v2[off + 1] = 0;
+    int front = (delta & 1) != 0;
+    ptrdiff_t k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+    for (ptrdiff_t e = 0; e < max_d; e++) {
+        for (ptrdiff_t k1 = -e + k1start; k1 <= e - k1end; k1 += 2) {
+            ptrdiff_t i1 = off + k1;
+            ptrdiff_t x1 = (k1 == -e || (k1 != e && v1[i1 - 1] < v1[i1 + 1]))
+                           ? v1[i1 + 1] : v1[i1 - 1] + 1;
+            ptrdiff_t y1 = x1 - k1;
+            while (x1 < n && y1 < m && A[x1] == B[y1]) { x1++; y1++; }
+            v1[i1] = x1;
+            if (x1 > n) {
+                k1end += 2;
+            } else if (y1 > m) {
+                k1start += 2;
+            } else if (front) {
+                ptrdiff_t i2 = off + delta - k1;
+                if (i2 >= 0 && i2 < len && v2[i2] != -1 && x1 >= n - v2[i2]) {
+                    *sx = a0 + x1;
+                    *sy = b0 + y1;
+                    return 1;
+                }
+            }
+        }
+        for (ptrdiff_t k2 = -e + k2start; k2 <= e - k2end; k2 += 2) {
+            ptrdiff_t i2 = off + k2;
+            ptrdiff_t x2 = (k2 == -e || (k2 != e && v2[i2 - 1] < v2[i2 + 1]))
+                           ? v2[i2 + 1] : v2[i2 - 1] + 1;
+            ptrdiff_t y2 = x2 - k2;
+            while (x2 < n && y2 < m && A[n - 1 - x2] == B[m - 1 - y2]) { x2++; y2++; }
+            v2[i2] = x2;
+            if (x2 > n) {
+                k2end += 2;
+            } else if (y2 > m) {
+                k2start += 2;
+            } else if (!front) {
+                ptrdiff_t i1 = off + delta - k2;
+                if (i1 >= 0 && i1 < len && v1[i1] != -1) {
+                    ptrdiff_t x1 = v1[i1];
+                    ptrdiff_t y1 = off + x1 - i1;
+                    if (x1 >= n - x2) {
+                        *sx = a0 + x1;
+                        *sy = b0 + y1;
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void compare(Diff *d, ptrdiff_t a0, ptrdiff_t a1, ptrdiff_t b0, ptrdiff_t b1) {
+    while (a0 < a1 && b0 < b1 && d->a[a0] == d->b[b0]) { a0++; b0++; }
+    while (a0 < a1 && b0 < b1 && d->a[a1 - 1] == d->b[b1 - 1]) { a1--; b1--; }
+    if (a0 == a1 || b0 == b1) {
+        if (a0 < a1 || b0 < b1) add_hunk(d, a0, a1, b0, b1);
+        return;
+    }
+    ptrdiff_t x, y;
+    if (!bisect(d, a0, a1, b0, b1, &x, &y)) {
+        add_hunk(d, a0, a1, b0, b1);
+        return;
+    }
+    compare(d, a0, x, b0, y);
+    compare(d, x, a1, y, b1);
+}
+
+/* ── Entry point ── */
+
+ptrdiff_t diff_text(const wchar_t *a, ptrdiff_t na,
+                    const wchar_t *b, ptrdiff_t nb, DiffHunk **out) {
+    *out = NULL;
+
+    /* Whole lines the texts start and end with */
+    ptrdiff_t p = 0, short_len = na < nb ? na : nb;
+    while (p < short_len && a[p] == b[p]) p++;
+    if (p == na && p == nb) return 0;
+    while (p > 0 && a[p - 1] != L'\n') p--;
+    ptrdiff_t s = 0;
+    while (s < short_len - p && a[na - 1 - s] == b[nb - 1 - s]) s++;
+    while (s > 0 && !((na - s == p || a[na - s - 1] == L'\n') &&
+                      (nb - s == p || b[nb - s - 1] == L'\n')))
+        s--;
+
+    const wchar_t *ma = a + p, *mb = b + p;
+    ptrdiff_t mna = na - s - p, mnb = nb - s - p;
+    ptrdiff_t lna = 0, lnb = 0;
+    ptrdiff_t *la = split_lines(ma, mna, &lna);
+    ptrdiff_t *lb = split_lines(mb, mnb, &lnb);
+    int *ida = (int *)malloc((lna + 1) * sizeof(int));
+    int *idb = (int *)malloc((lnb + 1) * sizeof(int));
+    Diff d = { 0 };
+    d.v1 = (ptrdiff_t *)malloc((2 * DIFF_MAX_COST + 2) * sizeof(ptrdiff_t));
+    d.v2 = (ptrdiff_t *)malloc((2 * DIFF_MAX_COST + 2) * sizeof(ptrdiff_t));
+    ptrdiff_t result = -1;
+    if (la && lb && ida && idb && d.v1 && d.v2 &&
+        assign_ids(ma, la, lna, mb, lb, lnb, ida, idb)) {
+        d.a = ida;
+        d.b = idb;
+        compare(&d, 0, lna, 0, lnb);
+        if (!d.failed) {
+            for (ptrdiff_t i = 0; i < d.count; i++) {
+                DiffHunk *h = &d.hunks[i];
+                ptrdiff_t a_end = la[h->a_pos + h->a_len];
+                ptrdiff_t b_end = lb[h->b_pos + h->b_len];
+                h->a_pos = p + la[h->a_pos];
+                h->a_len = p + a_end - h->a_pos;
+                h->b_pos = p + lb[h->b_pos];
+                h->b_len = p + b_end - h->b_pos;
+            }
+            *out = d.hunks;
+            d.hunks = NULL;
+            result = d.count;
+        }
+    }
+    free(d.hunks);
+    free(d.v1);
+    free(d.v2);
+    free(la);
+    free(lb);
+    free(ida);
+    free(idb);
+    return result;
+}
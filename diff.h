@@ -0,0 +1,33 @@
+/*
+ * diff.h — Line diff of two texts
+ * Portable C with no Win32 dependencies.
+ *
+ * Lines common to both ends are trimmed first, so an append or a local
+ * rewrite costs little more than comparing the texts. The rest is
+ * compared as line numbers, one per distinct line, with Myers' linear
+ * space algorithm. Past DIFF_MAX_COST edits in one region the region is
+ * reported as a single hunk rather than searched further.
+ */
+#ifndef PROSE_DIFF_H
+#define PROSE_DIFF_H
+
+#include <stddef.h>
+#include <wchar.h>
+
+#define DIFF_MAX_COST 4096
+
+/* Replace a[a_pos .. a_pos + a_len) with b[b_pos .. b_pos + b_len).
+ * Both ranges start at a line start and end after a '\n' or at the end
+ * of their text. */
+typedef struct {
+    ptrdiff_t a_pos, a_len;
+    ptrdiff_t b_pos, b_len;
+} DiffHunk;
+
+/* Diffs a[0..na) against b[0..nb). Stores the hunks, in order and not
+ * touching each other, in a malloc'd array at *out (NULL if there are
+ * none) and returns their count, or -1 if out of memory. */
+ptrdiff_t diff_text(const wchar_t *a, ptrdiff_t na,
+                    const wchar_t *b, ptrdiff_t nb, DiffHunk **out);
+
+#endif /* PROSE_DIFF_H */
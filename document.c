@@ -1,8 +1,79 @@
 #include "prose_code.h"
 
+/* ── Statistics ──
+ * Word, character and line counts follow each edit from the edited
+ * text alone. A word is a run of letters, apostrophes and hyphens, so
+ * the count is the number of run starts; only the characters either
+ * side of the edit decide whether it joins or splits neighbouring
+ * words. */
+
+static int is_stat_word(wchar_t c) {
+    return ch_isalpha(c) || c == L'\'' || c == L'-';
+}
+
+/* Run starts in text[0..n) placed between left and right, counting a
+ * run that starts at right. A 0 neighbour is the edge of the buffer. */
+static bpos run_starts(wchar_t left, const wchar_t *text, bpos n, wchar_t right) {
+    bpos starts = 0;
+    int prev = left && is_stat_word(left);
+    for (bpos i = 0; i < n; i++) {
+        int cur = is_stat_word(text[i]);
+        starts += cur && !prev;
+        prev = cur;
+    }
+    return starts + (right && is_stat_word(right) && !prev);
+}
+
+static bpos count_newlines(const wchar_t *text, bpos n) {
+    bpos lines = 0;
+    for (bpos i = 0; i < n; i++) lines += text[i] == L'\n';
+    return lines;
+}
+
+static void stats_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted) {
+    GapBuffer *gb = &doc->gb;
+    if (!gb->buf) {
+        /* gb_free: the text is gone */
+        doc->word_count = doc->char_count = 0;
+        doc->line_count = 1;
+        return;
+    }
+    bpos len = gb_length(gb);
+    wchar_t left = pos > 0 ? gb_char_at(gb, pos - 1) : 0;
+    wchar_t right = pos + inserted < len ? gb_char_at(gb, pos + inserted) : 0;
+    bpos joined = run_starts(left, NULL, 0, right);
+    if (removed > 0) {
+        const wchar_t *text = gb->buf + gb->gap_end - removed;
+        doc->word_count -= run_starts(left, text, removed, right) - joined;
+        doc->line_count -= count_newlines(text, removed);
+    }
+    if (inserted > 0) {
+        const wchar_t *text = gb->buf + gb->gap_start - inserted;
+        doc->word_count += run_starts(left, text, inserted, right) - joined;
+        doc->line_count += count_newlines(text, inserted);
+    }
+    doc->char_count = len;
+}
+
+/* Keeps derived per-document state in step with buffer edits */
+static void doc_on_edit(void *ctx, bpos pos, bpos removed, bpos inserted) {
+    Document *doc = (Document *)ctx;
+    /* Text arriving in a loading tab holds no index, misspellings or
+     * matches to patch; they are rebuilt once it is all in */
+    int loading = doc->loading;
+    stats_on_edit(doc, pos, removed, inserted);
+    if (!loading) tri_on_edit(doc, pos, removed, inserted);
+    if (!loading) spell_on_edit(doc, pos, removed, inserted);
+    analytics_on_edit(doc, pos, removed, inserted);
+    journal_on_edit(doc, pos, removed, inserted);
+    if (!loading) search_on_edit(doc, pos, removed, inserted);
+}
+
 Document *doc_create(void) {
     Document *doc = (Document *)calloc(1, sizeof(Document));
     gb_init(&doc->gb, GAP_INIT);
+    doc->gb.on_edit = doc_on_edit;
+    doc->gb.edit_ctx = doc;
     lc_init(&doc->lc);
     wc_init(&doc->wc);
     undo_init(&doc->undo);
@@ -10,6 +81,7 @@ Document *doc_create(void) {
     doc->mode = MODE_PROSE;
     safe_wcscpy(doc->title, 64, L"Untitled");
     doc->desired_col = -1;
+    doc->line_count = 1;
     doc->bc_cached_mutation = -1;
     doc->bc_cached_line = -1;
     doc->autosave_id = g_editor.next_autosave_id++;
@@ -17,6 +89,15 @@ Document *doc_create(void) {
 }
 
 void doc_free(Document *doc) {
+    if (g_editor.search.match_doc == doc) g_editor.search.match_doc = NULL;
+    doc->gb.on_edit = NULL;
+    load_cancel(doc);
+    doc_drop_snapshot(doc);
+    tri_free(doc->tri);
+    spell_marks_free(&doc->spell);
+    analytics_free(&doc->analytics);
+    journal_free(&doc->journal);
+    follow_free(doc);
     gb_free(&doc->gb);
     lc_free(&doc->lc);
     wc_free(&doc->wc);
@@ -31,7 +112,6 @@ Document *current_doc(void) {
 
 void recalc_lines(Document *doc) {
     lc_rebuild(&doc->lc, &doc->gb);
-    doc->line_count = doc->lc.count;
     if (doc->mode == MODE_PROSE && doc->wc.wrap_col > 0) {
         doc->wrap_dirty = 1;
     }
@@ -45,43 +125,52 @@ void recalc_wrap_now(Document *doc) {
     }
 }
 
-void update_stats(Document *doc) {
-    doc->stats_dirty = 1;
+void snapshot_session_baseline(Document *doc) {
+    doc->session_start_words = doc->word_count;
+    doc->session_start_chars = doc->char_count;
+    doc->session_start_lines = doc->line_count;
+    doc->analytics.live = 1;
 }
 
-void update_stats_now(Document *doc) {
-    if (!doc->stats_dirty) return;
-    doc->stats_dirty = 0;
-    GapBuffer *gb = &doc->gb;
-    doc->char_count = gb_length(gb);
-    bpos words = 0;
-    int in_word = 0;
-
-    for (bpos i = 0; i < gb->gap_start; i++) {
-        wchar_t c = gb->buf[i];
-        if (iswalpha(c) || c == L'\'' || c == L'-') {
-            if (!in_word) { words++; in_word = 1; }
-        } else {
-            in_word = 0;
-        }
+/* ── Snapshots ──
+ * Background readers never touch the gap buffer; they get a flat copy
+ * tagged with the mutation counter it was taken at. Repeated requests
+ * against an unchanged buffer share the same copy. */
+
+DocSnapshot *doc_snapshot(Document *doc) {
+    DocSnapshot *snap = doc->snapshot;
+    if (snap && snap->mutation == doc->gb.mutation) {
+        InterlockedIncrement(&snap->refs);
+        return snap;
     }
-    for (bpos i = gb->gap_end; i < gb->total; i++) {
-        wchar_t c = gb->buf[i];
-        if (iswalpha(c) || c == L'\'' || c == L'-') {
-            if (!in_word) { words++; in_word = 1; }
-        } else {
-            in_word = 0;
-        }
+    doc_drop_snapshot(doc);
+
+    bpos len = gb_length(&doc->gb);
+    snap = (DocSnapshot *)malloc(sizeof(DocSnapshot));
+    if (!snap) return NULL;
+    snap->text = (wchar_t *)malloc((len + 1) * sizeof(wchar_t));
+    if (!snap->text) { free(snap); return NULL; }
+    gb_copy_range(&doc->gb, 0, len, snap->text);
+    snap->text[len] = 0;
+    snap->len = len;
+    snap->mutation = doc->gb.mutation;
+    snap->refs = 2; /* the document's cache slot + the caller */
+    doc->snapshot = snap;
+    return snap;
+}
+
+void snapshot_release(DocSnapshot *snap) {
+    if (!snap) return;
+    if (InterlockedDecrement(&snap->refs) == 0) {
+        free(snap->text);
+        free(snap);
     }
-    doc->word_count = words;
 }
 
-void snapshot_session_baseline(Document *doc) {
-    doc->stats_dirty = 1;
-    update_stats_now(doc);
-    doc->session_start_words = doc->word_count;
-    doc->session_start_chars = doc->char_count;
-    doc->session_start_lines = doc->line_count;
+void doc_drop_snapshot(Document *doc) {
+    if (!doc->snapshot) return;
+    snapshot_release(doc->snapshot);
+    doc->snapshot = NULL;
 }
 
 bpos pos_to_line(Document *doc, bpos pos) {
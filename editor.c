@@ -28,13 +28,11 @@ void editor_insert_text(const wchar_t *text, bpos len) {
     doc->modified = 1;
     doc->desired_col = -1;
     if (!sel_group && lc_notify_insert(&doc->lc, doc->cursor - len, text, len)) {
-        doc->line_count = doc->lc.count;
         if (doc->mode == MODE_PROSE && doc->wc.wrap_col > 0)
             doc->wrap_dirty = 1;
     } else {
         recalc_lines(doc);
     }
-    update_stats(doc);
 }
 
 void editor_insert_char(wchar_t c) {
@@ -59,7 +57,6 @@ void editor_delete_selection(void) {
     doc->modified = 1;
     doc->desired_col = -1;
     recalc_lines(doc);
-    update_stats(doc);
 }
 
 void editor_backspace(void) {
@@ -80,13 +77,11 @@ void editor_backspace(void) {
     doc->modified = 1;
     doc->desired_col = -1;
     if (lc_notify_delete(&doc->lc, doc->cursor, buf, 1)) {
-        doc->line_count = doc->lc.count;
         if (doc->mode == MODE_PROSE && doc->wc.wrap_col > 0)
             doc->wrap_dirty = 1;
     } else {
         recalc_lines(doc);
     }
-    update_stats(doc);
 }
 
 void editor_delete_forward(void) {
@@ -106,13 +101,11 @@ void editor_delete_forward(void) {
     doc->modified = 1;
     doc->desired_col = -1;
     if (lc_notify_delete(&doc->lc, doc->cursor, buf, 1)) {
-        doc->line_count = doc->lc.count;
         if (doc->mode == MODE_PROSE && doc->wc.wrap_col > 0)
             doc->wrap_dirty = 1;
     } else {
         recalc_lines(doc);
     }
-    update_stats(doc);
 }
 
 void editor_move_cursor(bpos pos, int extend_selection) {
@@ -156,7 +149,6 @@ void editor_undo(void) {
     doc->sel_anchor = -1;
     doc->modified = (us->current != us->save_point);
     recalc_lines(doc);
-    update_stats(doc);
 }
 
 void editor_redo(void) {
@@ -182,7 +174,6 @@ void editor_redo(void) {
     doc->sel_anchor = -1;
     doc->modified = (us->current != us->save_point);
     recalc_lines(doc);
-    update_stats(doc);
 }
 
 void editor_select_all(void) {
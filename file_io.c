@@ -1,52 +1,137 @@
 #include "prose_code.h"
 
-void load_file(Document *doc, const wchar_t *path) {
-    HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+/* ── Loading ──
+ * The file is read in LOAD_CHUNK pieces and decoded (utf8.c) straight
+ * into the gap of a new buffer sized from the file, so the text is
+ * never held twice. The decoder also drops CR and collects line starts,
+ * which become the line cache. The document keeps its old text until
+ * the whole file has been read.
+ *
+ * A file over LOAD_STREAM_MIN is shown after its first LOAD_CHUNK: a
+ * stream thread decodes the rest into the gap beyond the text, which
+ * nothing else touches while the document is loading, and the UI thread
+ * commits what has arrived (with its line starts) at each
+ * WM_FILE_LOADED. The buffer is sized for the whole file up front, so it
+ * never moves under the thread.
+ *
+ * Reading (load_read) touches nothing shared, so open_files reads many
+ * files at once on the pool. Each path gets a tab straight away, marked
+ * loading, and its text is installed (load_apply) on the UI thread when
+ * WM_FILE_LOADED reports it read, in whatever order the files finish. */
+
+#define LOAD_CHUNK (1 << 20)
+#define LOAD_STREAM_MIN FIF_MAX_FILE   /* smaller files, as find in files opens, load whole */
+
+/* Opens path, even while another program (a log writer) has it open
+ * for writing, and checks it is small enough to edit; size in bytes */
+static HANDLE open_text_file(const wchar_t *path, bpos *size) {
+    HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hFile == INVALID_HANDLE_VALUE) return;
-
+    if (hFile == INVALID_HANDLE_VALUE) return hFile;
     LARGE_INTEGER li_size;
     if (!GetFileSizeEx(hFile, &li_size) || li_size.QuadPart > (LONGLONG)(512 * 1024 * 1024)) {
         CloseHandle(hFile);
-        return;
+        return INVALID_HANDLE_VALUE;
     }
-    int size = (int)li_size.QuadPart;
+    *size = (bpos)li_size.QuadPart;
+    return hFile;
+}
 
-    char *raw = (char *)malloc(size + 1);
-    if (!raw) { CloseHandle(hFile); return; }
-    DWORD bytes_read = 0;
-    if (!ReadFile(hFile, raw, (DWORD)size, &bytes_read, NULL)) {
-        free(raw); CloseHandle(hFile); return;
+/* Decodes size bytes of hFile into dst, leaving a sequence split at the
+ * end in dec, and skipping a BOM if at_start. Returns the units written,
+ * or -1 if reading failed. */
+static bpos read_part(HANDLE hFile, bpos size, int at_start, wchar_t *dst, Utf8Decoder *dec) {
+    char *chunk = (char *)malloc(LOAD_CHUNK);
+    if (!chunk) return -1;
+    bpos left = size, wlen = 0;
+    int first = at_start, ok = 1;
+    while (left > 0) {
+        DWORD want = left < LOAD_CHUNK ? (DWORD)left : LOAD_CHUNK;
+        DWORD got = 0;
+        if (!ReadFile(hFile, chunk, want, &got, NULL)) { ok = 0; break; }
+        if (got == 0) break;
+        left -= got;
+        const char *p = chunk;
+        if (first && got >= 3 && (unsigned char)p[0] == 0xEF &&
+            (unsigned char)p[1] == 0xBB && (unsigned char)p[2] == 0xBF) {
+            p += 3;
+            got -= 3;
+        }
+        first = 0;
+        wlen += utf8_decode(dec, p, got, dst + wlen);
     }
-    raw[bytes_read] = 0;
-    CloseHandle(hFile);
-    size = (int)bytes_read;
+    free(chunk);
+    return ok ? wlen : -1;
+}
+
+/* Decodes all size bytes of hFile into dst, which needs size + 1 units.
+ * UTF-16 never needs more units than UTF-8 has bytes, plus one for a
+ * truncated final sequence. */
+static bpos read_text(HANDLE hFile, bpos size, wchar_t *dst, Utf8Decoder *dec) {
+    bpos wlen = read_part(hFile, size, 1, dst, dec);
+    if (wlen < 0) return -1;
+    return wlen + utf8_decode_end(dec, dst + wlen);
+}
 
-    char *start = raw;
-    if (size >= 3 && (unsigned char)raw[0] == 0xEF &&
-        (unsigned char)raw[1] == 0xBB && (unsigned char)raw[2] == 0xBF) {
-        start += 3;
-        size -= 3;
+wchar_t *read_text_file(const wchar_t *path, bpos *len, bpos *bytes) {
+    bpos size;
+    HANDLE hFile = open_text_file(path, &size);
+    if (hFile == INVALID_HANDLE_VALUE) return NULL;
+    wchar_t *text = (wchar_t *)malloc((size + 1) * sizeof(wchar_t));
+    Utf8Decoder dec;
+    utf8_decoder_init(&dec);
+    bpos wlen = text ? read_text(hFile, size, text, &dec) : -1;
+    utf8_decoder_free(&dec);
+    CloseHandle(hFile);
+    if (wlen < 0) {
+        free(text);
+        return NULL;
     }
+    *len = wlen;
+    *bytes = size;
+    return text;
+}
 
-    int wlen = MultiByteToWideChar(CP_UTF8, 0, start, (int)size, NULL, 0);
-    wchar_t *wtext = (wchar_t *)malloc((wlen + 1) * sizeof(wchar_t));
-    if (!wtext) { free(raw); return; }
-    MultiByteToWideChar(CP_UTF8, 0, start, (int)size, wtext, wlen);
-    wtext[wlen] = 0;
-    free(raw);
+/* Text read but not yet in a document: reserved in gb, uncommitted,
+ * with its line starts in dec */
+typedef struct {
+    GapBuffer gb;
+    bpos len;
+    Utf8Decoder dec;
+} LoadedText;
+
+static int load_read(const wchar_t *path, LoadedText *t) {
+    bpos size;
+    HANDLE hFile = open_text_file(path, &size);
+    if (hFile == INVALID_HANDLE_VALUE) return 0;
 
-    int j = 0;
-    for (int i = 0; i < wlen; i++) {
-        if (wtext[i] != L'\r') wtext[j++] = wtext[i];
+    memset(&t->gb, 0, sizeof(t->gb));
+    gb_init(&t->gb, size + 1 + GAP_INIT);
+    wchar_t *dst = gb_append_reserve(&t->gb, size + 1);
+    if (!dst) {
+        gb_free(&t->gb);
+        CloseHandle(hFile);
+        return 0;
     }
-    wtext[j] = 0;
 
-    gb_free(&doc->gb);
-    gb_init(&doc->gb, j + GAP_INIT);
-    gb_insert(&doc->gb, 0, wtext, j);
-    free(wtext);
+    utf8_decoder_init(&t->dec);
+    t->len = read_text(hFile, size, dst, &t->dec);
+    CloseHandle(hFile);
+    if (t->len < 0) {
+        utf8_decoder_free(&t->dec);
+        gb_free(&t->gb);
+        return 0;
+    }
+    return 1;
+}
+
+static void load_discard(LoadedText *t) {
+    utf8_decoder_free(&t->dec);
+    gb_free(&t->gb);
+}
 
+/* Path, title and, from the extension, mode */
+void set_doc_path(Document *doc, const wchar_t *path) {
     safe_wcscpy(doc->filepath, MAX_PATH, path);
     const wchar_t *slash = wcsrchr(path, L'\\');
     if (!slash) slash = wcsrchr(path, L'/');
@@ -69,7 +154,26 @@ void load_file(Document *doc, const wchar_t *path) {
             doc->mode = MODE_PROSE;
         }
     }
+}
 
+/* Makes t the text of doc, which takes ownership of it */
+static void load_apply(Document *doc, const wchar_t *path, LoadedText *t) {
+    gb_free(&doc->gb);
+    t->gb.on_edit = doc->gb.on_edit;
+    t->gb.edit_ctx = doc->gb.edit_ctx;
+    t->gb.mutation = doc->gb.mutation + 1;
+    doc->gb = t->gb;
+    gb_append_commit(&doc->gb, t->len);
+
+    int lines_ok = !t->dec.lines_failed;
+    if (lines_ok) {
+        lc_adopt(&doc->lc, t->dec.lines, t->dec.line_count, t->dec.line_cap);
+        t->dec.lines = NULL;
+    }
+    utf8_decoder_free(&t->dec);
+
+    set_doc_path(doc, path);
+    doc->loading = 0;
     doc->cursor = 0;
     doc->sel_anchor = -1;
     doc->scroll_y = 0;
@@ -80,53 +184,452 @@ void load_file(Document *doc, const wchar_t *path) {
     doc->bc_cached_mutation = -1;
     doc->bc_cached_line = -1;
     undo_clear(&doc->undo);
-    recalc_lines(doc);
-    update_stats(doc);
+    if (lines_ok) {
+        if (doc->mode == MODE_PROSE && doc->wc.wrap_col > 0) doc->wrap_dirty = 1;
+    } else {
+        recalc_lines(doc);
+    }
+    watch_stamp(doc);
     snapshot_session_baseline(doc);
 }
 
-char *doc_to_utf8(Document *doc, int *out_len) {
+struct DocStream {
+    HANDLE file;
+    HANDLE thread;
+    bpos left;               /* bytes still to read */
+    wchar_t *buf;            /* the gap buffer's; text position p is at buf[p] */
+    bpos pos;                /* units decoded (thread) */
+    Utf8Decoder dec;         /* lines[0] is a placeholder; the rest are new */
+    volatile LONG cancel;
+
+    CRITICAL_SECTION lock;   /* guards the fields below */
+    bpos ready;              /* units decoded and not yet read by the UI */
+    bpos *lines;             /* line starts for the UI to take */
+    bpos line_count, line_cap;
+    int lines_failed;
+    int posted;              /* WM_FILE_LOADED sent and not yet handled */
+    int done, failed;
+};
+
+/* Hands what was decoded since the last call to the UI thread */
+static void stream_publish(DocStream *s, int done, int failed) {
+    EnterCriticalSection(&s->lock);
+    s->ready = s->pos;
+    bpos n = s->dec.line_count - 1;
+    if (s->dec.lines_failed) s->lines_failed = 1;
+    if (n > 0 && !s->lines_failed) {
+        if (s->line_count + n > s->line_cap) {
+            bpos cap = s->line_cap ? s->line_cap : 1024;
+            while (cap < s->line_count + n) cap *= 2;
+            bpos *nl = (bpos *)realloc(s->lines, cap * sizeof(bpos));
+            if (nl) {
+                s->lines = nl;
+                s->line_cap = cap;
+            } else {
+                s->lines_failed = 1;
+            }
+        }
+        if (!s->lines_failed) {
+            memcpy(s->lines + s->line_count, s->dec.lines + 1, n * sizeof(bpos));
+            s->line_count += n;
+        }
+    }
+    if (s->dec.line_count > 0) s->dec.line_count = 1;
+    s->done = done;
+    s->failed = failed;
+    int post = !s->posted;
+    s->posted = 1;
+    LeaveCriticalSection(&s->lock);
+    if (post) PostMessageW(g_editor.hwnd, WM_FILE_LOADED, 0, 0);
+}
+
+static DWORD WINAPI stream_thread(LPVOID param) {
+    DocStream *s = (DocStream *)param;
+    char *chunk = (char *)malloc(LOAD_CHUNK);
+    int failed = !chunk;
+    while (!failed && s->left > 0 && !s->cancel) {
+        DWORD want = s->left < LOAD_CHUNK ? (DWORD)s->left : LOAD_CHUNK, got = 0;
+        if (!ReadFile(s->file, chunk, want, &got, NULL)) {
+            failed = 1;
+            break;
+        }
+        if (got == 0) break;   /* shorter than it was */
+        s->left -= got;
+        s->pos += utf8_decode(&s->dec, chunk, got, s->buf + s->pos);
+        stream_publish(s, 0, 0);
+    }
+    free(chunk);
+    if (!failed) s->pos += utf8_decode_end(&s->dec, s->buf + s->pos);
+    stream_publish(s, 1, failed);
+    return 0;
+}
+
+static void stream_close(Document *doc) {
+    DocStream *s = doc->stream;
+    doc->stream = NULL;
+    InterlockedExchange(&s->cancel, 1);
+    if (s->thread) {
+        WaitForSingleObject(s->thread, INFINITE);
+        CloseHandle(s->thread);
+    }
+    CloseHandle(s->file);
+    utf8_decoder_free(&s->dec);
+    free(s->lines);
+    DeleteCriticalSection(&s->lock);
+    free(s);
+}
+
+/* Commits the text the stream has decoded since the last call */
+static int stream_update(Document *doc) {
+    DocStream *s = doc->stream;
+    EnterCriticalSection(&s->lock);
+    bpos ready = s->ready;
+    bpos *lines = s->lines;
+    bpos line_count = s->line_count;
+    int lines_ok = !s->lines_failed;
+    int done = s->done, failed = s->failed;
+    s->lines = NULL;
+    s->line_count = s->line_cap = 0;
+    s->posted = 0;
+    LeaveCriticalSection(&s->lock);
+
     GapBuffer *gb = &doc->gb;
-    bpos len = gb_length(gb);
+    bpos first_line = doc->lc.count - 1;
+    if (ready > gb_length(gb)) {
+        int live = doc->analytics.live;
+        doc->analytics.live = 0;   /* the file, not typing */
+        gb_append_commit(gb, ready - gb_length(gb));
+        doc->analytics.live = live;
+        if (!lines_ok || !lc_notify_append(&doc->lc, lines, line_count)) {
+            /* Rebuilt whole once the rest is in */
+            doc->lc.dirty = 1;
+        } else if (doc->mode == MODE_PROSE && doc->wc.wrap_col > 0 && !doc->wrap_dirty) {
+            wc_extend(&doc->wc, gb, &doc->lc, first_line);
+        }
+    }
+    free(lines);
+    if (!done) return 0;
+
+    stream_close(doc);
+    doc->loading = 0;
+    if (doc->lc.dirty) recalc_lines(doc);
+    if (failed) {
+        /* Only part of the file is here; detached from its path, so no
+         * save, session or recovered shadow can write it back over the
+         * whole. The title stays. */
+        wchar_t msg[MAX_PATH + 96];
+        swprintf(msg, MAX_PATH + 96,
+                 L"The rest of \"%ls\" could not be read. The part shown is not linked to the file.",
+                 doc->filepath);
+        doc->filepath[0] = 0;
+        MessageBoxW(g_editor.hwnd, msg, L"Prose_Code", MB_OK | MB_ICONWARNING);
+    }
+    watch_stamp(doc);
+    snapshot_session_baseline(doc);
+    session_place(doc);
+    return 1;
+}
+
+/* Shows the first LOAD_CHUNK of a large file at once and starts a
+ * thread on the rest; 0 if it could not, to load it whole instead */
+static int load_stream(Document *doc, const wchar_t *path) {
+    bpos size;
+    HANDLE hFile = open_text_file(path, &size);
+    if (hFile == INVALID_HANDLE_VALUE) return 0;
+    DocStream *s = (DocStream *)calloc(1, sizeof(DocStream));
+    LoadedText t;
+    memset(&t.gb, 0, sizeof(t.gb));
+    gb_init(&t.gb, size + 1 + GAP_INIT);
+    wchar_t *dst = s ? gb_append_reserve(&t.gb, size + 1) : NULL;
+    if (!dst) {
+        gb_free(&t.gb);
+        free(s);
+        CloseHandle(hFile);
+        return 0;
+    }
+    utf8_decoder_init(&s->dec);
+    t.len = read_part(hFile, LOAD_CHUNK, 1, dst, &s->dec);
+    if (t.len < 0) {
+        utf8_decoder_free(&s->dec);
+        gb_free(&t.gb);
+        free(s);
+        CloseHandle(hFile);
+        return 0;
+    }
+
+    /* The line starts so far go to the line cache; the stream's decoder
+     * carries on, from the text's end, with a new list */
+    t.dec = s->dec;
+    s->dec.line_cap = 1024;
+    s->dec.lines = (ptrdiff_t *)malloc(s->dec.line_cap * sizeof(ptrdiff_t));
+    s->dec.line_count = s->dec.lines ? 1 : 0;
+    s->dec.lines_failed = s->dec.lines == NULL;
+    load_apply(doc, path, &t);
+
+    s->file = hFile;
+    s->left = size - LOAD_CHUNK;
+    s->buf = doc->gb.buf;
+    s->pos = gb_length(&doc->gb);
+    s->ready = s->pos;
+    InitializeCriticalSection(&s->lock);
+    doc->stream = s;
+    doc->loading = 1;
+    s->thread = CreateThread(NULL, 0, stream_thread, s, 0, NULL);
+    if (!s->thread) stream_thread(s);
+    return 1;
+}
+
+static int load_file_as(Document *doc, const wchar_t *path, int stream) {
+    WIN32_FILE_ATTRIBUTE_DATA fa;
+    if (stream && GetFileAttributesExW(path, GetFileExInfoStandard, &fa) &&
+        ((unsigned long long)fa.nFileSizeHigh << 32 | fa.nFileSizeLow) > LOAD_STREAM_MIN &&
+        load_stream(doc, path))
+        return 1;
+    LoadedText t;
+    if (!load_read(path, &t)) return 0;
+    load_apply(doc, path, &t);
+    return 1;
+}
+
+/* 0 if the file could not be read, leaving doc as it was */
+int load_file(Document *doc, const wchar_t *path) {
+    return load_file_as(doc, path, 1);
+}
+
+/* As load_file, but all of the file is in doc on return, for callers
+ * that go on to search or edit it */
+int load_file_whole(Document *doc, const wchar_t *path) {
+    return load_file_as(doc, path, 0);
+}
+
+/* doc_free: stops a stream still reading into doc */
+void load_cancel(Document *doc) {
+    if (doc->stream) stream_close(doc);
+}
+
+static Document *doc_by_id(unsigned int id) {
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        if (g_editor.tabs[i]->autosave_id == id) return g_editor.tabs[i];
+    }
+    return NULL;
+}
 
-    if (len == 0) {
-        char *empty = (char *)malloc(1);
-        if (empty) empty[0] = 0;
-        *out_len = 0;
-        return empty;
+typedef struct LoadJob {
+    struct LoadJob *next;
+    unsigned int doc_id;     /* Document.autosave_id */
+    int ok;
+    LoadedText text;
+    wchar_t path[MAX_PATH];
+} LoadJob;
+
+static CRITICAL_SECTION g_load_lock;
+static int g_load_init;
+static LoadJob *g_load_done;
+
+static void load_task(void *arg) {
+    LoadJob *job = (LoadJob *)arg;
+    job->ok = load_read(job->path, &job->text);
+    EnterCriticalSection(&g_load_lock);
+    job->next = g_load_done;
+    g_load_done = job;
+    LeaveCriticalSection(&g_load_lock);
+    PostMessageW(g_editor.hwnd, WM_FILE_LOADED, 0, 0);
+}
+
+static void full_path(const wchar_t *path, wchar_t *out) {
+    DWORD n = GetFullPathNameW(path, MAX_PATH, out, NULL);
+    if (n == 0 || n >= MAX_PATH) safe_wcscpy(out, MAX_PATH, path);
+}
+
+/* Index of the tab holding path (relative or not), or -1 */
+int tab_with_path(const wchar_t *path) {
+    wchar_t want[MAX_PATH], have[MAX_PATH];
+    full_path(path, want);
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        if (!g_editor.tabs[i]->filepath[0]) continue;
+        full_path(g_editor.tabs[i]->filepath, have);
+        if (_wcsicmp(have, want) == 0) return i;
     }
+    return -1;
+}
 
-    wchar_t *text = (wchar_t *)malloc((len + 1) * sizeof(wchar_t));
-    if (!text) { *out_len = 0; return NULL; }
-    gb_copy_range(gb, 0, len, text);
-    text[len] = 0;
+/* Opens each path in a new tab, the last one active, with the reading
+ * done on the pool. An empty untitled tab is reused as in
+ * open_file_in_tab, and a file already open (say, restored from the
+ * last session) is switched to rather than opened twice. */
+void open_files(const wchar_t *const *paths, int count) {
+    if (!g_load_init) {
+        InitializeCriticalSection(&g_load_lock);
+        g_load_init = 1;
+    }
+    for (int i = 0; i < count; i++) {
+        int open = tab_with_path(paths[i]);
+        if (open >= 0) {
+            activate_tab(open);
+            continue;
+        }
+        LoadJob *job = (LoadJob *)calloc(1, sizeof(LoadJob));
+        if (!job) return;
+        Document *doc = current_doc();
+        if (!doc || doc->modified || doc->filepath[0] || doc->is_results || doc->loading ||
+            gb_length(&doc->gb) > 0) {
+            if (g_editor.tab_count >= MAX_TABS) {
+                free(job);
+                return;
+            }
+            doc = doc_create();
+            g_editor.tabs[g_editor.tab_count] = doc;
+            g_editor.active_tab = g_editor.tab_count;
+            g_editor.tab_count++;
+        }
+        set_doc_path(doc, paths[i]);
+        doc->loading = 1;
+        job->doc_id = doc->autosave_id;
+        safe_wcscpy(job->path, MAX_PATH, paths[i]);
+        pool_submit(load_task, job);
+    }
+}
 
-    bpos newlines = 0;
-    for (bpos i = 0; i < len; i++) {
-        if (text[i] == L'\n') newlines++;
+/* WM_FILE_LOADED: installs the text of every file read since, and what
+ * streams have decoded */
+void load_on_done(void) {
+    int settled = 0;
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        if (g_editor.tabs[i]->stream) settled |= stream_update(g_editor.tabs[i]);
+    }
+    if (g_load_init) {
+        EnterCriticalSection(&g_load_lock);
+        LoadJob *done = g_load_done;
+        g_load_done = NULL;
+        LeaveCriticalSection(&g_load_lock);
+
+        while (done) {
+            LoadJob *next = done->next;
+            Document *doc = doc_by_id(done->doc_id);
+            if (doc && doc->loading) {
+                if (done->ok) {
+                    load_apply(doc, done->path, &done->text);
+                    done->ok = 0;
+                    settled = 1;
+                } else {
+                    /* Nothing to show; drop the tab it was to fill */
+                    for (int i = 0; i < g_editor.tab_count; i++) {
+                        if (g_editor.tabs[i] == doc) {
+                            close_tab(i);
+                            break;
+                        }
+                    }
+                }
+            }
+            if (done->ok) load_discard(&done->text);
+            free(done);
+            done = next;
+        }
     }
 
-    wchar_t *winfmt = (wchar_t *)malloc((len + newlines + 1) * sizeof(wchar_t));
-    if (!winfmt) { free(text); *out_len = 0; return NULL; }
-    bpos j = 0;
-    for (bpos i = 0; i < len; i++) {
-        if (text[i] == L'\n') winfmt[j++] = L'\r';
-        winfmt[j++] = text[i];
+    /* doc_on_edit kept search off the text while it came in; the index
+     * and misspellings catch up on their own once loading is clear */
+    if (settled && g_editor.search.active) search_update_matches();
+}
+
+/* After pool_shutdown: frees files read but never installed */
+void load_shutdown(void) {
+    if (!g_load_init) return;
+    while (g_load_done) {
+        LoadJob *next = g_load_done->next;
+        if (g_load_done->ok) load_discard(&g_load_done->text);
+        free(g_load_done);
+        g_load_done = next;
     }
-    winfmt[j] = 0;
-    free(text);
+    DeleteCriticalSection(&g_load_lock);
+    g_load_init = 0;
+}
+
+/* ── Saving ──
+ * Text is encoded (utf8.c) from at most two segments, such as the
+ * halves of a gap buffer, into a SAVE_CHUNK buffer that is written out
+ * whenever it fills. Compressed writes store each buffer as one block:
+ * its length, its stored length, then the LZ data (lz.c), or the bytes
+ * as they were when compressing would not shrink them. */
+
+#define SAVE_CHUNK (256 * 1024)
+#define BLOCK_HEAD 8
+
+static int write_all(HANDLE h, const char *data, size_t n) {
+    DWORD written;
+    return WriteFile(h, data, (DWORD)n, &written, NULL) && written == (DWORD)n;
+}
 
-    int utf8len = WideCharToMultiByte(CP_UTF8, 0, winfmt, (int)j, NULL, 0, NULL, NULL);
-    char *utf8 = (char *)malloc(utf8len);
-    if (!utf8) { free(winfmt); *out_len = 0; return NULL; }
-    WideCharToMultiByte(CP_UTF8, 0, winfmt, (int)j, utf8, utf8len, NULL, NULL);
-    free(winfmt);
+static int read_all(HANDLE h, char *data, DWORD n) {
+    DWORD got;
+    return ReadFile(h, data, n, &got, NULL) && got == n;
+}
+
+static void put_u32(char *p, unsigned int v) {
+    p[0] = (char)(v & 0xFF);
+    p[1] = (char)((v >> 8) & 0xFF);
+    p[2] = (char)((v >> 16) & 0xFF);
+    p[3] = (char)((v >> 24) & 0xFF);
+}
+
+static unsigned int get_u32(const char *p) {
+    return (unsigned char)p[0] | ((unsigned char)p[1] << 8) |
+           ((unsigned char)p[2] << 16) | ((unsigned int)(unsigned char)p[3] << 24);
+}
 
-    *out_len = utf8len;
-    return utf8;
+/* zbuf holds BLOCK_HEAD + SAVE_CHUNK bytes */
+static int write_block(HANDLE h, const DocWrite *w, const char *data, size_t n, char *zbuf) {
+    if (n == 0) return 1;
+    if (!w->compress) return write_all(h, data, n);
+    size_t z = lz_compress(data, n, zbuf + BLOCK_HEAD, n - 1);
+    put_u32(zbuf, (unsigned int)n);
+    put_u32(zbuf + 4, (unsigned int)(z ? z : n));
+    if (z) return write_all(h, zbuf, BLOCK_HEAD + z);
+    return write_all(h, zbuf, BLOCK_HEAD) && write_all(h, data, n);
 }
 
-int write_file_atomic(const wchar_t *final_path, const char *data, int data_len) {
+int write_doc_utf8(HANDLE h, void *ctx) {
+    DocWrite *w = (DocWrite *)ctx;
+    char *out = (char *)malloc(SAVE_CHUNK);
+    char *zbuf = w->compress ? (char *)malloc(BLOCK_HEAD + SAVE_CHUNK) : NULL;
+    if (!out || (w->compress && !zbuf)) {
+        free(out);
+        free(zbuf);
+        return 0;
+    }
+    int ok = w->head_len == 0 || write_all(h, w->head, w->head_len);
+
+    Utf8Encoder enc;
+    utf8_encoder_init(&enc, 1);
+    size_t used = 0;
+    for (int s = 0; s < 2 && ok; s++) {
+        bpos i = 0;
+        while (ok && i < w->seg_len[s]) {
+            bpos room = (bpos)((SAVE_CHUNK - used) / 3) - 1;
+            if (room < 1024) {
+                ok = write_block(h, w, out, used, zbuf);
+                used = 0;
+                continue;
+            }
+            bpos n = w->seg_len[s] - i < room ? w->seg_len[s] - i : room;
+            used += utf8_encode(&enc, w->seg[s] + i, n, out + used);
+            i += n;
+        }
+    }
+    if (ok && SAVE_CHUNK - used < 3) {
+        ok = write_block(h, w, out, used, zbuf);
+        used = 0;
+    }
+    if (ok) {
+        used += utf8_encode_end(&enc, out + used);
+        ok = write_block(h, w, out, used, zbuf);
+    }
+    free(out);
+    free(zbuf);
+    return ok;
+}
+
+int write_file_atomic(const wchar_t *final_path, FileWriteFn write, void *ctx) {
     wchar_t tmp_path[MAX_PATH + 16];
     swprintf(tmp_path, MAX_PATH + 16, L"%ls.tmp~", final_path);
 
@@ -134,9 +637,7 @@ int write_file_atomic(const wchar_t *final_path, const char *data, int data_len)
                                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
     if (hFile == INVALID_HANDLE_VALUE) return 0;
 
-    DWORD written;
-    BOOL ok = WriteFile(hFile, data, (DWORD)data_len, &written, NULL);
-    if (!ok || (int)written != data_len) {
+    if (!write(hFile, ctx)) {
         CloseHandle(hFile);
         DeleteFileW(tmp_path);
         return 0;
@@ -165,23 +666,372 @@ int write_file_atomic(const wchar_t *final_path, const char *data, int data_len)
     return 0;
 }
 
-void save_file(Document *doc, const wchar_t *path) {
-    int utf8len;
-    char *utf8 = doc_to_utf8(doc, &utf8len);
-    if (!utf8) return;
-
-    if (write_file_atomic(path, utf8, utf8len)) {
-        doc->modified = 0;
-        doc->undo.save_point = doc->undo.current;
-        safe_wcscpy(doc->filepath, MAX_PATH, path);
-        const wchar_t *slash = wcsrchr(path, L'\\');
-        if (!slash) slash = wcsrchr(path, L'/');
-        safe_wcscpy(doc->title, 64, slash ? slash + 1 : path);
+/* ── Edit journal files ──
+ * Next to each autosave checkpoint (.pctmp) sits a journal (.pcjnl) of
+ * the edits made since: a header naming the checkpoint's generation,
+ * then one record per edit. A record is the edit position, the length
+ * removed and the UTF-16 text inserted there, with an FNV-1a check over
+ * all of it so a torn final record is dropped on replay. A checkpoint
+ * resets the journal only after it is safely in place; if that reset
+ * never happens, the old journal's generation no longer matches and
+ * replay ignores it. */
+
+#define JOURNAL_MAX_TEXT         (1 << 20)            /* larger inserts checkpoint instead */
+#define JOURNAL_CHECKPOINT_BYTES (8 * 1024 * 1024)
+#define JOURNAL_CHECKPOINT_MS    (5 * 60 * 1000)
+#define JOURNAL_RETRY_MS         30000                /* after a failed checkpoint */
+
+typedef struct {
+    char magic[4];           /* "PCJ1" */
+    unsigned int gen;
+} JournalHeader;
+
+typedef struct {
+    long long pos;
+    long long removed;
+    unsigned int count;      /* UTF-16 units inserted, which follow */
+    unsigned int check;
+} JournalRecord;
+
+static unsigned int fnv32(unsigned int h, const void *data, size_t n) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
 
-        autosave_delete_for_doc(doc);
+static unsigned int record_check(const JournalRecord *r, const wchar_t *text) {
+    unsigned int h = fnv32(2166136261u, r, offsetof(JournalRecord, check));
+    return fnv32(h, text, r->count * sizeof(wchar_t));
+}
+
+/* foo.pctmp -> foo.pcjnl */
+static void journal_path(const wchar_t *shadow, wchar_t *out) {
+    safe_wcscpy(out, MAX_PATH + 32, shadow);
+    wchar_t *dot = wcsrchr(out, L'.');
+    if (dot) safe_wcscpy(dot, MAX_PATH + 32 - (int)(dot - out), L".pcjnl");
+}
+
+static int journal_reset(const wchar_t *shadow, unsigned int gen) {
+    wchar_t path[MAX_PATH + 32];
+    journal_path(shadow, path);
+    HANDLE h = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return 0;
+    JournalHeader hdr = { { 'P', 'C', 'J', '1' }, gen };
+    int ok = write_all(h, (const char *)&hdr, sizeof(hdr)) && FlushFileBuffers(h);
+    CloseHandle(h);
+    return ok;
+}
+
+/* Appends records to a journal that still follows checkpoint gen */
+static int journal_append(const wchar_t *shadow, unsigned int gen, const char *data, size_t len) {
+    wchar_t path[MAX_PATH + 32];
+    journal_path(shadow, path);
+    HANDLE h = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return 0;
+    JournalHeader hdr;
+    DWORD got = 0;
+    LARGE_INTEGER zero = { 0 };
+    int ok = ReadFile(h, &hdr, sizeof(hdr), &got, NULL) && got == sizeof(hdr) &&
+             memcmp(hdr.magic, "PCJ1", 4) == 0 && hdr.gen == gen &&
+             SetFilePointerEx(h, zero, NULL, FILE_END) &&
+             write_all(h, data, len) && FlushFileBuffers(h);
+    CloseHandle(h);
+    return ok;
+}
+
+/* Applies the journal next to shadow to doc if it follows checkpoint
+ * gen, stopping at the first record that is torn or does not fit */
+static void journal_replay(Document *doc, const wchar_t *shadow, unsigned int gen) {
+    wchar_t path[MAX_PATH + 32];
+    journal_path(shadow, path);
+    HANDLE h = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return;
+    JournalHeader hdr;
+    DWORD got = 0;
+    if (!ReadFile(h, &hdr, sizeof(hdr), &got, NULL) || got != sizeof(hdr) ||
+        memcmp(hdr.magic, "PCJ1", 4) != 0 || hdr.gen != gen) {
+        CloseHandle(h);
+        return;
+    }
+    wchar_t *text = NULL;
+    unsigned int text_cap = 0;
+    for (;;) {
+        JournalRecord r;
+        if (!ReadFile(h, &r, sizeof(r), &got, NULL) || got != sizeof(r)) break;
+        if (r.count > JOURNAL_MAX_TEXT) break;
+        if (r.count > text_cap) {
+            wchar_t *nt = (wchar_t *)realloc(text, r.count * sizeof(wchar_t));
+            if (!nt) break;
+            text = nt;
+            text_cap = r.count;
+        }
+        DWORD bytes = r.count * (DWORD)sizeof(wchar_t);
+        if (bytes && (!ReadFile(h, text, bytes, &got, NULL) || got != bytes)) break;
+        if (record_check(&r, text) != r.check) break;
+        bpos len = gb_length(&doc->gb);
+        if (r.pos < 0 || r.removed < 0 || r.pos + r.removed > len) break;
+        gb_delete(&doc->gb, (bpos)r.pos, (bpos)r.removed);
+        gb_insert(&doc->gb, (bpos)r.pos, text, r.count);
+    }
+    free(text);
+    CloseHandle(h);
+}
+
+/* ── Background writer ──
+ * Saves, autosave checkpoints and journal appends are written on one
+ * thread, in the order they were asked for. Each save or checkpoint
+ * holds a snapshot of the text (document.c) taken on the UI thread, so
+ * typing carries on against the live buffer while the snapshot is
+ * encoded and flushed. Finished jobs come back on a done list, and
+ * WM_SAVE_DONE has the window apply them; a save clears `modified` only
+ * if nothing was typed after its snapshot. save_flush waits for
+ * everything queued when a caller needs the outcome. */
+
+enum { SAVE_FILE, SAVE_SHADOW, SAVE_JOURNAL };
+
+typedef struct SaveJob {
+    struct SaveJob *next;
+    int kind;
+    unsigned int doc_id;     /* Document.autosave_id */
+    int mutation;            /* of the snapshot */
+    int undo_point;
+    int ok;
+    unsigned int gen;        /* checkpoint generation (shadow, journal) */
+    char *data;              /* journal records to append */
+    size_t data_len;
+    DocSnapshot *snap;
+    DocWrite w;
+    wchar_t path[MAX_PATH + 32];
+    char head[4 + 2048];
+} SaveJob;
+
+static CRITICAL_SECTION g_save_lock;
+static HANDLE g_save_sem;
+static HANDLE g_save_idle;           /* set while nothing is queued or running */
+static HANDLE g_save_thread;
+static SaveJob *g_save_head, *g_save_tail;
+static SaveJob *g_save_done;
+static int g_save_pending;
+static int g_saves_unapplied;        /* SAVE_FILE jobs not yet applied (UI thread) */
+static volatile LONG g_save_quit;
+
+static DWORD WINAPI save_thread(LPVOID param) {
+    (void)param;
+    for (;;) {
+        WaitForSingleObject(g_save_sem, INFINITE);
+        EnterCriticalSection(&g_save_lock);
+        SaveJob *job = g_save_head;
+        if (job) {
+            g_save_head = job->next;
+            if (!g_save_head) g_save_tail = NULL;
+        }
+        LeaveCriticalSection(&g_save_lock);
+        if (!job) {
+            if (g_save_quit) return 0;
+            continue;
+        }
+
+        if (job->kind == SAVE_JOURNAL) {
+            job->ok = journal_append(job->path, job->gen, job->data, job->data_len);
+        } else {
+            job->ok = write_file_atomic(job->path, write_doc_utf8, &job->w);
+            if (job->ok && job->kind == SAVE_SHADOW) job->ok = journal_reset(job->path, job->gen);
+        }
+        snapshot_release(job->snap);
+        job->snap = NULL;
+        free(job->data);
+        job->data = NULL;
+
+        EnterCriticalSection(&g_save_lock);
+        job->next = g_save_done;
+        g_save_done = job;
+        if (--g_save_pending == 0) SetEvent(g_save_idle);
+        LeaveCriticalSection(&g_save_lock);
+        PostMessageW(g_editor.hwnd, WM_SAVE_DONE, 0, 0);
+    }
+}
+
+static int save_start(void) {
+    if (g_save_thread) return 1;
+    if (!g_save_sem) {
+        InitializeCriticalSection(&g_save_lock);
+        g_save_sem = CreateSemaphoreW(NULL, 0, 0x7fffffff, NULL);
+        g_save_idle = CreateEventW(NULL, TRUE, TRUE, NULL);
+    }
+    if (!g_save_sem || !g_save_idle) return 0;
+    g_save_thread = CreateThread(NULL, 0, save_thread, NULL, 0, NULL);
+    return g_save_thread != NULL;
+}
+
+static void save_queue(SaveJob *job) {
+    EnterCriticalSection(&g_save_lock);
+    if (g_save_tail) g_save_tail->next = job;
+    else g_save_head = job;
+    g_save_tail = job;
+    if (g_save_pending++ == 0) ResetEvent(g_save_idle);
+    LeaveCriticalSection(&g_save_lock);
+    ReleaseSemaphore(g_save_sem, 1, NULL);
+}
+
+/* Queues a write of doc's current text to path; 0 if it could not be */
+static int save_submit(Document *doc, int kind, const wchar_t *path,
+                       const char *head, int head_len, unsigned int gen) {
+    SaveJob *job = (SaveJob *)calloc(1, sizeof(SaveJob));
+    if (!job) return 0;
+    job->snap = doc_snapshot(doc);
+    if (!job->snap || !save_start()) {
+        snapshot_release(job->snap);
+        free(job);
+        return 0;
+    }
+    job->kind = kind;
+    job->doc_id = doc->autosave_id;
+    job->mutation = job->snap->mutation;
+    job->undo_point = doc->undo.current;
+    job->gen = gen;
+    safe_wcscpy(job->path, MAX_PATH + 32, path);
+    if (head_len > (int)sizeof(job->head)) head_len = (int)sizeof(job->head);
+    if (head_len > 0) memcpy(job->head, head, head_len);
+    job->w.seg[0] = job->snap->text;
+    job->w.seg_len[0] = job->snap->len;
+    job->w.head = job->head;
+    job->w.head_len = head_len;
+    job->w.compress = kind == SAVE_SHADOW;
+    if (kind == SAVE_FILE) g_saves_unapplied++;
+    save_queue(job);
+    return 1;
+}
+
+/* Takes doc's queued checkpoint and journal writes off the queue, so none
+ * can bring back a shadow deleted after a save. Their semaphore counts
+ * are left for save_thread to skip. */
+static void save_drop_shadow_jobs(unsigned int doc_id) {
+    EnterCriticalSection(&g_save_lock);
+    SaveJob **link = &g_save_head, *last = NULL;
+    while (*link) {
+        SaveJob *job = *link;
+        if (job->doc_id == doc_id && job->kind != SAVE_FILE) {
+            *link = job->next;
+            snapshot_release(job->snap);
+            free(job->data);
+            free(job);
+            if (--g_save_pending == 0) SetEvent(g_save_idle);
+        } else {
+            last = job;
+            link = &job->next;
+        }
+    }
+    g_save_tail = last;
+    LeaveCriticalSection(&g_save_lock);
+}
+
+static void delete_shadow(Document *doc) {
+    wchar_t shadow_path[MAX_PATH + 32], jnl[MAX_PATH + 32];
+    autosave_path_for_doc(doc, shadow_path);
+    journal_path(shadow_path, jnl);
+    DeleteFileW(shadow_path);
+    DeleteFileW(jnl);
+}
+
+static void journal_clear(EditJournal *j) {
+    j->len = 0;
+    j->gen = 0;
+    j->disk = 0;
+    j->broken = 0;
+}
+
+static void save_apply(SaveJob *job) {
+    Document *doc = doc_by_id(job->doc_id);
+    if (!doc) return;
+    if (job->kind != SAVE_FILE) {
+        /* The journal on disk no longer follows this checkpoint; the next
+         * tick writes a new one */
+        if (!job->ok && doc->journal.gen == job->gen) {
+            journal_clear(&doc->journal);
+            doc->journal.failed = job->kind == SAVE_SHADOW;
+        } else if (job->ok && !doc->journal.gen) {
+            /* Was already writing when a save retired the shadow */
+            delete_shadow(doc);
+        }
+        return;
+    }
+    if (!job->ok) {
+        wchar_t msg[MAX_PATH + 64];
+        swprintf(msg, MAX_PATH + 64, L"Could not save \"%ls\".", job->path);
+        MessageBoxW(g_editor.hwnd, msg, L"Prose_Code", MB_OK | MB_ICONWARNING);
+        return;
+    }
+    int unchanged = doc->gb.mutation == job->mutation;
+    doc->modified = !unchanged;
+    doc->undo.save_point = job->undo_point;
+    safe_wcscpy(doc->filepath, MAX_PATH, job->path);
+    const wchar_t *slash = wcsrchr(job->path, L'\\');
+    if (!slash) slash = wcsrchr(job->path, L'/');
+    safe_wcscpy(doc->title, 64, slash ? slash + 1 : job->path);
+    watch_stamp(doc);
+
+    /* A shadow written after this snapshot holds newer text; keep it */
+    if (unchanged) {
+        save_drop_shadow_jobs(doc->autosave_id);
+        delete_shadow(doc);
+        journal_clear(&doc->journal);
         doc->autosave_mutation_snapshot = doc->gb.mutation;
     }
-    free(utf8);
+}
+
+/* Applies finished jobs, oldest first */
+void save_on_done(void) {
+    if (!g_save_sem) return;
+    EnterCriticalSection(&g_save_lock);
+    SaveJob *done = g_save_done;
+    g_save_done = NULL;
+    LeaveCriticalSection(&g_save_lock);
+
+    SaveJob *rev = NULL;
+    while (done) {
+        SaveJob *next = done->next;
+        done->next = rev;
+        rev = done;
+        done = next;
+    }
+    while (rev) {
+        SaveJob *next = rev->next;
+        if (rev->kind == SAVE_FILE) g_saves_unapplied--;
+        save_apply(rev);
+        free(rev);
+        rev = next;
+    }
+}
+
+/* Waits for every queued write, then applies the results */
+/* Nonzero while a save may have written its file but not yet updated
+ * the document, so a change on disk could be our own */
+int save_busy(void) {
+    return g_saves_unapplied > 0;
+}
+
+void save_flush(void) {
+    if (g_save_idle) WaitForSingleObject(g_save_idle, INFINITE);
+    save_on_done();
+}
+
+void save_shutdown(void) {
+    save_flush();
+    if (g_save_thread) {
+        InterlockedExchange(&g_save_quit, 1);
+        ReleaseSemaphore(g_save_sem, 1, NULL);
+        WaitForSingleObject(g_save_thread, INFINITE);
+        CloseHandle(g_save_thread);
+        g_save_thread = NULL;
+    }
+}
+
+void save_file(Document *doc, const wchar_t *path) {
+    if (doc->loading) return;   /* would write the empty placeholder */
+    save_submit(doc, SAVE_FILE, path, NULL, 0, 0);
 }
 
 /* ── Autosave shadow file system ── */
@@ -221,6 +1071,12 @@ void autosave_path_for_doc(Document *doc, wchar_t *out) {
     }
 }
 
+/* Search index for a file-backed document; kept across sessions. */
+void autosave_index_path(Document *doc, wchar_t *out) {
+    autosave_ensure_dir();
+    swprintf(out, MAX_PATH + 32, L"%ls\\%08x.pcidx", g_editor.autosave_dir, path_hash(doc->filepath));
+}
+
 static int json_escape_path(const char *src, char *dst, int dst_size) {
     int j = 0;
     for (int i = 0; src[i] && j < dst_size - 2; i++) {
@@ -235,75 +1091,146 @@ static int json_escape_path(const char *src, char *dst, int dst_size) {
     return j;
 }
 
-void autosave_write(Document *doc) {
-    int utf8len;
-    char *utf8 = doc_to_utf8(doc, &utf8len);
-    if (!utf8) return;
+/* ── Autosave ──
+ * Every tick, each modified document appends the journal records its
+ * edits produced since the last tick; that is the only disk I/O while
+ * typing. A full checkpoint is written when there is none yet, when
+ * the journal outgrows JOURNAL_CHECKPOINT_BYTES or gets older than
+ * JOURNAL_CHECKPOINT_MS, or when an edit could not be recorded. */
+
+static unsigned int g_journal_gen;
 
-    char header[2048];
+void autosave_write(Document *doc) {
+    char header[4 + 2048];
     char narrow_path[MAX_PATH * 3];
     char escaped_path[MAX_PATH * 6];
+    EditJournal *j = &doc->journal;
+    if (!g_journal_gen) g_journal_gen = GetTickCount();
+    if (++g_journal_gen == 0) g_journal_gen = 1;
+    unsigned int gen = g_journal_gen;
+
     WideCharToMultiByte(CP_UTF8, 0, doc->filepath, -1, narrow_path,
                         sizeof(narrow_path), NULL, NULL);
     json_escape_path(narrow_path, escaped_path, sizeof(escaped_path));
-    int hdr_len = snprintf(header, sizeof(header),
-        "{\"path\":\"%s\",\"time\":%u,\"chars\":%lld}\n",
-        escaped_path, (unsigned)GetTickCount(), (long long)gb_length(&doc->gb));
-    if (hdr_len < 0 || hdr_len >= (int)sizeof(header))
-        hdr_len = (int)sizeof(header) - 1;
-
-    int total = 4 + hdr_len + utf8len;
-    char *buf = (char *)malloc(total);
-    if (!buf) { free(utf8); return; }
-
-    buf[0] = (char)(hdr_len & 0xFF);
-    buf[1] = (char)((hdr_len >> 8) & 0xFF);
-    buf[2] = (char)((hdr_len >> 16) & 0xFF);
-    buf[3] = (char)((hdr_len >> 24) & 0xFF);
-    memcpy(buf + 4, header, hdr_len);
-    memcpy(buf + 4 + hdr_len, utf8, utf8len);
-    free(utf8);
+    int hdr_len = snprintf(header + 4, sizeof(header) - 4,
+        "{\"path\":\"%s\",\"time\":%u,\"chars\":%lld,\"gen\":%u,\"codec\":\"lz\"}\n",
+        escaped_path, (unsigned)GetTickCount(), (long long)gb_length(&doc->gb), gen);
+    if (hdr_len < 0 || hdr_len >= (int)sizeof(header) - 4)
+        hdr_len = (int)sizeof(header) - 5;
+
+    put_u32(header, (unsigned int)hdr_len);
 
     wchar_t shadow_path[MAX_PATH + 32];
     autosave_path_for_doc(doc, shadow_path);
-    write_file_atomic(shadow_path, buf, total);
-    free(buf);
+    j->checkpoint_time = GetTickCount();
+    if (!save_submit(doc, SAVE_SHADOW, shadow_path, header, 4 + hdr_len, gen)) return;
+
+    /* Everything recorded so far is in the checkpoint */
+    journal_clear(j);
+    j->gen = gen;
+    j->failed = 0;
+    doc->autosave_mutation_snapshot = doc->gb.mutation;
+    doc->autosave_last_time = GetTickCount();
+}
 
+/* Hands the records gathered since the last tick to the writer */
+static void journal_flush(Document *doc) {
+    EditJournal *j = &doc->journal;
+    if (!j->len || !save_start()) return;
+    SaveJob *job = (SaveJob *)calloc(1, sizeof(SaveJob));
+    if (!job) return;
+    job->kind = SAVE_JOURNAL;
+    job->doc_id = doc->autosave_id;
+    job->gen = j->gen;
+    job->data = j->buf;
+    job->data_len = j->len;
+    autosave_path_for_doc(doc, job->path);
+    j->disk += j->len;
+    j->buf = NULL;
+    j->len = j->cap = 0;
+    save_queue(job);
     doc->autosave_mutation_snapshot = doc->gb.mutation;
     doc->autosave_last_time = GetTickCount();
 }
 
 void autosave_tick(void) {
+    DWORD now = GetTickCount();
     for (int i = 0; i < g_editor.tab_count; i++) {
         Document *doc = g_editor.tabs[i];
-        if (!doc->modified) continue;
-        if (doc->gb.mutation == doc->autosave_mutation_snapshot) continue;
-        autosave_write(doc);
+        EditJournal *j = &doc->journal;
+        if (!doc->modified || doc->is_results) continue;
+        if (j->failed && now - j->checkpoint_time < JOURNAL_RETRY_MS) continue;
+        if (!j->gen || j->broken || j->disk + j->len > JOURNAL_CHECKPOINT_BYTES ||
+            (j->len && now - j->checkpoint_time > JOURNAL_CHECKPOINT_MS)) {
+            autosave_write(doc);
+        } else {
+            journal_flush(doc);
+        }
+    }
+}
+
+/* Records an edit while the document has a checkpoint to follow */
+void journal_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted) {
+    EditJournal *j = &doc->journal;
+    GapBuffer *gb = &doc->gb;
+    if (!gb->buf) {
+        /* gb_free: the old checkpoint describes other text */
+        journal_clear(j);
+        return;
+    }
+    if (!j->gen || j->broken || doc->is_results) return;
+    if (inserted > JOURNAL_MAX_TEXT) { j->broken = 1; j->len = 0; return; }
+
+    size_t need = j->len + sizeof(JournalRecord) + inserted * sizeof(wchar_t);
+    if (need > j->cap) {
+        size_t ncap = j->cap ? j->cap : 4096;
+        while (ncap < need) ncap *= 2;
+        char *nb = (char *)realloc(j->buf, ncap);
+        if (!nb) { j->broken = 1; j->len = 0; return; }
+        j->buf = nb;
+        j->cap = ncap;
     }
+    const wchar_t *text = gb->buf + gb->gap_start - inserted;
+    JournalRecord r = { pos, removed, (unsigned int)inserted, 0 };
+    r.check = record_check(&r, text);
+    memcpy(j->buf + j->len, &r, sizeof(r));
+    memcpy(j->buf + j->len + sizeof(r), text, inserted * sizeof(wchar_t));
+    j->len = need;
 }
 
+void journal_free(EditJournal *j) {
+    free(j->buf);
+    j->buf = NULL;
+    j->len = j->cap = 0;
+}
+
+/* Queued shadow writes go first, or they would bring the file back */
 void autosave_delete_for_doc(Document *doc) {
-    wchar_t shadow_path[MAX_PATH + 32];
-    autosave_path_for_doc(doc, shadow_path);
-    DeleteFileW(shadow_path);
+    save_flush();
+    delete_shadow(doc);
+    journal_clear(&doc->journal);
+    doc->autosave_mutation_snapshot = doc->gb.mutation;
 }
 
 void autosave_cleanup_all(void) {
     autosave_ensure_dir();
     if (!g_editor.autosave_dir[0]) return;
 
-    wchar_t pattern[MAX_PATH];
-    swprintf(pattern, MAX_PATH, L"%ls\\*.pctmp", g_editor.autosave_dir);
-
-    WIN32_FIND_DATAW fd;
-    HANDLE hFind = FindFirstFileW(pattern, &fd);
-    if (hFind == INVALID_HANDLE_VALUE) return;
-    do {
-        wchar_t full[MAX_PATH];
-        swprintf(full, MAX_PATH, L"%ls\\%ls", g_editor.autosave_dir, fd.cFileName);
-        DeleteFileW(full);
-    } while (FindNextFileW(hFind, &fd));
-    FindClose(hFind);
+    static const wchar_t *const kinds[] = { L"pctmp", L"pcjnl" };
+    for (int k = 0; k < 2; k++) {
+        wchar_t pattern[MAX_PATH];
+        swprintf(pattern, MAX_PATH, L"%ls\\*.%ls", g_editor.autosave_dir, kinds[k]);
+
+        WIN32_FIND_DATAW fd;
+        HANDLE hFind = FindFirstFileW(pattern, &fd);
+        if (hFind == INVALID_HANDLE_VALUE) continue;
+        do {
+            wchar_t full[MAX_PATH];
+            swprintf(full, MAX_PATH, L"%ls\\%ls", g_editor.autosave_dir, fd.cFileName);
+            DeleteFileW(full);
+        } while (FindNextFileW(hFind, &fd));
+        FindClose(hFind);
+    }
 }
 
 void autosave_cleanup_tmp(void) {
@@ -324,6 +1251,132 @@ void autosave_cleanup_tmp(void) {
     FindClose(hFind);
 }
 
+/* ── Crash recovery ──
+ * The list of shadows to offer is built from their headers alone; a
+ * body is read, decompressed and decoded straight into the gap only
+ * once its recovery is accepted. Shadows from before compression hold
+ * plain UTF-8 after the header. */
+
+typedef struct {
+    wchar_t shadow[MAX_PATH];
+    wchar_t orig_path[MAX_PATH];
+    unsigned int gen;
+    int lz;
+    DWORD body;              /* file offset of the text */
+} RecoveryEntry;
+
+/* Reads the header of a shadow into e; 0 if it is not a valid one */
+static int recovery_read_header(RecoveryEntry *e) {
+    HANDLE hFile = CreateFileW(e->shadow, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, 0, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return 0;
+
+    char len_buf[4];
+    char hdr_buf[1024];
+    int hdr_len = 0;
+    int ok = read_all(hFile, len_buf, 4);
+    if (ok) {
+        hdr_len = (int)get_u32(len_buf);
+        ok = hdr_len > 0 && hdr_len < (int)sizeof(hdr_buf) &&
+             read_all(hFile, hdr_buf, (DWORD)hdr_len);
+    }
+    CloseHandle(hFile);
+    if (!ok) return 0;
+    hdr_buf[hdr_len] = 0;
+
+    e->body = 4 + (DWORD)hdr_len;
+    e->lz = strstr(hdr_buf, "\"codec\":\"lz\"") != NULL;
+    e->gen = 0;
+    char *gp = strstr(hdr_buf, "\"gen\":");
+    if (gp) e->gen = (unsigned int)strtoul(gp + 6, NULL, 10);
+
+    e->orig_path[0] = 0;
+    char *pp = strstr(hdr_buf, "\"path\":\"");
+    if (pp) {
+        pp += 8;
+        char *pe = strchr(pp, '"');
+        if (pe) {
+            *pe = 0;
+            MultiByteToWideChar(CP_UTF8, 0, pp, -1, e->orig_path, MAX_PATH);
+        }
+    }
+    return 1;
+}
+
+/* Decodes the body of e into doc's empty buffer; 0 if it is damaged */
+static int recovery_load_body(Document *doc, const RecoveryEntry *e) {
+    HANDLE hFile = CreateFileW(e->shadow, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, 0, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size, at;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart < (LONGLONG)e->body ||
+        size.QuadPart > (LONGLONG)(512 * 1024 * 1024)) {
+        CloseHandle(hFile);
+        return 0;
+    }
+
+    /* UTF-16 needs no more units than the UTF-8 has bytes; for blocks,
+     * their lengths are summed first by skipping from head to head */
+    bpos bound = (bpos)size.QuadPart - e->body;
+    int ok = 1;
+    if (e->lz) {
+        char head[BLOCK_HEAD];
+        bound = 0;
+        at.QuadPart = e->body;
+        while (ok && at.QuadPart < size.QuadPart) {
+            ok = SetFilePointerEx(hFile, at, NULL, FILE_BEGIN) &&
+                 read_all(hFile, head, BLOCK_HEAD);
+            unsigned int raw_len = get_u32(head), stored = get_u32(head + 4);
+            ok = ok && raw_len <= SAVE_CHUNK && stored <= raw_len;
+            bound += raw_len;
+            at.QuadPart += BLOCK_HEAD + stored;
+        }
+        ok = ok && at.QuadPart == size.QuadPart;
+    }
+    at.QuadPart = e->body;
+    ok = ok && SetFilePointerEx(hFile, at, NULL, FILE_BEGIN);
+
+    wchar_t *dst = ok ? gb_append_reserve(&doc->gb, bound + 1) : NULL;
+    char *chunk = (char *)malloc(SAVE_CHUNK);
+    char *raw = e->lz ? (char *)malloc(SAVE_CHUNK) : NULL;
+    if (!dst || !chunk || (e->lz && !raw)) {
+        free(chunk); free(raw); CloseHandle(hFile);
+        return 0;
+    }
+
+    Utf8Decoder dec;
+    utf8_decoder_init(&dec);
+    bpos left = (bpos)size.QuadPart - e->body, wlen = 0;
+    while (ok && left > 0) {
+        const char *data = chunk;
+        DWORD n;
+        if (e->lz) {
+            char head[BLOCK_HEAD];
+            ok = read_all(hFile, head, BLOCK_HEAD);
+            n = get_u32(head);
+            DWORD stored = get_u32(head + 4);
+            ok = ok && read_all(hFile, chunk, stored);
+            if (ok && stored < n) {
+                ok = lz_decompress(chunk, stored, raw, n) == (ptrdiff_t)n;
+                data = raw;
+            }
+            left -= BLOCK_HEAD + stored;
+        } else {
+            n = left < SAVE_CHUNK ? (DWORD)left : SAVE_CHUNK;
+            ok = read_all(hFile, chunk, n);
+            left -= n;
+        }
+        if (ok) wlen += utf8_decode(&dec, data, n, dst + wlen);
+    }
+    wlen += utf8_decode_end(&dec, dst + wlen);
+    utf8_decoder_free(&dec);
+    free(chunk);
+    free(raw);
+    CloseHandle(hFile);
+    if (ok) gb_append_commit(&doc->gb, wlen);
+    return ok;
+}
+
 void autosave_recover(void) {
     autosave_ensure_dir();
     if (!g_editor.autosave_dir[0]) return;
@@ -335,49 +1388,30 @@ void autosave_recover(void) {
     HANDLE hFind = FindFirstFileW(pattern, &fd);
     if (hFind == INVALID_HANDLE_VALUE) return;
 
-    int recovered = 0;
+    RecoveryEntry *entries = NULL;
+    int count = 0, cap = 0;
     do {
-        wchar_t full[MAX_PATH];
-        swprintf(full, MAX_PATH, L"%ls\\%ls", g_editor.autosave_dir, fd.cFileName);
-
-        HANDLE hFile = CreateFileW(full, GENERIC_READ, FILE_SHARE_READ, NULL,
-                                   OPEN_EXISTING, 0, NULL);
-        if (hFile == INVALID_HANDLE_VALUE) continue;
-
-        DWORD file_size = GetFileSize(hFile, NULL);
-        if (file_size < 8) { CloseHandle(hFile); DeleteFileW(full); continue; }
-
-        char *raw = (char *)malloc(file_size);
-        if (!raw) { CloseHandle(hFile); continue; }
-        DWORD bytes_read;
-        ReadFile(hFile, raw, file_size, &bytes_read, NULL);
-        CloseHandle(hFile);
-
-        if (bytes_read < 8) { free(raw); DeleteFileW(full); continue; }
-
-        int hdr_len = (unsigned char)raw[0] |
-                      ((unsigned char)raw[1] << 8) |
-                      ((unsigned char)raw[2] << 16) |
-                      ((unsigned char)raw[3] << 24);
-
-        if (hdr_len <= 0 || hdr_len >= 1024 || 4 + hdr_len > (int)bytes_read) {
-            free(raw); DeleteFileW(full); continue;
+        if (count == cap) {
+            int ncap = cap ? cap * 2 : 8;
+            RecoveryEntry *ne = (RecoveryEntry *)realloc(entries, ncap * sizeof(RecoveryEntry));
+            if (!ne) break;
+            entries = ne;
+            cap = ncap;
         }
-
-        char hdr_buf[1024];
-        memcpy(hdr_buf, raw + 4, hdr_len);
-        hdr_buf[hdr_len] = 0;
-
-        wchar_t orig_path[MAX_PATH] = {0};
-        char *pp = strstr(hdr_buf, "\"path\":\"");
-        if (pp) {
-            pp += 8;
-            char *pe = strchr(pp, '"');
-            if (pe) {
-                *pe = 0;
-                MultiByteToWideChar(CP_UTF8, 0, pp, -1, orig_path, MAX_PATH);
-            }
+        RecoveryEntry *e = &entries[count];
+        swprintf(e->shadow, MAX_PATH, L"%ls\\%ls", g_editor.autosave_dir, fd.cFileName);
+        if (recovery_read_header(e)) {
+            count++;
+        } else {
+            DeleteFileW(e->shadow);
         }
+    } while (FindNextFileW(hFind, &fd));
+    FindClose(hFind);
+
+    int recovered = 0;
+    for (int i = 0; i < count; i++) {
+        RecoveryEntry *e = &entries[i];
+        const wchar_t *orig_path = e->orig_path;
 
         wchar_t msg[512];
         const wchar_t *name = orig_path[0] ? wcsrchr(orig_path, L'\\') : NULL;
@@ -388,25 +1422,19 @@ void autosave_recover(void) {
                  L"Prose_Code found unsaved work:\n\n  \"%ls\"\n\nRecover this file?",
                  name);
 
+        Document *doc = NULL;
         if (MessageBoxW(g_editor.hwnd, msg, L"Crash Recovery",
                         MB_YESNO | MB_ICONINFORMATION) == IDYES) {
-            char *content = raw + 4 + hdr_len;
-            int content_len = (int)bytes_read - 4 - hdr_len;
-
-            int wlen = MultiByteToWideChar(CP_UTF8, 0, content, content_len, NULL, 0);
-            wchar_t *wtext = (wchar_t *)malloc((wlen + 1) * sizeof(wchar_t));
-            if (!wtext) { free(raw); DeleteFileW(full); continue; }
-            MultiByteToWideChar(CP_UTF8, 0, content, content_len, wtext, wlen);
-            wtext[wlen] = 0;
-
-            int j = 0;
-            for (int i = 0; i < wlen; i++) {
-                if (wtext[i] != L'\r') wtext[j++] = wtext[i];
+            doc = doc_create();
+            if (!recovery_load_body(doc, e)) {
+                doc_free(doc);
+                doc = NULL;
+                MessageBoxW(g_editor.hwnd, L"The unsaved work could not be read.",
+                            L"Crash Recovery", MB_OK | MB_ICONWARNING);
             }
-
-            Document *doc = doc_create();
-            gb_insert(&doc->gb, 0, wtext, j);
-            free(wtext);
+        }
+        if (doc) {
+            if (e->gen) journal_replay(doc, e->shadow, e->gen);
 
             if (orig_path[0]) {
                 safe_wcscpy(doc->filepath, MAX_PATH, orig_path);
@@ -416,9 +1444,9 @@ void autosave_recover(void) {
             } else {
                 safe_wcscpy(doc->title, 64, L"Recovered");
             }
+            watch_stamp(doc);
             doc->modified = 1;
             recalc_lines(doc);
-            update_stats(doc);
             snapshot_session_baseline(doc);
 
             if (g_editor.tab_count < MAX_TABS) {
@@ -439,10 +1467,12 @@ void autosave_recover(void) {
             }
         }
 
-        free(raw);
-        DeleteFileW(full);
-    } while (FindNextFileW(hFind, &fd));
-    FindClose(hFind);
+        wchar_t jnl[MAX_PATH + 32];
+        journal_path(e->shadow, jnl);
+        DeleteFileW(e->shadow);
+        DeleteFileW(jnl);
+    }
+    free(entries);
 
     if (recovered > 0) {
         InvalidateRect(g_editor.hwnd, NULL, FALSE);
@@ -451,6 +1481,7 @@ void autosave_recover(void) {
 
 int prompt_save_doc(int tab_idx) {
     if (tab_idx < 0 || tab_idx >= g_editor.tab_count) return 1;
+    save_flush();   /* a save in flight may already cover the changes */
     Document *doc = g_editor.tabs[tab_idx];
     if (!doc->modified) return 1;
 
@@ -467,6 +1498,24 @@ int prompt_save_doc(int tab_idx) {
     return 0;
 }
 
+/* Load `path` into a new active tab, reusing an empty untitled tab.
+ * Returns NULL when every tab slot is taken. */
+Document *open_file_in_tab(const wchar_t *path) {
+    Document *doc = current_doc();
+    if (doc && !doc->modified && doc->filepath[0] == 0 && !doc->is_results &&
+        gb_length(&doc->gb) == 0) {
+        load_file(doc, path);
+        return doc;
+    }
+    if (g_editor.tab_count >= MAX_TABS) return NULL;
+    doc = doc_create();
+    load_file(doc, path);
+    g_editor.tabs[g_editor.tab_count] = doc;
+    g_editor.active_tab = g_editor.tab_count;
+    g_editor.tab_count++;
+    return doc;
+}
+
 void open_file_dialog(void) {
     wchar_t path[MAX_PATH] = {0};
     OPENFILENAMEW ofn = {0};
@@ -478,23 +1527,7 @@ void open_file_dialog(void) {
     ofn.Flags = OFN_FILEMUSTEXIST;
 
     if (GetOpenFileNameW(&ofn)) {
-        Document *doc = current_doc();
-        int reuse = 0;
-        if (doc && !doc->modified && doc->filepath[0] == 0 && gb_length(&doc->gb) == 0) {
-            reuse = 1;
-        }
-
-        if (reuse) {
-            load_file(doc, path);
-        } else {
-            if (g_editor.tab_count < MAX_TABS) {
-                doc = doc_create();
-                load_file(doc, path);
-                g_editor.tabs[g_editor.tab_count] = doc;
-                g_editor.active_tab = g_editor.tab_count;
-                g_editor.tab_count++;
-            }
-        }
+        open_file_in_tab(path);
         InvalidateRect(g_editor.hwnd, NULL, FALSE);
     }
 }
@@ -527,6 +1560,7 @@ int save_file_dialog_for_doc(Document *doc) {
 
     if (doc->filepath[0]) {
         save_file(doc, doc->filepath);
+        save_flush();
         return doc->modified ? 0 : 1;
     }
 
@@ -541,6 +1575,7 @@ int save_file_dialog_for_doc(Document *doc) {
 
     if (!GetSaveFileNameW(&ofn)) return 0;
     save_file(doc, path);
+    save_flush();
     return doc->modified ? 0 : 1;
 }
 
@@ -573,7 +1608,26 @@ void close_tab(int idx) {
         g_editor.tabs[i] = g_editor.tabs[i + 1];
     }
     g_editor.tab_count--;
+    /* The active tab stays the same document */
+    if (idx < g_editor.active_tab) g_editor.active_tab--;
     if (g_editor.active_tab >= g_editor.tab_count)
         g_editor.active_tab = g_editor.tab_count - 1;
     if (g_editor.tab_count == 0) new_tab();
+    else activate_tab(g_editor.active_tab);
+}
+
+/* Reads tab idx's file if it is hibernated, all of it before returning
+ * when whole is set. A tab whose file can no longer be read is closed;
+ * 0 then, and the tab indices have moved. */
+int wake_tab(int idx, int whole) {
+    if (session_wake(g_editor.tabs[idx], whole)) return 1;
+    close_tab(idx);
+    return 0;
+}
+
+/* Switches to tab idx, waking it; 0 if it had to be closed */
+int activate_tab(int idx) {
+    if (idx < 0 || idx >= g_editor.tab_count) return 0;
+    g_editor.active_tab = idx;
+    return wake_tab(idx, 0);
 }
@@ -0,0 +1,425 @@
+#include "prose_code.h"
+
+/* ── Find in files ──
+ * A directory task lists one directory and queues a task for each
+ * subdirectory and each file. The pool's work stealing spreads a deep
+ * tree across every worker. A file task maps the file, skips it if it
+ * looks binary or exceeds FIF_MAX_FILE, decodes it the way load_file
+ * does, and searches it with the find bar's query.
+ *
+ * Workers append formatted blocks to one shared output buffer and post
+ * WM_FIND_RESULTS only when none is outstanding, so a tree with tens
+ * of thousands of hits cannot flood the message queue. The UI appends
+ * whatever has accumulated to the results tab. Each file appears as
+ * its path followed by indented "line:col: text" rows; Enter or a
+ * double-click on a row opens that location. */
+
+typedef struct {
+    volatile LONG pending;      /* queued or running tasks */
+    LONG gen;
+    int regex;
+    wchar_t query[256];         /* folded in literal mode */
+    int qlen;
+    Regex *rx[POOL_MAX_THREADS + 1];
+    volatile LONG files_searched;
+    volatile LONG files_matched;
+    volatile LONG matches;
+    DWORD start_tick;
+} FifJob;
+
+typedef struct {
+    FifJob *job;
+    wchar_t path[MAX_PATH];
+} FifTask;
+
+typedef struct {
+    wchar_t *buf;
+    int len;
+    int cap;
+} FifStr;
+
+typedef struct {
+    bpos pos[FIF_MAX_PER_FILE];
+    int count;
+} FifHits;
+
+static volatile LONG g_fif_gen;
+static CRITICAL_SECTION g_fif_lock;
+static int g_fif_lock_ready;
+static FifStr g_fif_out;        /* guarded by g_fif_lock */
+static int g_fif_posted;        /* guarded by g_fif_lock */
+static unsigned int g_fif_results_id;
+
+static void fif_dir_task(void *param);
+static void fif_file_task(void *param);
+
+static int str_append(FifStr *s, const wchar_t *text, int len) {
+    if (s->len + len + 1 > s->cap) {
+        int ncap = s->cap ? s->cap * 2 : 4096;
+        while (ncap < s->len + len + 1) ncap *= 2;
+        wchar_t *p = (wchar_t *)realloc(s->buf, ncap * sizeof(wchar_t));
+        if (!p) return 0;
+        s->buf = p;
+        s->cap = ncap;
+    }
+    wmemcpy(s->buf + s->len, text, len);
+    s->len += len;
+    s->buf[s->len] = 0;
+    return 1;
+}
+
+/* Hand a finished block to the UI thread, dropping it if a newer search
+ * has started. */
+static void fif_emit(FifJob *job, const wchar_t *text, int len) {
+    EnterCriticalSection(&g_fif_lock);
+    if (job->gen == g_fif_gen && str_append(&g_fif_out, text, len) && !g_fif_posted)
+        g_fif_posted = PostMessageW(g_editor.hwnd, WM_FIND_RESULTS, 0, 0) != 0;
+    LeaveCriticalSection(&g_fif_lock);
+}
+
+static void fif_job_free(FifJob *job) {
+    for (int i = 0; i <= POOL_MAX_THREADS; i++) rx_free(job->rx[i]);
+    free(job);
+}
+
+/* Called by every task when it finishes; the last one reports. */
+static void fif_task_done(FifJob *job) {
+    if (InterlockedDecrement(&job->pending) != 0) return;
+    if (job->gen == g_fif_gen) {
+        wchar_t summary[160];
+        int n = swprintf(summary, 160, L"\n%ld matches in %ld files (%ld files searched, %.1fs)\n",
+                         job->matches, job->files_matched, job->files_searched,
+                         (GetTickCount() - job->start_tick) / 1000.0);
+        if (n > 0) fif_emit(job, summary, n);
+    }
+    fif_job_free(job);
+}
+
+static void fif_queue(FifJob *job, PoolTaskFn fn, const wchar_t *dir, const wchar_t *name) {
+    FifTask *t = (FifTask *)malloc(sizeof(FifTask));
+    if (!t) return;
+    int n = swprintf(t->path, MAX_PATH, L"%ls\\%ls", dir, name);
+    if (n < 0 || n >= MAX_PATH) { free(t); return; }
+    t->job = job;
+    InterlockedIncrement(&job->pending);
+    pool_submit(fn, t);
+}
+
+static void fif_dir_task(void *param) {
+    FifTask *t = (FifTask *)param;
+    FifJob *job = t->job;
+    wchar_t pattern[MAX_PATH];
+    int n = swprintf(pattern, MAX_PATH, L"%ls\\*", t->path);
+
+    if (job->gen == g_fif_gen && n > 0 && n < MAX_PATH) {
+        WIN32_FIND_DATAW fd;
+        HANDLE h = FindFirstFileExW(pattern, FindExInfoBasic, &fd, FindExSearchNameMatch,
+                                    NULL, FIND_FIRST_EX_LARGE_FETCH);
+        if (h != INVALID_HANDLE_VALUE) {
+            do {
+                /* Skips ".", "..", and dot directories such as .git */
+                if (fd.cFileName[0] == L'.') continue;
+                if (fd.dwFileAttributes & (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM |
+                                           FILE_ATTRIBUTE_REPARSE_POINT)) continue;
+                if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                    fif_queue(job, fif_dir_task, t->path, fd.cFileName);
+                } else {
+                    ULONGLONG size = ((ULONGLONG)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+                    if (size > 0 && size <= FIF_MAX_FILE)
+                        fif_queue(job, fif_file_task, t->path, fd.cFileName);
+                }
+            } while (job->gen == g_fif_gen && FindNextFileW(h, &fd));
+            FindClose(h);
+        }
+    }
+    free(t);
+    fif_task_done(job);
+}
+
+/* Decode a mapped file the way load_file does (UTF-8, BOM skipped, CR
+ * dropped). Returns NULL for files that look binary. */
+static wchar_t *fif_decode(const unsigned char *data, int size, int *out_len) {
+    int sniff = size < FIF_SNIFF_BYTES ? size : FIF_SNIFF_BYTES;
+    if (memchr(data, 0, sniff)) return NULL;
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        data += 3;
+        size -= 3;
+    }
+    int wlen = MultiByteToWideChar(CP_UTF8, 0, (const char *)data, size, NULL, 0);
+    wchar_t *w = (wchar_t *)malloc((wlen + 1) * sizeof(wchar_t));
+    if (!w) return NULL;
+    MultiByteToWideChar(CP_UTF8, 0, (const char *)data, size, w, wlen);
+    int j = 0;
+    for (int i = 0; i < wlen; i++)
+        if (w[i] != L'\r') w[j++] = w[i];
+    w[j] = 0;
+    *out_len = j;
+    return w;
+}
+
+static int fif_collect(void *ctx, ptrdiff_t start, ptrdiff_t end) {
+    FifHits *hits = (FifHits *)ctx;
+    hits->pos[hits->count++] = start;
+    return hits->count < FIF_MAX_PER_FILE;
+}
+
+/* Format "path" then one "  line:col: text" row per matching line. */
+static void fif_format(FifStr *out, const wchar_t *path, const wchar_t *text, int len,
+                       const FifHits *hits) {
+    str_append(out, path, (int)wcslen(path));
+    str_append(out, L"\n", 1);
+    bpos line = 1, line_start = 0, scanned = 0, last_line = 0;
+    for (int i = 0; i < hits->count; i++) {
+        bpos p = hits->pos[i];
+        for (; scanned < p; scanned++)
+            if (text[scanned] == L'\n') { line++; line_start = scanned + 1; }
+        if (line == last_line) continue;
+        last_line = line;
+
+        bpos le = p;
+        while (le < len && text[le] != L'\n') le++;
+        bpos ts = line_start;
+        while (ts < le && (text[ts] == L' ' || text[ts] == L'\t')) ts++;
+        int tl = (int)(le - ts < FIF_LINE_TEXT ? le - ts : FIF_LINE_TEXT);
+
+        wchar_t row[FIF_LINE_TEXT + 48];
+        int n = swprintf(row, FIF_LINE_TEXT + 48, L"  %lld:%lld: ",
+                         (long long)line, (long long)(p - line_start + 1));
+        if (n < 0) continue;
+        for (int k = 0; k < tl; k++) {
+            wchar_t c = text[ts + k];
+            row[n++] = c == L'\t' ? L' ' : c;
+        }
+        row[n++] = L'\n';
+        str_append(out, row, n);
+    }
+    str_append(out, L"\n", 1);
+}
+
+static void fif_search_file(FifJob *job, const wchar_t *path) {
+    HANDLE f = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (f == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(f, &size) || size.QuadPart <= 0 || size.QuadPart > FIF_MAX_FILE) {
+        CloseHandle(f);
+        return;
+    }
+    HANDLE map = CreateFileMappingW(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(f);
+    if (!map) return;
+    const unsigned char *data = (const unsigned char *)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(map);
+    if (!data) return;
+
+    int len = 0;
+    wchar_t *text = fif_decode(data, (int)size.QuadPart, &len);
+    UnmapViewOfFile(data);
+    if (!text) return;
+    InterlockedIncrement(&job->files_searched);
+
+    /* Each worker keeps its own compiled pattern; the DFA cache is not shared */
+    Regex *rx = NULL;
+    if (job->regex) {
+        int slot = pool_worker_index() + 1;
+        if (!job->rx[slot]) job->rx[slot] = rx_compile(job->query, NULL);
+        rx = job->rx[slot];
+        if (!rx) { free(text); return; }
+    }
+
+    FifHits *hits = (FifHits *)malloc(sizeof(FifHits));
+    if (hits) {
+        hits->count = 0;
+        if (rx) rx_scan(rx, text, len, 0, len, fif_collect, hits);
+        else search_literal(text, len, job->query, job->qlen, 0, len, fif_collect, hits);
+        if (hits->count > 0) {
+            InterlockedIncrement(&job->files_matched);
+            InterlockedExchangeAdd(&job->matches, hits->count);
+            FifStr block = { 0 };
+            fif_format(&block, path, text, len, hits);
+            if (block.buf) fif_emit(job, block.buf, block.len);
+            free(block.buf);
+        }
+        free(hits);
+    }
+    free(text);
+}
+
+static void fif_file_task(void *param) {
+    FifTask *t = (FifTask *)param;
+    FifJob *job = t->job;
+    if (job->gen == g_fif_gen) fif_search_file(job, t->path);
+    free(t);
+    fif_task_done(job);
+}
+
+/* ── Results tab ── */
+
+static Document *fif_results_doc(void) {
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        Document *doc = g_editor.tabs[i];
+        if (doc->is_results && doc->autosave_id == g_fif_results_id) return doc;
+    }
+    return NULL;
+}
+
+static void fif_append(Document *doc, const wchar_t *text, int len) {
+    bpos end = gb_length(&doc->gb);
+    gb_insert(&doc->gb, end, text, len);
+    if (!lc_notify_insert(&doc->lc, end, text, len)) recalc_lines(doc);
+}
+
+void find_in_files_on_results(void) {
+    EnterCriticalSection(&g_fif_lock);
+    FifStr chunk = g_fif_out;
+    memset(&g_fif_out, 0, sizeof(g_fif_out));
+    g_fif_posted = 0;
+    LeaveCriticalSection(&g_fif_lock);
+
+    Document *doc = fif_results_doc();
+    if (doc && chunk.len > 0) fif_append(doc, chunk.buf, chunk.len);
+    free(chunk.buf);
+}
+
+void find_in_files_cancel(void) {
+    InterlockedIncrement(&g_fif_gen);
+}
+
+void find_in_files_start(const wchar_t *dir) {
+    SearchState *ss = &g_editor.search;
+    if (ss->query[0] == 0) return;
+    if (!g_fif_lock_ready) {
+        InitializeCriticalSection(&g_fif_lock);
+        g_fif_lock_ready = 1;
+    }
+
+    if (ss->regex) {
+        Regex *rx = rx_compile(ss->query, NULL);
+        if (!rx) { ss->query_invalid = 1; return; }
+        rx_free(rx);
+    }
+
+    /* Reuse the results tab from an earlier search if it is still open */
+    Document *doc = fif_results_doc();
+    if (doc) {
+        gb_free(&doc->gb);
+        gb_init(&doc->gb, GAP_INIT);
+        undo_clear(&doc->undo);
+        doc->cursor = 0;
+        doc->sel_anchor = -1;
+        doc->scroll_y = doc->target_scroll_y = 0;
+        recalc_lines(doc);
+        for (int i = 0; i < g_editor.tab_count; i++)
+            if (g_editor.tabs[i] == doc) activate_tab(i);
+    } else {
+        if (g_editor.tab_count >= MAX_TABS) return;
+        doc = doc_create();
+        doc->is_results = 1;
+        doc->mode = MODE_CODE;
+        g_editor.tabs[g_editor.tab_count] = doc;
+        g_editor.active_tab = g_editor.tab_count;
+        g_editor.tab_count++;
+    }
+    swprintf(doc->title, 64, L"Find: %.48ls", ss->query);
+
+    FifJob *job = (FifJob *)calloc(1, sizeof(FifJob));
+    if (!job) return;
+
+    EnterCriticalSection(&g_fif_lock);
+    job->gen = InterlockedIncrement(&g_fif_gen);
+    g_fif_out.len = 0;
+    g_fif_results_id = doc->autosave_id;
+    LeaveCriticalSection(&g_fif_lock);
+
+    job->regex = ss->regex;
+    job->qlen = (int)wcslen(ss->query);
+    if (ss->regex) safe_wcscpy(job->query, 256, ss->query);
+    else ch_fold_run(ss->query, job->query, job->qlen);
+    job->start_tick = GetTickCount();
+
+    wchar_t header[MAX_PATH + 320];
+    int n = swprintf(header, MAX_PATH + 320, L"Searching for %ls\"%ls\" in %ls\n\n",
+                     ss->regex ? L"regex " : L"", ss->query, dir);
+    if (n > 0) fif_append(doc, header, n);
+
+    /* The root directory holds the job open until the walk is queued */
+    job->pending = 1;
+    FifTask *root = (FifTask *)malloc(sizeof(FifTask));
+    if (!root) { fif_job_free(job); return; }
+    root->job = job;
+    safe_wcscpy(root->path, MAX_PATH, dir);
+    pool_submit(fif_dir_task, root);
+}
+
+/* Ctrl+Shift+F: search the find bar's query below a chosen folder,
+ * starting from the current file's directory. */
+void find_in_files_prompt(void) {
+    SearchState *ss = &g_editor.search;
+    if (ss->query[0] == 0) {
+        ss->active = 1;
+        return;
+    }
+
+    BROWSEINFOW bi = { 0 };
+    wchar_t dir[MAX_PATH] = { 0 };
+    bi.hwndOwner = g_editor.hwnd;
+    bi.pszDisplayName = dir;
+    bi.lpszTitle = L"Find in files: choose a folder";
+    bi.ulFlags = BIF_RETURNONLYFSDIRS | BIF_NEWDIALOGSTYLE;
+    PIDLIST_ABSOLUTE pidl = SHBrowseForFolderW(&bi);
+    if (!pidl) return;
+    int ok = SHGetPathFromIDListW(pidl, dir);
+    CoTaskMemFree(pidl);
+    if (!ok || !dir[0]) return;
+
+    /* "C:\" comes back with its separator; the walk adds its own */
+    int dl = (int)wcslen(dir);
+    if (dl > 0 && dir[dl - 1] == L'\\') dir[dl - 1] = 0;
+    find_in_files_start(dir);
+}
+
+/* Open the match on the results-tab line containing `pos`. Returns 0 if
+ * that line is not a match row or file heading. */
+int find_in_files_open_at(Document *doc, bpos pos) {
+    if (!doc || !doc->is_results) return 0;
+    GapBuffer *gb = &doc->gb;
+    bpos line = lc_line_of(&doc->lc, pos);
+    bpos ls = lc_line_start(&doc->lc, line);
+    bpos le = lc_line_end(&doc->lc, gb, line);
+
+    long long ln = 1, col = 1;
+    bpos head = line;
+    if (gb_char_at(gb, ls) == L' ') {
+        wchar_t row[48];
+        bpos n = le - ls < 47 ? le - ls : 47;
+        gb_copy_range(gb, ls, n, row);
+        row[n] = 0;
+        if (swscanf(row, L" %lld:%lld:", &ln, &col) != 2) return 0;
+        /* The file heading is the nearest unindented line above */
+        while (head > 0 && gb_char_at(gb, lc_line_start(&doc->lc, head)) == L' ') head--;
+    }
+    bpos hs = lc_line_start(&doc->lc, head);
+    bpos he = lc_line_end(&doc->lc, gb, head);
+    if (he - hs <= 0 || he - hs >= MAX_PATH) return 0;
+    wchar_t path[MAX_PATH];
+    gb_copy_range(gb, hs, he - hs, path);
+    path[he - hs] = 0;
+    if (GetFileAttributesW(path) == INVALID_FILE_ATTRIBUTES) return 0;
+
+    Document *target = NULL;
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        if (_wcsicmp(g_editor.tabs[i]->filepath, path) == 0) {
+            if (!activate_tab(i)) return 1;
+            target = g_editor.tabs[i];
+            break;
+        }
+    }
+    if (!target) target = open_file_in_tab(path);
+    if (!target) return 1;
+
+    target->cursor = line_col_to_pos(target, (bpos)(ln - 1), (bpos)(col - 1));
+    target->sel_anchor = -1;
+    target->desired_col = -1;
+    editor_ensure_cursor_visible();
+    return 1;
+}
@@ -0,0 +1,134 @@
+/*
+ * lz.c — Fast LZ77 block compression
+ *
+ * Positions without a match are skipped faster the longer the current
+ * literal run gets, so incompressible input costs little more than a
+ * copy. The last LZ_TAIL bytes are always literals, which keeps the
+ * 4-byte prefix reads in bounds.
+ */
+#include "lz.h"
+#include <string.h>
+
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 0xFFFF
+#define LZ_TAIL 12
+
+static unsigned read32(const unsigned char *p) {
+    unsigned v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static unsigned hash4(unsigned v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes a length continuation; returns 0 if it does not fit */
+static int put_len(unsigned char **o, const unsigned char *end, size_t len) {
+    for (; len >= 255; len -= 255) {
+        if (*o >= end) return 0;
+        *(*o)++ = 255;
+    }
+    if (*o >= end) return 0;
+    *(*o)++ = (unsigned char)len;
+    return 1;
+}
+
+static int put_sequence(unsigned char **o, const unsigned char *end,
+                        const unsigned char *lit, size_t lit_len,
+                        size_t offset, size_t match_len) {
+    if (*o >= end) return 0;
+    unsigned char *token = (*o)++;
+    *token = (unsigned char)((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (lit_len >= 15 && !put_len(o, end, lit_len - 15)) return 0;
+    if ((size_t)(end - *o) < lit_len) return 0;
+    memcpy(*o, lit, lit_len);
+    *o += lit_len;
+    if (!match_len) return 1;
+
+    if (end - *o < 2) return 0;
+    *(*o)++ = (unsigned char)(offset & 0xFF);
+    *(*o)++ = (unsigned char)(offset >> 8);
+    size_t m = match_len - LZ_MIN_MATCH;
+    *token |= (unsigned char)(m >= 15 ? 15 : m);
+    return m < 15 || put_len(o, end, m - 15);
+}
+
+size_t lz_compress(const void *src, size_t n, void *dst, size_t cap) {
+    const unsigned char *s = (const unsigned char *)src;
+    unsigned char *o = (unsigned char *)dst;
+    const unsigned char *end = o + cap;
+    unsigned table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    size_t anchor = 0, i = 1;
+    if (n > LZ_TAIL) {
+        size_t limit = n - LZ_TAIL;
+        while (i < limit) {
+            unsigned seq = read32(s + i);
+            unsigned h = hash4(seq);
+            size_t cand = table[h];
+            table[h] = (unsigned)i;
+            if (i - cand > LZ_MAX_OFFSET || read32(s + cand) != seq) {
+                i += 1 + ((i - anchor) >> 6);
+                continue;
+            }
+            size_t m = LZ_MIN_MATCH;
+            while (i + m < limit && s[cand + m] == s[i + m]) m++;
+            if (!put_sequence(&o, end, s + anchor, i - anchor, i - cand, m)) return 0;
+            i += m;
+            anchor = i;
+            if (i < limit) table[hash4(read32(s + i - 2))] = (unsigned)(i - 2);
+        }
+    }
+    if (!put_sequence(&o, end, s + anchor, n - anchor, 0, 0)) return 0;
+    return (size_t)(o - (unsigned char *)dst);
+}
+
+/* Reads a length continuation; returns 0 if the input ends first */
+static int get_len(const unsigned char **p, const unsigned char *end, size_t *len) {
+    unsigned char b;
+    do {
+        if (*p >= end) return 0;
+        b = *(*p)++;
+        *len += b;
+    } while (b == 255);
+    return 1;
+}
+
+ptrdiff_t lz_decompress(const void *src, size_t n, void *dst, size_t cap) {
+    const unsigned char *p = (const unsigned char *)src;
+    const unsigned char *pend = p + n;
+    unsigned char *o = (unsigned char *)dst;
+    unsigned char *oend = o + cap;
+    while (p < pend) {
+        unsigned token = *p++;
+        size_t lit = token >> 4;
+        if (lit == 15 && !get_len(&p, pend, &lit)) return -1;
+        if ((size_t)(pend - p) < lit || (size_t)(oend - o) < lit) return -1;
+        memcpy(o, p, lit);
+        o += lit;
+        p += lit;
+        if (p == pend) break;
+
+        if (pend - p < 2) return -1;
+        size_t offset = p[0] | (size_t)p[1] << 8;
+        p += 2;
+        size_t m = token & 15;
+        if (m == 15 && !get_len(&p, pend, &m)) return -1;
+        m += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(o - (unsigned char *)dst) ||
+            (size_t)(oend - o) < m)
+            return -1;
+        const unsigned char *from = o - offset;
+        if (offset >= m) {
+            memcpy(o, from, m);
+        } else {
+            /* Overlapping copies repeat the last offset bytes */
+            for (size_t k = 0; k < m; k++) o[k] = from[k];
+        }
+        o += m;
+    }
+    return o - (unsigned char *)dst;
+}
@@ -0,0 +1,25 @@
+/*
+ * lz.h — Fast LZ77 block compression
+ * Portable C with no Win32 dependencies.
+ *
+ * The block format is LZ4's: each sequence is a token (literal count in
+ * the high nibble, match length less 4 in the low), extra length bytes
+ * for either nibble at 15, the literals, then a 2-byte little-endian
+ * match offset. The last sequence is literals only. Matches are found
+ * through a single-probe hash of 4-byte prefixes, which favours speed
+ * over ratio; text still shrinks to roughly half.
+ */
+#ifndef PROSE_LZ_H
+#define PROSE_LZ_H
+
+#include <stddef.h>
+
+/* Compresses src[0..n) into dst[0..cap). Returns the compressed size,
+ * or 0 if it would not fit. */
+size_t lz_compress(const void *src, size_t n, void *dst, size_t cap);
+
+/* Decompresses src[0..n) into dst[0..cap). Returns the decompressed
+ * size, or -1 if the input is malformed or does not fit. */
+ptrdiff_t lz_decompress(const void *src, size_t n, void *dst, size_t cap);
+
+#endif /* PROSE_LZ_H */
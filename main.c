@@ -95,6 +95,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, LPWSTR lpCmdLine, int
 
     /* Initialize spell checker */
     spell_init();
+    spell_scan_init();
 
     /* Enable visual styles */
     INITCOMMONCONTROLSEX icc = { sizeof(icc), ICC_WIN95_CLASSES };
@@ -159,18 +160,15 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, LPWSTR lpCmdLine, int
     /* Check for crash recovery (autosave shadows from previous session) */
     autosave_recover();
 
-    /* Handle command line: open file if specified */
+    /* Bring back the last session's tabs, reading only the active one */
+    session_restore();
+
+    /* Handle command line: open every file named, read in parallel */
     if (lpCmdLine && lpCmdLine[0]) {
-        /* Strip quotes */
-        wchar_t path[MAX_PATH];
-        safe_wcscpy(path, MAX_PATH, lpCmdLine);
-        if (path[0] == L'"') {
-            memmove(path, path + 1, wcslen(path) * sizeof(wchar_t));
-            wchar_t *q = wcschr(path, L'"');
-            if (q) *q = 0;
-        }
-        Document *doc = g_editor.tabs[0];
-        load_file(doc, path);
+        int argc = 0;
+        wchar_t **argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        if (argv && argc > 1) open_files((const wchar_t *const *)argv + 1, argc - 1);
+        if (argv) LocalFree(argv);
     }
 
     /* Message loop */
@@ -181,6 +179,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, LPWSTR lpCmdLine, int
     }
 
     /* Cleanup — autosave shadows already removed in WM_CLOSE */
+    watch_shutdown();
+    save_shutdown();
     for (int i = 0; i < g_editor.tab_count; i++) doc_free(g_editor.tabs[i]);
     if (g_editor.hdc_back) {
         /* Restore original bitmap before deleting ours (mirrors WM_SIZE cleanup) */
@@ -195,11 +195,21 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, LPWSTR lpCmdLine, int
     DeleteObject(g_editor.font_ui_small);
     DeleteObject(g_editor.font_title);
     DeleteObject(g_editor.font_stats_hero);
+    search_cancel();
+    find_in_files_cancel();
+    tri_cancel();
+    spell_scan_cancel();
+    pool_shutdown();
+    load_shutdown();
+    spell_scan_free();
     free(g_editor.search.match_positions);
+    free(g_editor.search.match_lengths);
     free(g_frame_arena.base);
 
     if (g_spell_checker) g_spell_checker->lpVtbl->Release(g_spell_checker);
+    spell_cache_save();
     spell_cache_free();
+    spell_dict_free();
     DestroyIcon(icon);
     if (SUCCEEDED(co_hr)) CoUninitialize();
     return (int)msg.wParam;
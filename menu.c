@@ -23,14 +23,20 @@ static const MenuItem g_search_items[] = {
     { L"Find",               L"Ctrl+F",        MENU_ID_FIND },
     { L"Replace",            L"Ctrl+H",        MENU_ID_REPLACE },
     { L"Find Next",          L"Ctrl+G",        MENU_ID_FIND_NEXT },
+    { L"Regex Mode",         L"Ctrl+R",        MENU_ID_REGEX },
+    { L"Search All Tabs",    L"Ctrl+Shift+A",  MENU_ID_ALL_TABS },
+    { L"Find in Files",      L"Ctrl+Shift+F",  MENU_ID_FIND_FILES },
 };
 
 static const MenuItem g_view_items[] = {
     { L"Toggle Prose/Code",  L"Ctrl+M",        MENU_ID_TOGGLE_MODE },
     { L"Toggle Minimap",     L"Ctrl+Shift+M",  MENU_ID_MINIMAP },
     { L"Toggle Spellcheck",  L"F7",            MENU_ID_SPELLCHECK },
+    { L"Next Misspelling",   L"F8",            MENU_ID_NEXT_SPELL },
+    { L"Suggest Spelling",   L"Ctrl+.",        MENU_ID_SUGGEST },
     { L"Focus Mode",         L"Ctrl+D",        MENU_ID_FOCUS },
     { L"Session Stats",      L"Ctrl+I",        MENU_ID_STATS },
+    { L"Follow File",        L"Ctrl+Shift+L",  MENU_ID_FOLLOW },
     { NULL, NULL, MENU_ID_SEP },
     { L"Toggle Theme",       L"Ctrl+T",        MENU_ID_THEME },
     { L"Zoom In",            L"Ctrl++",        MENU_ID_ZOOM_IN },
@@ -46,6 +52,12 @@ const MenuDef g_menus[MENU_COUNT] = {
 
 void menu_execute(int id) {
     HWND hwnd = g_editor.hwnd;
+    Document *doc = current_doc();
+    /* A tab still loading takes no edits (as in WM_KEYDOWN) */
+    if (doc && doc->loading && (id == MENU_ID_UNDO || id == MENU_ID_REDO || id == MENU_ID_CUT ||
+                                id == MENU_ID_PASTE || id == MENU_ID_REPLACE ||
+                                id == MENU_ID_SUGGEST || id == MENU_ID_TOGGLE_MODE))
+        return;
     switch (id) {
     case MENU_ID_NEW:        new_tab(); break;
     case MENU_ID_OPEN:       open_file_dialog(); break;
@@ -60,11 +72,17 @@ void menu_execute(int id) {
     case MENU_ID_FIND:       toggle_search(); break;
     case MENU_ID_REPLACE:    g_editor.search.active = 1; g_editor.search.replace_active = 1; break;
     case MENU_ID_FIND_NEXT:  search_next(); break;
+    case MENU_ID_REGEX:      search_toggle_regex(); break;
+    case MENU_ID_ALL_TABS:   search_toggle_all_tabs(); break;
+    case MENU_ID_FIND_FILES: find_in_files_prompt(); break;
     case MENU_ID_TOGGLE_MODE: toggle_mode(); break;
     case MENU_ID_MINIMAP:    g_editor.show_minimap = !g_editor.show_minimap; break;
-    case MENU_ID_SPELLCHECK: g_editor.spellcheck_enabled = !g_editor.spellcheck_enabled; break;
+    case MENU_ID_SPELLCHECK: spell_toggle(); break;
+    case MENU_ID_NEXT_SPELL: spell_goto_next(1); break;
+    case MENU_ID_SUGGEST:    if (current_doc()) spell_suggest_at(current_doc()->cursor); break;
     case MENU_ID_FOCUS:      toggle_focus_mode(); break;
     case MENU_ID_STATS:      g_editor.show_stats_screen = !g_editor.show_stats_screen; break;
+    case MENU_ID_FOLLOW:     follow_toggle(current_doc()); break;
     case MENU_ID_THEME:      apply_theme(g_theme_index == 0 ? 1 : 0); break;
     case MENU_ID_ZOOM_IN:
         g_editor.font_size += 2;
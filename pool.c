@@ -0,0 +1,202 @@
+#include "prose_code.h"
+
+/* ── Thread pool ──
+ * Work-stealing: every worker owns a deque. Tasks submitted from a
+ * worker go to the bottom of its own deque and it pops its newest work
+ * first, so a task that fans out (a directory walk) stays depth-first
+ * and cache-warm. Idle workers steal the oldest task from the top of
+ * another deque, which tends to be the largest remaining piece. Tasks
+ * submitted from other threads go through a shared injection queue.
+ *
+ * One semaphore counts queued tasks across all deques. Tasks run off
+ * the UI thread and must report back through PostMessageW. If no
+ * worker could be started, tasks run inline. */
+
+typedef struct PoolTask {
+    PoolTaskFn fn;
+    void *arg;
+    PoolGroup *grp;
+} PoolTask;
+
+typedef struct {
+    CRITICAL_SECTION lock;
+    PoolTask **items;   /* ring buffer */
+    int head, count, cap;
+} PoolDeque;
+
+static PoolDeque g_pool_deques[POOL_MAX_THREADS + 1];  /* last is the injection queue */
+static HANDLE g_pool_sem;
+static HANDLE g_pool_threads[POOL_MAX_THREADS];
+static DWORD g_pool_tls = TLS_OUT_OF_INDEXES;
+static int g_pool_nthreads;
+static int g_pool_started;
+static volatile LONG g_pool_quit;
+
+#define POOL_INJECT (&g_pool_deques[POOL_MAX_THREADS])
+
+static int deque_push(PoolDeque *dq, PoolTask *t) {
+    EnterCriticalSection(&dq->lock);
+    if (dq->count == dq->cap) {
+        int ncap = dq->cap ? dq->cap * 2 : 64;
+        PoolTask **items = (PoolTask **)malloc(ncap * sizeof(PoolTask *));
+        if (!items) { LeaveCriticalSection(&dq->lock); return 0; }
+        for (int i = 0; i < dq->count; i++) items[i] = dq->items[(dq->head + i) % dq->cap];
+        free(dq->items);
+        dq->items = items;
+        dq->head = 0;
+        dq->cap = ncap;
+    }
+    dq->items[(dq->head + dq->count) % dq->cap] = t;
+    dq->count++;
+    LeaveCriticalSection(&dq->lock);
+    return 1;
+}
+
+/* Owner end: newest task */
+static PoolTask *deque_pop(PoolDeque *dq) {
+    PoolTask *t = NULL;
+    EnterCriticalSection(&dq->lock);
+    if (dq->count > 0) {
+        dq->count--;
+        t = dq->items[(dq->head + dq->count) % dq->cap];
+    }
+    LeaveCriticalSection(&dq->lock);
+    return t;
+}
+
+/* Thief end: oldest task */
+static PoolTask *deque_steal(PoolDeque *dq) {
+    PoolTask *t = NULL;
+    EnterCriticalSection(&dq->lock);
+    if (dq->count > 0) {
+        t = dq->items[dq->head];
+        dq->head = (dq->head + 1) % dq->cap;
+        dq->count--;
+    }
+    LeaveCriticalSection(&dq->lock);
+    return t;
+}
+
+static void pool_run(PoolTask *t) {
+    t->fn(t->arg);
+    if (t->grp && InterlockedDecrement(&t->grp->pending) == 0 && t->grp->done)
+        SetEvent(t->grp->done);
+    free(t);
+}
+
+static PoolTask *pool_find_task(int self) {
+    PoolTask *t = deque_pop(&g_pool_deques[self]);
+    if (!t) t = deque_steal(POOL_INJECT);
+    for (int k = 1; !t && k < g_pool_nthreads; k++)
+        t = deque_steal(&g_pool_deques[(self + k) % g_pool_nthreads]);
+    return t;
+}
+
+static DWORD WINAPI pool_thread(LPVOID param) {
+    int self = (int)(INT_PTR)param;
+    TlsSetValue(g_pool_tls, (LPVOID)(INT_PTR)(self + 1));
+    for (;;) {
+        WaitForSingleObject(g_pool_sem, INFINITE);
+        /* The count guarantees a task exists somewhere, but another
+         * worker may take it while we scan; keep looking. */
+        PoolTask *t;
+        while (!(t = pool_find_task(self))) {
+            if (g_pool_quit) return 0;
+            SwitchToThread();
+        }
+        pool_run(t);
+    }
+}
+
+static void pool_start(void) {
+    g_pool_started = 1;
+    for (int i = 0; i <= POOL_MAX_THREADS; i++) InitializeCriticalSection(&g_pool_deques[i].lock);
+    g_pool_tls = TlsAlloc();
+    g_pool_sem = CreateSemaphoreW(NULL, 0, 0x7fffffff, NULL);
+    if (!g_pool_sem || g_pool_tls == TLS_OUT_OF_INDEXES) return;
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int n = (int)si.dwNumberOfProcessors;
+    if (n < 2) n = 2;
+    if (n > POOL_MAX_THREADS) n = POOL_MAX_THREADS;
+    /* Workers index g_pool_nthreads while stealing, so fix it first */
+    g_pool_nthreads = n;
+    for (int i = 0; i < n; i++) {
+        g_pool_threads[i] = CreateThread(NULL, 0, pool_thread, (LPVOID)(INT_PTR)i, 0, NULL);
+        if (!g_pool_threads[i]) { g_pool_nthreads = i; break; }
+    }
+}
+
+/* Index of the calling pool worker, or -1 on any other thread. */
+int pool_worker_index(void) {
+    if (g_pool_tls == TLS_OUT_OF_INDEXES) return -1;
+    return (int)(INT_PTR)TlsGetValue(g_pool_tls) - 1;
+}
+
+static void pool_enqueue(PoolTaskFn fn, void *arg, PoolGroup *grp) {
+    if (!g_pool_started) pool_start();
+
+    PoolTask *t = (PoolTask *)malloc(sizeof(PoolTask));
+    if (!t) {
+        fn(arg);
+        if (grp && InterlockedDecrement(&grp->pending) == 0 && grp->done) SetEvent(grp->done);
+        return;
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->grp = grp;
+    if (g_pool_nthreads == 0) { pool_run(t); return; }
+
+    int self = pool_worker_index();
+    if (!deque_push(self >= 0 ? &g_pool_deques[self] : POOL_INJECT, t)) { pool_run(t); return; }
+    ReleaseSemaphore(g_pool_sem, 1, NULL);
+}
+
+void pool_submit(PoolTaskFn fn, void *arg) {
+    pool_enqueue(fn, arg, NULL);
+}
+
+/* ── Task groups ──
+ * The submitter holds one reference on `pending` until pool_group_wait,
+ * so the event cannot fire while tasks are still being added. */
+
+void pool_group_init(PoolGroup *grp) {
+    grp->pending = 1;
+    grp->done = CreateEventW(NULL, TRUE, FALSE, NULL);
+}
+
+void pool_group_submit(PoolGroup *grp, PoolTaskFn fn, void *arg) {
+    InterlockedIncrement(&grp->pending);
+    pool_enqueue(fn, arg, grp);
+}
+
+void pool_group_wait(PoolGroup *grp) {
+    if (InterlockedDecrement(&grp->pending) != 0) {
+        if (grp->done) WaitForSingleObject(grp->done, INFINITE);
+        else while (grp->pending != 0) Sleep(1);
+    }
+    if (grp->done) CloseHandle(grp->done);
+}
+
+/* Let queued tasks drain, then stop every worker. */
+void pool_shutdown(void) {
+    if (!g_pool_started) return;
+    if (g_pool_nthreads > 0) {
+        g_pool_quit = 1;
+        ReleaseSemaphore(g_pool_sem, g_pool_nthreads, NULL);
+        WaitForMultipleObjects(g_pool_nthreads, g_pool_threads, TRUE, INFINITE);
+        for (int i = 0; i < g_pool_nthreads; i++) CloseHandle(g_pool_threads[i]);
+    }
+    if (g_pool_sem) CloseHandle(g_pool_sem);
+    if (g_pool_tls != TLS_OUT_OF_INDEXES) TlsFree(g_pool_tls);
+    for (int i = 0; i <= POOL_MAX_THREADS; i++) {
+        free(g_pool_deques[i].items);
+        DeleteCriticalSection(&g_pool_deques[i].lock);
+    }
+    memset(g_pool_deques, 0, sizeof(g_pool_deques));
+    g_pool_tls = TLS_OUT_OF_INDEXES;
+    g_pool_nthreads = 0;
+    g_pool_started = 0;
+    g_pool_quit = 0;
+}
@@ -22,6 +22,7 @@
 #include <commctrl.h>
 #include <commdlg.h>
 #include <shellapi.h>
+#include <shlobj.h>
 #include <objbase.h>
 #include <shlwapi.h>
 #include <dwmapi.h>
@@ -33,6 +34,14 @@
 #include <math.h>
 #include <stddef.h>
 
+#include "regex.h"
+#include "chartab.h"
+#include "dict.h"
+#include "speller.h"
+#include "utf8.h"
+#include "lz.h"
+#include "diff.h"
+
 /* ── Buffer position type ── */
 typedef ptrdiff_t bpos;
 #ifdef _MSC_VER
@@ -136,6 +145,45 @@ typedef struct {
 #define TIMER_SMOOTH     2
 #define TIMER_AUTOSAVE   3
 #define TIMER_DRAG_SCROLL 4
+#define TIMER_FILE_CHANGE 5
+#define TIMER_SEARCH_SETTLE 6
+
+/* Custom window messages */
+#define WM_SEARCH_RESULTS (WM_USER + 2)
+#define WM_SEARCH_TAB_HITS (WM_USER + 3)
+#define WM_FIND_RESULTS  (WM_USER + 4)
+#define WM_TRI_BUILT     (WM_USER + 5)
+#define WM_SPELL_RESULTS (WM_USER + 6)
+#define WM_SAVE_DONE     (WM_USER + 7)
+#define WM_FILE_CHANGED  (WM_USER + 8)
+#define WM_FILE_LOADED   (WM_USER + 9)
+
+/* Background search tuning */
+#define SEARCH_CHUNK     (256 * 1024)
+#define FOLD_BLOCK       4096
+
+/* Thread pool */
+#define POOL_MAX_THREADS 16
+
+/* Find in files */
+#define FIF_MAX_FILE     (16 * 1024 * 1024)
+#define FIF_SNIFF_BYTES  8000
+#define FIF_MAX_PER_FILE 1000
+#define FIF_LINE_TEXT    160
+
+/* Trigram index */
+#define TRI_MIN_DOC      (4 * 1024 * 1024)
+#define TRI_CHUNK        4096
+#define TRI_BLOOM_BITS   8192
+#define TRI_MAX_PATCH    (64 * 1024)
+
+/* Background spell checking */
+#define SPELL_SLICE_LINES    2000          /* per message when checking on the UI thread */
+#define SPELL_LINE_SLOTS     (1 << 15)     /* line cache entries, power of two */
+#define SPELL_LINE_RANGES    (1 << 18)     /* cached misspellings before the cache resets */
+#define SPELL_LINE_CACHE_LEN 4096          /* longer lines are not cached */
+#define SPELL_MAX_PATCH      (64 * 1024)
+#define SPELL_SUGGEST_MAX    8             /* corrections offered for a word */
 
 /* ═══════════════════════════════════════════════════════════════
  * DATA STRUCTURES
@@ -147,14 +195,33 @@ typedef struct {
     size_t capacity;
 } Arena;
 
+/* Called after every insert or delete with the edit in post-edit
+ * coordinates: `removed` characters at `pos` were replaced by
+ * `inserted` characters. While it runs the gap sits at the edit, so
+ * inserted text is buf[gap_start - inserted, gap_start) and removed
+ * text is still intact at buf[gap_end - removed, gap_end). */
+typedef void (*GbEditFn)(void *ctx, bpos pos, bpos removed, bpos inserted);
+
 typedef struct {
     wchar_t *buf;
     bpos total;
     bpos gap_start;
     bpos gap_end;
     int  mutation;
+    GbEditFn on_edit;
+    void *edit_ctx;
 } GapBuffer;
 
+/* Immutable copy of a document's text, shared with worker threads.
+ * Refcounted; the owning Document keeps one reference while its
+ * mutation counter still matches. */
+typedef struct {
+    volatile LONG refs;
+    int  mutation;
+    bpos len;
+    wchar_t *text;
+} DocSnapshot;
+
 typedef struct {
     bpos *offsets;
     bpos count;
@@ -199,6 +266,74 @@ typedef struct {
 
 typedef enum { MODE_PROSE, MODE_CODE } EditorMode;
 
+typedef struct TriIndex TriIndex;
+typedef struct DocStream DocStream;
+
+/* Misspelled ranges of a document, sorted by position */
+typedef struct {
+    bpos *pos;
+    int  *len;
+    int count;
+    int cap;
+    int scanning;   /* a pass is in flight */
+    int ready;      /* the list covers the whole document */
+} SpellMarks;
+
+/* Writing analytics for one paragraph (analytics.c) */
+typedef struct {
+    bpos start;
+    bpos len;
+    int words;
+    int sentences;
+    int syllables;
+} ParaStats;
+
+typedef struct {
+    ParaStats *paras;   /* sorted by start */
+    int count;
+    int cap;
+    bpos words;         /* totals over paras */
+    bpos sentences;
+    bpos syllables;
+    int off;            /* a paragraph grew too large to follow */
+    int live;           /* edits count toward the typing timeline */
+} DocAnalytics;
+
+/* Edits since the last autosave checkpoint, as journal records not yet
+ * handed to the writer (file_io.c) */
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    unsigned int gen;        /* checkpoint the journal follows; 0 if none */
+    size_t disk;             /* journal bytes queued since that checkpoint */
+    DWORD checkpoint_time;
+    int broken;              /* an edit was not recorded; checkpoint again */
+    int failed;              /* the last checkpoint could not be written */
+} EditJournal;
+
+/* Size and write time of a file, to notice it changing on disk */
+typedef struct {
+    unsigned long long size;
+    FILETIME time;
+} FileStamp;
+
+/* Where a hibernated tab was (session.c), held until its file is in */
+typedef struct {
+    int pending;
+    FileStamp disk;          /* of the file when the session was saved */
+    bpos cursor, sel_anchor;
+    int scroll_y, scroll_x;
+} WakePlace;
+
+/* Follow mode (watch.c): the file is read on from offset as it grows */
+typedef struct {
+    int on;
+    unsigned long long offset;              /* bytes of the file read */
+    DWORD volume, index_hi, index_lo;       /* which file; changes on rotation */
+    Utf8Decoder dec;                        /* carries a split sequence */
+} FollowState;
+
 typedef struct {
     GapBuffer gb;
     LineCache lc;
@@ -218,7 +353,6 @@ typedef struct {
     bpos word_count;
     bpos char_count;
     bpos line_count;
-    int stats_dirty;
     int wrap_dirty;
     bpos session_start_words;
     bpos session_start_chars;
@@ -229,19 +363,64 @@ typedef struct {
     int bc_cached_mutation;
     bpos bc_cached_line;
     int bc_cached_state;
+    DocSnapshot *snapshot;
+    int search_hits;
+    int is_results;
+    int loading;             /* text still being read (open_files, or streamed) */
+    DocStream *stream;       /* rest of a large file being read (file_io.c) */
+    int hibernated;          /* restored without its text (session.c) */
+    WakePlace wake;
+    TriIndex *tri;
+    int tri_pending;
+    SpellMarks spell;
+    DocAnalytics analytics;
+    EditJournal journal;
+    FileStamp disk;          /* of filepath when last loaded or saved */
+    FollowState follow;
 } Document;
 
+/* Fills an open file for write_file_atomic; 0 on failure */
+typedef int (*FileWriteFn)(HANDLE h, void *ctx);
+
+/* write_doc_utf8 context: head, then seg[0] and seg[1] as UTF-8 with
+ * CRLF line endings, in LZ blocks (lz.h) if compress is set */
+typedef struct {
+    const wchar_t *seg[2];
+    bpos seg_len[2];
+    const char *head;
+    int head_len;
+    int compress;
+} DocWrite;
+
 typedef struct {
     wchar_t query[256];
     int active;
     int current_match;
     int match_count;
     bpos *match_positions;
+    int *match_lengths;
+    int match_capacity;
+    int scanning;
+    int regex;
+    int all_tabs;
+    int query_invalid;
+    Document *match_doc;
     int replace_active;
     int replace_focused;
     wchar_t replace_text[256];
 } SearchState;
 
+/* Spelling suggestion popup */
+typedef struct {
+    int open;
+    int count;
+    int hover;
+    int x, y;                 /* anchor, client coordinates */
+    bpos pos;                 /* the word being corrected */
+    int len;
+    wchar_t words[SPELL_SUGGEST_MAX][SPELL_WORD_MAX];
+} SuggestState;
+
 typedef struct {
     int active;
     float dim_alpha;
@@ -263,6 +442,9 @@ typedef struct {
 #define MENU_ID_FIND        20
 #define MENU_ID_REPLACE     21
 #define MENU_ID_FIND_NEXT   22
+#define MENU_ID_REGEX       23
+#define MENU_ID_ALL_TABS    24
+#define MENU_ID_FIND_FILES  25
 #define MENU_ID_TOGGLE_MODE 30
 #define MENU_ID_MINIMAP     31
 #define MENU_ID_FOCUS       32
@@ -271,6 +453,9 @@ typedef struct {
 #define MENU_ID_ZOOM_IN     35
 #define MENU_ID_ZOOM_OUT    36
 #define MENU_ID_SPELLCHECK  37
+#define MENU_ID_NEXT_SPELL  38
+#define MENU_ID_SUGGEST     39
+#define MENU_ID_FOLLOW      40
 
 typedef struct {
     const wchar_t *label;
@@ -310,6 +495,7 @@ typedef struct {
     int active_tab;
 
     SearchState search;
+    SuggestState suggest;
     FocusMode focus;
 
     int cursor_visible;
@@ -430,15 +616,26 @@ typedef struct ISpellCheckerFactoryVtbl {
 typedef struct { ISpellCheckerFactoryVtbl *lpVtbl; } ISpellCheckerFactory;
 
 /* Spell cache constants */
-#define SPELL_CACHE_BUCKETS 4096
-#define SPELL_CACHE_MASK    (SPELL_CACHE_BUCKETS - 1)
-#define SPELL_CACHE_MAX 8192
+#define SPELL_CACHE_SLOTS   8192                        /* power of two */
+#define SPELL_CACHE_MASK    (SPELL_CACHE_SLOTS - 1)
+#define SPELL_CACHE_MAX     (SPELL_CACHE_SLOTS * 3 / 4)
+#define SPELL_KEY_MAX       28                          /* longer words bypass the cache */
 
-typedef struct SpellCacheNode {
-    wchar_t *word;
-    int      correct;
-    struct SpellCacheNode *next;
-} SpellCacheNode;
+/* One cache line per entry; the key is stored inline. */
+typedef struct {
+    unsigned int  hash;      /* 0 = empty */
+    unsigned char len;
+    unsigned char correct;
+    unsigned char ref;       /* CLOCK reference bit */
+    wchar_t word[SPELL_KEY_MAX];
+} SpellSlot;
+
+typedef struct {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    int count;
+} SpellCacheStats;
 
 /* Keyword hash set */
 #define KW_HASH_BUCKETS 256
@@ -477,12 +674,16 @@ void gb_grow(GapBuffer *gb, bpos needed);
 void gb_move_gap(GapBuffer *gb, bpos pos);
 void gb_insert(GapBuffer *gb, bpos pos, const wchar_t *text, bpos len);
 void gb_delete(GapBuffer *gb, bpos pos, bpos len);
+wchar_t *gb_append_reserve(GapBuffer *gb, bpos len);
+void gb_append_commit(GapBuffer *gb, bpos len);
 void gb_copy_range(GapBuffer *gb, bpos start, bpos len, wchar_t *dst);
 wchar_t *gb_extract(GapBuffer *gb, bpos start, bpos len, Arena *a);
 wchar_t *gb_extract_alloc(GapBuffer *gb, bpos start, bpos len);
 void lc_init(LineCache *lc);
 void lc_free(LineCache *lc);
 void lc_rebuild(LineCache *lc, GapBuffer *gb);
+void lc_adopt(LineCache *lc, bpos *offsets, bpos count, bpos capacity);
+int  lc_notify_append(LineCache *lc, const bpos *starts, bpos count);
 bpos lc_line_of(LineCache *lc, bpos pos);
 bpos lc_line_start(LineCache *lc, bpos line);
 bpos lc_line_end(LineCache *lc, GapBuffer *gb, bpos line);
@@ -492,6 +693,7 @@ void wc_init(WrapCache *wc);
 void wc_free(WrapCache *wc);
 void wc_push(WrapCache *wc, bpos pos, bpos line);
 void wc_rebuild(WrapCache *wc, GapBuffer *gb, LineCache *lc, int wrap_col);
+void wc_extend(WrapCache *wc, GapBuffer *gb, LineCache *lc, bpos from);
 bpos wc_visual_line_of(WrapCache *wc, bpos pos);
 bpos wc_visual_line_end(WrapCache *wc, GapBuffer *gb, LineCache *lc, bpos vline);
 bpos wc_col_in_vline(WrapCache *wc, bpos pos, bpos vline);
@@ -500,6 +702,21 @@ void undo_push(UndoStack *us, UndoType type, bpos pos, const wchar_t *text, bpos
 void undo_clear(UndoStack *us);
 void undo_free(UndoStack *us);
 
+/* pool.c */
+typedef void (*PoolTaskFn)(void *arg);
+
+typedef struct {
+    volatile LONG pending;
+    HANDLE done;
+} PoolGroup;
+
+void pool_submit(PoolTaskFn fn, void *arg);
+int  pool_worker_index(void);
+void pool_group_init(PoolGroup *grp);
+void pool_group_submit(PoolGroup *grp, PoolTaskFn fn, void *arg);
+void pool_group_wait(PoolGroup *grp);
+void pool_shutdown(void);
+
 /* theme.c */
 void apply_theme(int index);
 
@@ -507,6 +724,31 @@ void apply_theme(int index);
 void spell_init(void);
 int  spell_check(const wchar_t *word, int len);
 void spell_cache_free(void);
+void spell_cache_save(void);
+void spell_cache_stats(SpellCacheStats *out);
+void spell_dict_free(void);
+int  spell_backend_thread_safe(void);
+void spell_check_text(const wchar_t *text, bpos n, SpellErrorFn fn, void *ctx);
+void spell_check_text_local(const wchar_t *text, bpos n, SpellErrorFn fn, void *ctx);
+int  spell_suggest(const wchar_t *word, int len, wchar_t (*out)[SPELL_WORD_MAX], int k);
+
+/* spellscan.c */
+void spell_scan_init(void);
+void spell_scan_cancel(void);
+void spell_scan_free(void);
+void spell_sync_doc(void);
+void spell_on_results(LPARAM lParam);
+void spell_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted);
+int  spell_marks_lower_bound(const SpellMarks *sm, bpos pos);
+void spell_marks_free(SpellMarks *sm);
+void spell_toggle(void);
+void spell_goto_next(int dir);
+void spell_suggest_at(bpos pos);
+void spell_suggest_rect(RECT *r);
+int  spell_suggest_hit(int mx, int my);
+void spell_suggest_apply(int i);
+void spell_suggest_close(void);
+int  spell_suggest_key(WPARAM vk);
 
 /* syntax.c */
 COLORREF token_color(SynToken t);
@@ -521,9 +763,10 @@ void doc_free(Document *doc);
 Document *current_doc(void);
 void recalc_lines(Document *doc);
 void recalc_wrap_now(Document *doc);
-void update_stats(Document *doc);
-void update_stats_now(Document *doc);
 void snapshot_session_baseline(Document *doc);
+DocSnapshot *doc_snapshot(Document *doc);
+void snapshot_release(DocSnapshot *snap);
+void doc_drop_snapshot(Document *doc);
 bpos pos_to_line(Document *doc, bpos pos);
 bpos pos_to_col(Document *doc, bpos pos);
 bpos line_col_to_pos(Document *doc, bpos line, bpos col);
@@ -557,35 +800,101 @@ void toggle_mode(void);
 
 /* search.c */
 void search_update_matches(void);
+void search_cancel(void);
+void search_finish_now(void);
+void search_on_results(LPARAM lParam);
+void search_toggle_regex(void);
+void search_toggle_all_tabs(void);
+void search_sync_doc(void);
+void search_on_tab_hits(LPARAM lParam);
+void search_on_settle(void);
+int  search_total_hits(int *tabs_with_hits, int *pending);
+void search_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted);
+int  search_literal(const wchar_t *text, bpos len, const wchar_t *lq, int qlen,
+                    bpos from, bpos to, RxMatchFn fn, void *ctx);
 void toggle_search(void);
 void search_next(void);
 void search_prev(void);
 void do_replace(void);
 void do_replace_all(void);
 
+/* trigram.c */
+void tri_request(Document *doc);
+void tri_on_built(LPARAM lParam);
+void tri_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted);
+int  tri_candidates(Document *doc, const wchar_t *lq, int qlen, bpos **out);
+void tri_cancel(void);
+void tri_free(TriIndex *ix);
+
+/* analytics.c */
+void   analytics_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted);
+void   analytics_free(DocAnalytics *an);
+double analytics_reading_ease(bpos words, bpos sentences, bpos syllables);
+void   analytics_timeline(int *words, int n, DWORD bucket_ms);
+
+/* findfiles.c */
+void find_in_files_prompt(void);
+void find_in_files_start(const wchar_t *dir);
+void find_in_files_cancel(void);
+void find_in_files_on_results(void);
+int  find_in_files_open_at(Document *doc, bpos pos);
+
 /* menu.c */
 void menu_execute(int id);
 
 /* file_io.c */
-void load_file(Document *doc, const wchar_t *path);
-char *doc_to_utf8(Document *doc, int *out_len);
-int  write_file_atomic(const wchar_t *final_path, const char *data, int data_len);
+int load_file(Document *doc, const wchar_t *path);
+int load_file_whole(Document *doc, const wchar_t *path);
+void load_cancel(Document *doc);
+void set_doc_path(Document *doc, const wchar_t *path);
+int tab_with_path(const wchar_t *path);
+void open_files(const wchar_t *const *paths, int count);
+void load_on_done(void);
+void load_shutdown(void);
+wchar_t *read_text_file(const wchar_t *path, bpos *len, bpos *bytes);
+int  write_doc_utf8(HANDLE h, void *ctx);
+int  write_file_atomic(const wchar_t *final_path, FileWriteFn write, void *ctx);
 void save_file(Document *doc, const wchar_t *path);
+void save_on_done(void);
+int  save_busy(void);
+void save_flush(void);
+void save_shutdown(void);
 void autosave_ensure_dir(void);
 void autosave_path_for_doc(Document *doc, wchar_t *out);
+void autosave_index_path(Document *doc, wchar_t *out);
 void autosave_write(Document *doc);
 void autosave_tick(void);
+void journal_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted);
+void journal_free(EditJournal *j);
 void autosave_delete_for_doc(Document *doc);
 void autosave_cleanup_all(void);
 void autosave_cleanup_tmp(void);
 void autosave_recover(void);
 int  prompt_save_doc(int tab_idx);
+Document *open_file_in_tab(const wchar_t *path);
 void open_file_dialog(void);
 void save_file_dialog(void);
 int  save_file_dialog_for_doc(Document *doc);
 void save_current_file(void);
 void new_tab(void);
 void close_tab(int idx);
+int activate_tab(int idx);
+int wake_tab(int idx, int whole);
+
+/* watch.c */
+void watch_stamp(Document *doc);
+void watch_tick(void);
+void watch_on_change(void);
+void watch_check(void);
+void watch_shutdown(void);
+void follow_toggle(Document *doc);
+void follow_free(Document *doc);
+
+/* session.c */
+void session_save(void);
+void session_restore(void);
+int session_wake(Document *doc, int whole);
+void session_place(Document *doc);
 
 /* render.c */
 void fill_rect(HDC hdc, int x, int y, int w, int h, COLORREF c);
@@ -599,10 +908,12 @@ void render_editor(HDC hdc);
 void render_stats_screen(HDC hdc);
 void render_menubar(HDC hdc);
 void render_menu_dropdown(HDC hdc);
+void render_suggest_popup(HDC hdc);
 void render(HDC hdc);
 
 /* wndproc.c */
 bpos mouse_to_pos(int mx, int my);
+void pos_to_point(bpos pos, int *x, int *y);
 int  scrollbar_thumb_geometry(int *out_thumb_y, int *out_thumb_h, int *out_edit_y, int *out_edit_h);
 bpos word_start(GapBuffer *gb, bpos pos);
 bpos word_end(GapBuffer *gb, bpos pos);
@@ -0,0 +1,1072 @@
+/*
+ * regex.c — Linear-time regular expression matcher
+ *
+ * pattern → AST → Thompson NFA → lazily built DFA. Nothing backtracks:
+ * each text character costs one cached DFA transition, or one NFA set
+ * step when the DFA cache thrashes and the engine falls back to
+ * uncached simulation. Case folding is baked into the character class
+ * map at compile time, so the scan loops never fold.
+ *
+ * Finding a match uses two automata. The reversed pattern runs
+ * unanchored backwards over a line and marks every position where a
+ * match can start. The forward pattern then runs anchored from each
+ * surviving start to find the longest end. If the pattern begins with
+ * a literal, candidate starts come from a prefix scan and the reverse
+ * pass is skipped until a candidate fails: a failed anchored run may
+ * have read to the end of the line, and retrying from every later
+ * candidate would be quadratic, so the rest of that line goes through
+ * the reverse pass, whose starts cannot fail.
+ *
+ * Extending a real start to its longest end still reads until the
+ * forward DFA dies, which can run past the end it reports.
+ */
+#include "regex.h"
+#include "chartab.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RX_MAX_NODES    20000
+#define RX_MAX_REPEAT   1000
+#define RX_MAX_DEPTH    500
+#define RX_CHARS        0x10000
+#define RX_MAX_PREFIX   64
+#define RX_DFA_BUDGET   (4 << 20)   /* bytes of transition table per DFA */
+#define RX_DFA_MIN      64
+#define RX_DFA_MAX      8192
+#define RX_MAX_FLUSHES  8
+
+/* ── AST ── */
+
+enum { N_EMPTY, N_SET, N_BOL, N_EOL, N_CAT, N_ALT, N_STAR, N_PLUS, N_QUEST };
+
+typedef struct { int type, a, b; } RxNode;      /* N_SET: a = set index */
+typedef struct { int lo, hi; } RxRange;
+typedef struct { int first, count, negate; } RxSet;
+
+typedef struct {
+    const wchar_t *p;
+    const char *err;
+    int depth;
+    RxNode *nodes;   int nnodes, ncap;
+    RxSet *sets;     int nsets, scap;
+    RxRange *ranges; int nranges, rcap;
+} RxParser;
+
+/* ── NFA ── */
+
+enum { S_SET, S_BOL, S_EOL, S_SPLIT, S_EPS, S_MATCH };
+
+typedef struct { unsigned char op; int set, out, out1; } RxState;
+
+typedef struct {
+    RxState *st;
+    int n, cap;
+    int start;
+    int *start_set;   /* epsilon closure of start, important states only */
+    int start_len;
+} RxNfa;
+
+/* ── Lazy DFA ──
+ * A DFA state is the sorted set of "important" NFA states (character
+ * consumers and MATCH) reached after consuming input. Unanchored DFAs
+ * re-inject the start closure before every step. Ids 0 and 1 are
+ * scratch slots used only after the cache has been frozen. */
+
+#define DFA_SCRATCH 2
+
+typedef struct {
+    const RxNfa *nfa;
+    const struct Regex *rx;
+    int anchored;
+    int nsym;
+    int count, cap;
+    int *trans;              /* cap * nsym, -1 = not computed */
+    int *set_off, *set_len;
+    unsigned char *accept;
+    int *pool;  int pool_used, pool_cap;
+    int *table; int table_mask;
+    int init;                /* initial state (start closure or empty set) */
+    int flushes;
+    int frozen;
+    int *scratch[2]; int scratch_len[2]; unsigned char scratch_acc[2];
+    int *mark; int mark_gen;
+    int *stack;
+    int *tmp;
+} RxDfa;
+
+struct Regex {
+    unsigned short *cmap;    /* UTF-16 unit → case-folded class */
+    int nclass, nsym;        /* nsym = nclass + BOL + EOL */
+    unsigned char *setbits;  /* nset × nclass membership */
+    int nset;
+    RxNfa fwd, rev;
+    RxDfa dfwd, drev;
+    int prefix[RX_MAX_PREFIX];   /* set index per leading literal char */
+    int prefix_len;
+    int bol_anchored;
+};
+
+#define SYM_BOL(rx) ((rx)->nclass)
+#define SYM_EOL(rx) ((rx)->nclass + 1)
+
+#if WCHAR_MAX > 0xFFFF
+  #define RX_SYM(rx, c) ((unsigned)(c) < RX_CHARS ? (rx)->cmap[(unsigned)(c)] : (rx)->cmap[RX_CHARS - 1])
+#else
+  #define RX_SYM(rx, c) ((rx)->cmap[(unsigned short)(c)])
+#endif
+
+static int rx_fold(int c) {
+    return (unsigned short)ch_fold((wchar_t)c);
+}
+
+/* ═══════════════════════════════════════════════════════════════
+ * PARSER
+ * ═══════════════════════════════════════════════════════════════ */
+
+static int grow(void **ptr, int *cap, int need, size_t elem) {
+    if (need <= *cap) return 1;
+    int ncap = *cap ? *cap * 2 : 64;
+    while (ncap < need) ncap *= 2;
+    void *tmp = realloc(*ptr, (size_t)ncap * elem);
+    if (!tmp) return 0;
+    *ptr = tmp;
+    *cap = ncap;
+    return 1;
+}
+
+static int new_node(RxParser *ps, int type, int a, int b) {
+    if (ps->err) return -1;
+    if (ps->nnodes >= RX_MAX_NODES) { ps->err = "pattern too large"; return -1; }
+    if (!grow((void **)&ps->nodes, &ps->ncap, ps->nnodes + 1, sizeof(RxNode))) {
+        ps->err = "out of memory";
+        return -1;
+    }
+    RxNode *n = &ps->nodes[ps->nnodes];
+    n->type = type;
+    n->a = a;
+    n->b = b;
+    return ps->nnodes++;
+}
+
+static int new_set(RxParser *ps) {
+    if (!grow((void **)&ps->sets, &ps->scap, ps->nsets + 1, sizeof(RxSet))) {
+        ps->err = "out of memory";
+        return -1;
+    }
+    RxSet *s = &ps->sets[ps->nsets];
+    s->first = ps->nranges;
+    s->count = 0;
+    s->negate = 0;
+    return ps->nsets++;
+}
+
+/* Ranges of a set must be appended contiguously. */
+static void add_range(RxParser *ps, int set, int lo, int hi) {
+    if (set < 0 || ps->err) return;
+    if (!grow((void **)&ps->ranges, &ps->rcap, ps->nranges + 1, sizeof(RxRange))) {
+        ps->err = "out of memory";
+        return;
+    }
+    ps->ranges[ps->nranges].lo = lo;
+    ps->ranges[ps->nranges].hi = hi;
+    ps->nranges++;
+    ps->sets[set].count++;
+}
+
+/* Add every BMP unit whose class bits intersect `flags`, as ranges. */
+static void add_class_ranges(RxParser *ps, int set, unsigned flags) {
+    int lo = -1;
+    for (int c = 0; c <= RX_CHARS; c++) {
+        int in = c < RX_CHARS && (ch_class((wchar_t)c) & flags);
+        if (in && lo < 0) lo = c;
+        else if (!in && lo >= 0) { add_range(ps, set, lo, c - 1); lo = -1; }
+    }
+}
+
+static void add_class_escape(RxParser *ps, int set, wchar_t e) {
+    switch (e) {
+    case L'd': add_range(ps, set, '0', '9'); break;
+    case L'w':
+        add_class_ranges(ps, set, CH_ALPHA | CH_DIGIT);
+        add_range(ps, set, '_', '_');
+        break;
+    case L's':
+        add_class_ranges(ps, set, CH_SPACE);
+        break;
+    }
+}
+
+static int hex_value(const wchar_t **pp, int digits) {
+    int v = 0;
+    for (int i = 0; i < digits; i++) {
+        wchar_t c = (*pp)[i];
+        int d;
+        if (c >= L'0' && c <= L'9') d = c - L'0';
+        else if (c >= L'a' && c <= L'f') d = c - L'a' + 10;
+        else if (c >= L'A' && c <= L'F') d = c - L'A' + 10;
+        else return -1;
+        v = v * 16 + d;
+    }
+    *pp += digits;
+    return v;
+}
+
+/* Decode a single-character escape after '\'. Returns the character or
+ * -1 for class escapes (\d \w \s and negations), which the caller
+ * handles. */
+static int parse_escape_char(RxParser *ps) {
+    wchar_t c = *ps->p;
+    if (!c) { ps->err = "trailing backslash"; return 0; }
+    ps->p++;
+    switch (c) {
+    case L't': return '\t';
+    case L'n': return '\n';
+    case L'r': return '\r';
+    case L'f': return '\f';
+    case L'v': return '\v';
+    case L'0': return 0;
+    case L'x': case L'u': {
+        int v = hex_value(&ps->p, c == L'x' ? 2 : 4);
+        if (v < 0) ps->err = "bad hex escape";
+        return v < 0 ? 0 : v;
+    }
+    case L'd': case L'w': case L's': case L'D': case L'W': case L'S':
+        ps->p--;
+        return -1;
+    case L'b': case L'B': case L'A': case L'z': case L'Z':
+        ps->err = "unsupported assertion";
+        return 0;
+    default:
+        if (ch_isalnum(c)) { ps->err = "unknown escape"; return 0; }
+        return c;
+    }
+}
+
+static int single_char_set(RxParser *ps, int c) {
+    int set = new_set(ps);
+    add_range(ps, set, c, c);
+    return new_node(ps, N_SET, set, 0);
+}
+
+static int parse_bracket(RxParser *ps) {
+    int set = new_set(ps);
+    if (set < 0) return -1;
+    if (*ps->p == L'^') { ps->sets[set].negate = 1; ps->p++; }
+    int first = 1;
+    while (!ps->err) {
+        wchar_t c = *ps->p;
+        if (!c) { ps->err = "unterminated [ ]"; break; }
+        if (c == L']' && !first) { ps->p++; break; }
+        first = 0;
+        int lo;
+        ps->p++;
+        if (c == L'\\') {
+            lo = parse_escape_char(ps);
+            if (lo < 0) {
+                wchar_t e = *ps->p++;
+                if (e == L'D' || e == L'W' || e == L'S') {
+                    ps->err = "negated class escape inside [ ]";
+                    break;
+                }
+                add_class_escape(ps, set, e);
+                continue;
+            }
+        } else {
+            lo = c;
+        }
+        int hi = lo;
+        if (ps->p[0] == L'-' && ps->p[1] && ps->p[1] != L']') {
+            ps->p++;
+            wchar_t d = *ps->p++;
+            if (d == L'\\') {
+                hi = parse_escape_char(ps);
+                if (hi < 0) { ps->err = "class escape as range end"; break; }
+            } else {
+                hi = d;
+            }
+            if (hi < lo) { ps->err = "reversed range"; break; }
+        }
+        add_range(ps, set, lo, hi);
+    }
+    return new_node(ps, N_SET, set, 0);
+}
+
+static int parse_alt(RxParser *ps);
+
+static int parse_atom(RxParser *ps) {
+    wchar_t c = *ps->p;
+    switch (c) {
+    case L'(': {
+        ps->p++;
+        if (ps->p[0] == L'?' && ps->p[1] == L':') ps->p += 2;
+        if (++ps->depth > RX_MAX_DEPTH) { ps->err = "nesting too deep"; return -1; }
+        int n = parse_alt(ps);
+        ps->depth--;
+        if (*ps->p != L')') { if (!ps->err) ps->err = "missing )"; return -1; }
+        ps->p++;
+        return n;
+    }
+    case L'[':
+        ps->p++;
+        return parse_bracket(ps);
+    case L'.': {
+        ps->p++;
+        int set = new_set(ps);
+        add_range(ps, set, '\n', '\n');
+        if (set >= 0) ps->sets[set].negate = 1;
+        return new_node(ps, N_SET, set, 0);
+    }
+    case L'^': ps->p++; return new_node(ps, N_BOL, 0, 0);
+    case L'$': ps->p++; return new_node(ps, N_EOL, 0, 0);
+    case L'\\': {
+        ps->p++;
+        int v = parse_escape_char(ps);
+        if (ps->err) return -1;
+        if (v >= 0) return single_char_set(ps, v);
+        wchar_t e = *ps->p++;
+        int set = new_set(ps);
+        add_class_escape(ps, set, ch_fold(e));
+        if (set >= 0 && ch_isupper(e)) ps->sets[set].negate = 1;
+        return new_node(ps, N_SET, set, 0);
+    }
+    case L'*': case L'+': case L'?':
+        ps->err = "quantifier without operand";
+        return -1;
+    default:
+        ps->p++;
+        return single_char_set(ps, c);
+    }
+}
+
+static int clone_node(RxParser *ps, int n) {
+    if (n < 0 || ps->err) return -1;
+    RxNode src = ps->nodes[n];
+    int a = src.a, b = src.b;
+    switch (src.type) {
+    case N_CAT: case N_ALT:
+        a = clone_node(ps, src.a);
+        b = clone_node(ps, src.b);
+        break;
+    case N_STAR: case N_PLUS: case N_QUEST:
+        a = clone_node(ps, src.a);
+        break;
+    }
+    return new_node(ps, src.type, a, b);
+}
+
+static int cat(RxParser *ps, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    return new_node(ps, N_CAT, a, b);
+}
+
+/* Parse {m}, {m,} or {m,n}. Returns 0 when the brace is not a
+ * quantifier, in which case it is taken literally. */
+static int parse_braces(RxParser *ps, int *m, int *n) {
+    const wchar_t *p = ps->p + 1;
+    if (*p < L'0' || *p > L'9') return 0;
+    int lo = 0, hi;
+    while (*p >= L'0' && *p <= L'9') { lo = lo * 10 + (*p - L'0'); if (lo > RX_MAX_REPEAT) lo = RX_MAX_REPEAT + 1; p++; }
+    if (*p == L'}') {
+        hi = lo;
+    } else if (*p == L',') {
+        p++;
+        if (*p == L'}') {
+            hi = -1;
+        } else {
+            if (*p < L'0' || *p > L'9') return 0;
+            hi = 0;
+            while (*p >= L'0' && *p <= L'9') { hi = hi * 10 + (*p - L'0'); if (hi > RX_MAX_REPEAT) hi = RX_MAX_REPEAT + 1; p++; }
+            if (*p != L'}') return 0;
+        }
+    } else {
+        return 0;
+    }
+    ps->p = p + 1;
+    *m = lo;
+    *n = hi;
+    return 1;
+}
+
+static int repeat(RxParser *ps, int atom, int m, int n) {
+    if (m > RX_MAX_REPEAT || n > RX_MAX_REPEAT) { ps->err = "repeat count too large"; return -1; }
+    if (n >= 0 && n < m) { ps->err = "bad repeat range"; return -1; }
+    int out = -1;
+    for (int i = 0; i < m; i++)
+        out = cat(ps, out, i == 0 ? atom : clone_node(ps, atom));
+    if (n < 0) {
+        out = cat(ps, out, new_node(ps, N_STAR, m == 0 ? atom : clone_node(ps, atom), 0));
+    } else {
+        for (int i = m; i < n; i++)
+            out = cat(ps, out, new_node(ps, N_QUEST, i == 0 ? atom : clone_node(ps, atom), 0));
+    }
+    return out < 0 ? new_node(ps, N_EMPTY, 0, 0) : out;
+}
+
+static int parse_repeat(RxParser *ps) {
+    int atom = parse_atom(ps);
+    while (!ps->err) {
+        wchar_t c = *ps->p;
+        int m, n;
+        if (c == L'*')      { ps->p++; atom = new_node(ps, N_STAR, atom, 0); }
+        else if (c == L'+') { ps->p++; atom = new_node(ps, N_PLUS, atom, 0); }
+        else if (c == L'?') { ps->p++; atom = new_node(ps, N_QUEST, atom, 0); }
+        else if (c == L'{' && parse_braces(ps, &m, &n)) atom = repeat(ps, atom, m, n);
+        else break;
+    }
+    return atom;
+}
+
+static int parse_cat(RxParser *ps) {
+    int out = -1;
+    while (!ps->err && *ps->p && *ps->p != L'|' && *ps->p != L')')
+        out = cat(ps, out, parse_repeat(ps));
+    return out < 0 ? new_node(ps, N_EMPTY, 0, 0) : out;
+}
+
+static int parse_alt(RxParser *ps) {
+    int out = parse_cat(ps);
+    while (!ps->err && *ps->p == L'|') {
+        ps->p++;
+        out = new_node(ps, N_ALT, out, parse_cat(ps));
+    }
+    return out;
+}
+
+/* ═══════════════════════════════════════════════════════════════
+ * CHARACTER CLASSES
+ * ═══════════════════════════════════════════════════════════════ */
+
+/* Fold every set into sorted case-folded ranges, then partition the
+ * folded alphabet into classes of characters no set can tell apart. */
+
+typedef struct { RxRange *r; int n; } FoldedSet;
+
+static int set_contains(const FoldedSet *fs, int c) {
+    int lo = 0, hi = fs->n - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (c < fs->r[mid].lo) hi = mid - 1;
+        else if (c > fs->r[mid].hi) lo = mid + 1;
+        else return 1;
+    }
+    return 0;
+}
+
+static int fold_set(const RxParser *ps, int s, unsigned char *bm, FoldedSet *out) {
+    const RxSet *set = &ps->sets[s];
+    memset(bm, 0, RX_CHARS);
+    for (int i = 0; i < set->count; i++) {
+        const RxRange *r = &ps->ranges[set->first + i];
+        for (int c = r->lo; c <= r->hi && c < RX_CHARS; c++) {
+            bm[c] = 1;
+            bm[rx_fold(c)] = 1;
+        }
+    }
+    if (set->negate) {
+        for (int c = 0; c < RX_CHARS; c++) bm[c] = !bm[c];
+        bm['\n'] = 0;
+    }
+    int n = 0, cap = 8;
+    RxRange *r = (RxRange *)malloc(cap * sizeof(RxRange));
+    if (!r) return 0;
+    for (int c = 0; c < RX_CHARS; ) {
+        if (!bm[c]) { c++; continue; }
+        int lo = c;
+        while (c < RX_CHARS && bm[c]) c++;
+        if (n == cap) {
+            cap *= 2;
+            RxRange *tmp = (RxRange *)realloc(r, cap * sizeof(RxRange));
+            if (!tmp) { free(r); return 0; }
+            r = tmp;
+        }
+        r[n].lo = lo;
+        r[n].hi = c - 1;
+        n++;
+    }
+    out->r = r;
+    out->n = n;
+    return 1;
+}
+
+static int build_classes(Regex *rx, const RxParser *ps) {
+    int nset = ps->nsets;
+    int ok = 0;
+    unsigned char *bm = (unsigned char *)malloc(RX_CHARS + 1);
+    FoldedSet *fs = (FoldedSet *)calloc(nset ? nset : 1, sizeof(FoldedSet));
+    unsigned short *seg_of = (unsigned short *)malloc(RX_CHARS * sizeof(unsigned short));
+    int *seg_start = NULL, *seg_class = NULL, *hslot = NULL;
+    unsigned char *sig = NULL;
+    if (!bm || !fs || !seg_of) goto done;
+
+    for (int s = 0; s < nset; s++)
+        if (!fold_set(ps, s, bm, &fs[s])) goto done;
+
+    /* Segments: maximal runs between range boundaries */
+    memset(bm, 0, RX_CHARS + 1);
+    bm[0] = 1;
+    for (int s = 0; s < nset; s++)
+        for (int i = 0; i < fs[s].n; i++) {
+            bm[fs[s].r[i].lo] = 1;
+            bm[fs[s].r[i].hi + 1] = 1;
+        }
+    int nseg = 0;
+    for (int c = 0; c < RX_CHARS; c++) if (bm[c]) nseg++;
+    if (nseg > 0xFFFF) goto done;
+    seg_start = (int *)malloc(nseg * sizeof(int));
+    seg_class = (int *)malloc(nseg * sizeof(int));
+    sig = (unsigned char *)calloc((size_t)nseg * (nset ? nset : 1), 1);
+    if (!seg_start || !seg_class || !sig) goto done;
+    for (int c = 0, k = -1; c < RX_CHARS; c++) {
+        if (bm[c]) seg_start[++k] = c;
+        seg_of[c] = (unsigned short)k;
+    }
+
+    /* Merge segments whose set membership is identical */
+    int nclass = 0;
+    int hcap = 1;
+    while (hcap < nseg * 2) hcap <<= 1;
+    hslot = (int *)malloc(hcap * sizeof(int));
+    if (!hslot) goto done;
+    memset(hslot, 0xFF, hcap * sizeof(int));
+    for (int k = 0; k < nseg; k++) {
+        unsigned char *row = sig + (size_t)k * nset;
+        unsigned h = 2166136261u;
+        for (int s = 0; s < nset; s++) {
+            row[s] = (unsigned char)set_contains(&fs[s], seg_start[k]);
+            h = (h ^ row[s]) * 16777619u;
+        }
+        h &= hcap - 1;
+        while (hslot[h] >= 0 && memcmp(sig + (size_t)hslot[h] * nset, row, nset) != 0)
+            h = (h + 1) & (hcap - 1);
+        if (hslot[h] < 0) {
+            hslot[h] = k;
+            seg_class[k] = nclass++;
+        } else {
+            seg_class[k] = seg_class[hslot[h]];
+        }
+    }
+
+    rx->nclass = nclass;
+    rx->nsym = nclass + 2;
+    rx->nset = nset;
+    rx->cmap = (unsigned short *)malloc(RX_CHARS * sizeof(unsigned short));
+    rx->setbits = (unsigned char *)calloc((size_t)(nset ? nset : 1) * nclass, 1);
+    if (!rx->cmap || !rx->setbits) goto done;
+    for (int c = 0; c < RX_CHARS; c++)
+        rx->cmap[c] = (unsigned short)seg_class[seg_of[rx_fold(c)]];
+    for (int k = 0; k < nseg; k++)
+        for (int s = 0; s < nset; s++)
+            if (sig[(size_t)k * nset + s]) rx->setbits[(size_t)s * nclass + seg_class[k]] = 1;
+    ok = 1;
+
+done:
+    if (fs) for (int s = 0; s < nset; s++) free(fs[s].r);
+    free(fs);
+    free(bm);
+    free(seg_of);
+    free(seg_start);
+    free(seg_class);
+    free(hslot);
+    free(sig);
+    return ok;
+}
+
+/* ═══════════════════════════════════════════════════════════════
+ * NFA CONSTRUCTION
+ * ═══════════════════════════════════════════════════════════════ */
+
+static int nfa_add(RxNfa *nfa, int op, int set, int out, int out1) {
+    if (!grow((void **)&nfa->st, &nfa->cap, nfa->n + 1, sizeof(RxState))) return -1;
+    RxState *s = &nfa->st[nfa->n];
+    s->op = (unsigned char)op;
+    s->set = set;
+    s->out = out;
+    s->out1 = out1;
+    return nfa->n++;
+}
+
+/* Build a fragment for node n; *end receives an S_EPS state whose out
+ * is patched by the caller. With reverse set, concatenations are
+ * emitted back to front, producing an automaton for the mirror image. */
+static int nfa_build(RxNfa *nfa, const RxNode *nodes, int n, int reverse, int *end) {
+    const RxNode *node = &nodes[n];
+    int s, e, sa, ea, sb, eb;
+    switch (node->type) {
+    case N_SET: case N_BOL: case N_EOL:
+        if ((e = nfa_add(nfa, S_EPS, 0, -1, -1)) < 0) return -1;
+        s = nfa_add(nfa, node->type == N_SET ? S_SET : node->type == N_BOL ? S_BOL : S_EOL,
+                    node->a, e, -1);
+        *end = e;
+        return s;
+    case N_CAT: {
+        int first = reverse ? node->b : node->a;
+        int second = reverse ? node->a : node->b;
+        if ((sa = nfa_build(nfa, nodes, first, reverse, &ea)) < 0) return -1;
+        if ((sb = nfa_build(nfa, nodes, second, reverse, &eb)) < 0) return -1;
+        nfa->st[ea].out = sb;
+        *end = eb;
+        return sa;
+    }
+    case N_ALT:
+        if ((sa = nfa_build(nfa, nodes, node->a, reverse, &ea)) < 0) return -1;
+        if ((sb = nfa_build(nfa, nodes, node->b, reverse, &eb)) < 0) return -1;
+        if ((e = nfa_add(nfa, S_EPS, 0, -1, -1)) < 0) return -1;
+        nfa->st[ea].out = e;
+        nfa->st[eb].out = e;
+        *end = e;
+        return nfa_add(nfa, S_SPLIT, 0, sa, sb);
+    case N_STAR:
+    case N_QUEST:
+        if ((sa = nfa_build(nfa, nodes, node->a, reverse, &ea)) < 0) return -1;
+        if ((e = nfa_add(nfa, S_EPS, 0, -1, -1)) < 0) return -1;
+        if ((s = nfa_add(nfa, S_SPLIT, 0, sa, e)) < 0) return -1;
+        nfa->st[ea].out = node->type == N_STAR ? s : e;
+        *end = e;
+        return s;
+    case N_PLUS:
+        if ((sa = nfa_build(nfa, nodes, node->a, reverse, &ea)) < 0) return -1;
+        if ((e = nfa_add(nfa, S_EPS, 0, -1, -1)) < 0) return -1;
+        if ((s = nfa_add(nfa, S_SPLIT, 0, sa, e)) < 0) return -1;
+        nfa->st[ea].out = s;
+        *end = e;
+        return sa;
+    default: /* N_EMPTY */
+        if ((e = nfa_add(nfa, S_EPS, 0, -1, -1)) < 0) return -1;
+        *end = e;
+        return e;
+    }
+}
+
+static int is_important(const RxState *s) {
+    return s->op == S_SET || s->op == S_BOL || s->op == S_EOL || s->op == S_MATCH;
+}
+
+/* Epsilon closure of the seeds in `stack[0..n)`, appending important
+ * states to out. Uses mark/gen to visit each state once. */
+static int closure(const RxNfa *nfa, int *stack, int n, int *mark, int gen, int *out, int out_n) {
+    while (n > 0) {
+        int q = stack[--n];
+        if (q < 0 || mark[q] == gen) continue;
+        mark[q] = gen;
+        const RxState *s = &nfa->st[q];
+        if (is_important(s)) {
+            out[out_n++] = q;
+        } else {
+            stack[n++] = s->out;
+            if (s->op == S_SPLIT) stack[n++] = s->out1;
+        }
+    }
+    return out_n;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static int nfa_compile(RxNfa *nfa, const RxNode *nodes, int root, int reverse) {
+    int end;
+    int start = nfa_build(nfa, nodes, root, reverse, &end);
+    if (start < 0) return 0;
+    int match = nfa_add(nfa, S_MATCH, 0, -1, -1);
+    if (match < 0) return 0;
+    nfa->st[end].out = match;
+    nfa->start = start;
+
+    int *mark = (int *)calloc(nfa->n, sizeof(int));
+    int *stack = (int *)malloc(nfa->n * 2 * sizeof(int) + sizeof(int));
+    nfa->start_set = (int *)malloc(nfa->n * sizeof(int));
+    if (!mark || !stack || !nfa->start_set) { free(mark); free(stack); return 0; }
+    stack[0] = start;
+    nfa->start_len = closure(nfa, stack, 1, mark, 1, nfa->start_set, 0);
+    qsort(nfa->start_set, nfa->start_len, sizeof(int), cmp_int);
+    free(mark);
+    free(stack);
+    return 1;
+}
+
+/* ═══════════════════════════════════════════════════════════════
+ * LAZY DFA
+ * ═══════════════════════════════════════════════════════════════ */
+
+static unsigned hash_set(const int *set, int n) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < n; i++) { h ^= (unsigned)set[i]; h *= 16777619u; }
+    return h;
+}
+
+static int has_match(const RxNfa *nfa, const int *set, int n) {
+    for (int i = 0; i < n; i++) if (nfa->st[set[i]].op == S_MATCH) return 1;
+    return 0;
+}
+
+static void dfa_reset(RxDfa *d) {
+    d->count = DFA_SCRATCH;
+    d->pool_used = 0;
+    memset(d->table, 0xFF, (size_t)(d->table_mask + 1) * sizeof(int));
+}
+
+static int dfa_find(RxDfa *d, const int *set, int n) {
+    unsigned h = hash_set(set, n) & d->table_mask;
+    for (;;) {
+        int id = d->table[h];
+        if (id < 0) return -1;
+        if (d->set_len[id] == n && memcmp(d->pool + d->set_off[id], set, n * sizeof(int)) == 0)
+            return id;
+        h = (h + 1) & d->table_mask;
+    }
+}
+
+/* Returns the new state's id, or -1 when the cache is full. */
+static int dfa_insert(RxDfa *d, const int *set, int n) {
+    if (d->count >= d->cap || d->pool_used + n > d->pool_cap) return -1;
+    int id = d->count++;
+    d->set_off[id] = d->pool_used;
+    d->set_len[id] = n;
+    if (n > 0) memcpy(d->pool + d->pool_used, set, n * sizeof(int));
+    d->pool_used += n;
+    d->accept[id] = (unsigned char)has_match(d->nfa, set, n);
+    memset(d->trans + (size_t)id * d->nsym, 0xFF, d->nsym * sizeof(int));
+    unsigned h = hash_set(set, n) & d->table_mask;
+    while (d->table[h] >= 0) h = (h + 1) & d->table_mask;
+    d->table[h] = id;
+    return id;
+}
+
+static int dfa_init(RxDfa *d, const struct Regex *rx, const RxNfa *nfa, int anchored) {
+    memset(d, 0, sizeof(*d));
+    d->rx = rx;
+    d->nfa = nfa;
+    d->anchored = anchored;
+    d->nsym = rx->nsym;
+    int cap = RX_DFA_BUDGET / (d->nsym * (int)sizeof(int));
+    if (cap < RX_DFA_MIN) cap = RX_DFA_MIN;
+    if (cap > RX_DFA_MAX) cap = RX_DFA_MAX;
+    d->cap = cap;
+    int tcap = 1;
+    while (tcap < cap * 2) tcap <<= 1;
+    d->table_mask = tcap - 1;
+    d->pool_cap = cap * 8 > nfa->n * 4 ? cap * 8 : nfa->n * 4;
+    d->trans = (int *)malloc((size_t)cap * d->nsym * sizeof(int));
+    d->set_off = (int *)malloc(cap * sizeof(int));
+    d->set_len = (int *)malloc(cap * sizeof(int));
+    d->accept = (unsigned char *)malloc(cap);
+    d->pool = (int *)malloc((size_t)d->pool_cap * sizeof(int));
+    d->table = (int *)malloc((size_t)tcap * sizeof(int));
+    d->scratch[0] = (int *)malloc(nfa->n * sizeof(int));
+    d->scratch[1] = (int *)malloc(nfa->n * sizeof(int));
+    d->mark = (int *)calloc(nfa->n, sizeof(int));
+    d->stack = (int *)malloc((size_t)nfa->n * 4 * sizeof(int));
+    d->tmp = (int *)malloc(nfa->n * sizeof(int));
+    if (!d->trans || !d->set_off || !d->set_len || !d->accept || !d->pool || !d->table ||
+        !d->scratch[0] || !d->scratch[1] || !d->mark || !d->stack || !d->tmp)
+        return 0;
+    /* Scratch slots never cache transitions */
+    memset(d->trans, 0xFF, (size_t)DFA_SCRATCH * d->nsym * sizeof(int));
+    dfa_reset(d);
+    d->init = anchored ? dfa_insert(d, nfa->start_set, nfa->start_len) : dfa_insert(d, NULL, 0);
+    return d->init >= 0;
+}
+
+static void dfa_free(RxDfa *d) {
+    free(d->trans); free(d->set_off); free(d->set_len); free(d->accept);
+    free(d->pool); free(d->table);
+    free(d->scratch[0]); free(d->scratch[1]);
+    free(d->mark); free(d->stack); free(d->tmp);
+}
+
+static const int *dfa_set(const RxDfa *d, int id, int *n) {
+    if (id < DFA_SCRATCH) { *n = d->scratch_len[id]; return d->scratch[id]; }
+    *n = d->set_len[id];
+    return d->pool + d->set_off[id];
+}
+
+static int dfa_accepting(const RxDfa *d, int id) {
+    return id < DFA_SCRATCH ? d->scratch_acc[id] : d->accept[id];
+}
+
+static int dfa_dead(const RxDfa *d, int id) {
+    int n;
+    dfa_set(d, id, &n);
+    return d->anchored && n == 0;
+}
+
+static int consumes(const struct Regex *rx, const RxState *s, int sym) {
+    switch (s->op) {
+    case S_SET: return sym < rx->nclass && rx->setbits[(size_t)s->set * rx->nclass + sym];
+    case S_BOL: return sym == SYM_BOL(rx);
+    case S_EOL: return sym == SYM_EOL(rx);
+    default:    return 0;
+    }
+}
+
+static int dfa_compute(RxDfa *d, int from, int sym) {
+    const RxNfa *nfa = d->nfa;
+    int n_in, sp = 0;
+    const int *in = dfa_set(d, from, &n_in);
+
+    for (int pass = 0; pass < 2; pass++) {
+        const int *src = pass == 0 ? in : nfa->start_set;
+        int n = pass == 0 ? n_in : (d->anchored ? 0 : nfa->start_len);
+        for (int i = 0; i < n; i++) {
+            const RxState *s = &nfa->st[src[i]];
+            if (consumes(d->rx, s, sym)) d->stack[sp++] = s->out;
+        }
+    }
+    if (++d->mark_gen == 0) {
+        memset(d->mark, 0, nfa->n * sizeof(int));
+        d->mark_gen = 1;
+    }
+    int n = closure(nfa, d->stack, sp, d->mark, d->mark_gen, d->tmp, 0);
+    if (sym >= d->rx->nclass) {
+        /* Anchors are zero-width: ^^ or $$ must all match at one spot */
+        for (int done = 0; done < n; ) {
+            int end = n;
+            sp = 0;
+            for (int i = done; i < end; i++) {
+                const RxState *s = &nfa->st[d->tmp[i]];
+                if (consumes(d->rx, s, sym)) d->stack[sp++] = s->out;
+            }
+            n = closure(nfa, d->stack, sp, d->mark, d->mark_gen, d->tmp, n);
+            done = end;
+        }
+    }
+    qsort(d->tmp, n, sizeof(int), cmp_int);
+
+    int to = dfa_find(d, d->tmp, n);
+    if (to < 0 && !d->frozen) {
+        to = dfa_insert(d, d->tmp, n);
+        if (to < 0) {
+            /* Cache full: start over, or freeze it and simulate the NFA
+             * for anything not already cached */
+            if (++d->flushes > RX_MAX_FLUSHES) {
+                d->frozen = 1;
+            } else {
+                dfa_reset(d);
+                d->init = d->anchored ? dfa_insert(d, nfa->start_set, nfa->start_len)
+                                      : dfa_insert(d, NULL, 0);
+                return dfa_insert(d, d->tmp, n);
+            }
+        }
+    }
+    if (to < 0) {
+        to = (from == 0) ? 1 : 0;
+        memcpy(d->scratch[to], d->tmp, n * sizeof(int));
+        d->scratch_len[to] = n;
+        d->scratch_acc[to] = (unsigned char)has_match(nfa, d->tmp, n);
+        return to;
+    }
+    if (from >= DFA_SCRATCH) d->trans[(size_t)from * d->nsym + sym] = to;
+    return to;
+}
+
+static int dfa_step(RxDfa *d, int s, int sym) {
+    int t = d->trans[(size_t)s * d->nsym + sym];
+    return t >= 0 ? t : dfa_compute(d, s, sym);
+}
+
+/* ═══════════════════════════════════════════════════════════════
+ * COMPILE
+ * ═══════════════════════════════════════════════════════════════ */
+
+static void extract_prefix(Regex *rx, const RxParser *ps, int root) {
+    /* Flatten the leading concatenation chain (left-leaning) */
+    int chain[RX_MAX_PREFIX + 1];
+    int n = 0, node = root;
+    int stack[RX_MAX_DEPTH];
+    int sp = 0;
+    while (node >= 0 && sp < RX_MAX_DEPTH) {
+        const RxNode *nd = &ps->nodes[node];
+        if (nd->type == N_CAT) { stack[sp++] = nd->b; node = nd->a; continue; }
+        if (nd->type == N_SET && n < RX_MAX_PREFIX) {
+            chain[n++] = node;
+            node = sp > 0 ? stack[--sp] : -1;
+            continue;
+        }
+        if (nd->type == N_BOL && n == 0) rx->bol_anchored = 1;
+        break;
+    }
+    if (rx->bol_anchored) return;
+    for (int i = 0; i < n; i++) {
+        const RxSet *set = &ps->sets[ps->nodes[chain[i]].a];
+        const RxRange *r = &ps->ranges[set->first];
+        if (set->negate || set->count != 1 || r->lo != r->hi) break;
+        rx->prefix[rx->prefix_len++] = ps->nodes[chain[i]].a;
+    }
+}
+
+Regex *rx_compile(const wchar_t *pattern, const char **err) {
+    RxParser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = pattern;
+    Regex *rx = (Regex *)calloc(1, sizeof(Regex));
+    if (!rx) { if (err) *err = "out of memory"; return NULL; }
+
+    int root = parse_alt(&ps);
+    if (!ps.err && *ps.p == L')') ps.err = "unbalanced )";
+    if (!ps.err && root < 0) ps.err = "empty pattern";
+    if (!ps.err && !build_classes(rx, &ps)) ps.err = "out of memory";
+    if (!ps.err && (!nfa_compile(&rx->fwd, ps.nodes, root, 0) ||
+                    !nfa_compile(&rx->rev, ps.nodes, root, 1)))
+        ps.err = "out of memory";
+    if (!ps.err && (!dfa_init(&rx->dfwd, rx, &rx->fwd, 1) ||
+                    !dfa_init(&rx->drev, rx, &rx->rev, 0)))
+        ps.err = "out of memory";
+    if (!ps.err) extract_prefix(rx, &ps, root);
+
+    free(ps.nodes);
+    free(ps.sets);
+    free(ps.ranges);
+    if (ps.err) {
+        if (err) *err = ps.err;
+        rx_free(rx);
+        return NULL;
+    }
+    return rx;
+}
+
+void rx_free(Regex *rx) {
+    if (!rx) return;
+    dfa_free(&rx->dfwd);
+    dfa_free(&rx->drev);
+    free(rx->fwd.st); free(rx->fwd.start_set);
+    free(rx->rev.st); free(rx->rev.start_set);
+    free(rx->cmap);
+    free(rx->setbits);
+    free(rx);
+}
+
+/* ═══════════════════════════════════════════════════════════════
+ * MATCHING
+ * ═══════════════════════════════════════════════════════════════ */
+
+/* End of the longest non-empty match starting at pos, or -1. With
+ * at_bol the match must begin by consuming the line-start marker. */
+static ptrdiff_t longest_at(Regex *rx, const wchar_t *text, ptrdiff_t len,
+                            ptrdiff_t pos, int at_bol) {
+    RxDfa *d = &rx->dfwd;
+    int s = d->init;
+    ptrdiff_t best = -1;
+    if (at_bol) {
+        s = dfa_step(d, s, SYM_BOL(rx));
+        if (dfa_dead(d, s)) return -1;
+    }
+    for (ptrdiff_t i = pos; ; i++) {
+        if (i >= len || text[i] == L'\n') {
+            s = dfa_step(d, s, SYM_EOL(rx));
+            if (i > pos && dfa_accepting(d, s)) best = i;
+            break;
+        }
+        s = dfa_step(d, s, RX_SYM(rx, text[i]));
+        if (dfa_dead(d, s)) break;
+        if (dfa_accepting(d, s)) best = i + 1;
+    }
+    return best;
+}
+
+static ptrdiff_t line_end(const wchar_t *text, ptrdiff_t len, ptrdiff_t pos) {
+    const wchar_t *nl = wmemchr(text + pos, L'\n', (size_t)(len - pos));
+    return nl ? nl - text : len;
+}
+
+typedef struct { ptrdiff_t *v; int n, cap; } StartList;
+
+/* Reports the matches starting in [ls, le), where le ends the line.
+ * at_bol says ls is the line's start; otherwise ^ cannot match there. */
+static int scan_line(Regex *rx, const wchar_t *text, ptrdiff_t len, ptrdiff_t ls, ptrdiff_t le,
+                     int at_bol, StartList *starts, RxMatchFn fn, void *ctx) {
+    ptrdiff_t next = ls;
+
+    if (rx->bol_anchored) {
+        ptrdiff_t e = at_bol ? longest_at(rx, text, len, ls, 1) : -1;
+        return e < 0 || fn(ctx, ls, e);
+    }
+
+    /* Reverse pass: collect every position where a match can start */
+    RxDfa *d = &rx->drev;
+    int s = dfa_step(d, d->init, SYM_EOL(rx));
+    starts->n = 0;
+    for (ptrdiff_t k = le - 1; k >= ls; k--) {
+        s = dfa_step(d, s, RX_SYM(rx, text[k]));
+        if (!dfa_accepting(d, s)) continue;
+        if (!grow((void **)&starts->v, &starts->cap, starts->n + 1, sizeof(ptrdiff_t))) return 0;
+        starts->v[starts->n++] = k;
+    }
+    int bol_start = 0;
+    if (at_bol) {
+        s = dfa_step(d, s, SYM_BOL(rx));
+        bol_start = dfa_accepting(d, s);
+    }
+
+    /* Forward pass: longest match from each start, left to right */
+    if (bol_start) {
+        ptrdiff_t e = longest_at(rx, text, len, ls, 1);
+        if (starts->n > 0 && starts->v[starts->n - 1] == ls) {
+            ptrdiff_t e2 = longest_at(rx, text, len, ls, 0);
+            if (e2 > e) e = e2;
+            starts->n--;
+        }
+        if (e >= 0) {
+            if (!fn(ctx, ls, e)) return 0;
+            next = e;
+        }
+    }
+    for (int i = starts->n - 1; i >= 0; i--) {
+        ptrdiff_t k = starts->v[i];
+        if (k < next) continue;
+        ptrdiff_t e = longest_at(rx, text, len, k, 0);
+        if (e < 0) continue;
+        if (!fn(ctx, k, e)) return 0;
+        next = e;
+    }
+    return 1;
+}
+
+ptrdiff_t rx_scan(Regex *rx, const wchar_t *text, ptrdiff_t len,
+                  ptrdiff_t from, ptrdiff_t to, RxMatchFn fn, void *ctx) {
+    if (to > len) to = len;
+    StartList starts = { NULL, 0, 0 };
+
+    if (rx->prefix_len > 0) {
+        /* Literal prefix: jump between occurrences of its first char */
+        const unsigned char *first = rx->setbits + (size_t)rx->prefix[0] * rx->nclass;
+        ptrdiff_t i = from, resume = to;
+        while (i < to) {
+            if (!first[RX_SYM(rx, text[i])]) { i++; continue; }
+            int k = 1;
+            while (k < rx->prefix_len && i + k < len &&
+                   rx->setbits[(size_t)rx->prefix[k] * rx->nclass + RX_SYM(rx, text[i + k])]) k++;
+            if (k < rx->prefix_len) { i++; continue; }
+            ptrdiff_t e = longest_at(rx, text, len, i, 0);
+            if (e < 0) {
+                /* The prefix held but the rest did not: finish the line
+                 * with starts that are known to match */
+                ptrdiff_t le = line_end(text, len, i);
+                if (!scan_line(rx, text, len, i, le, 0, &starts, fn, ctx)) {
+                    free(starts.v);
+                    return -1;
+                }
+                i = le < len ? le + 1 : len;
+                if (i > resume) resume = i;
+                continue;
+            }
+            if (!fn(ctx, i, e)) { free(starts.v); return -1; }
+            i = e;
+            if (e > resume) resume = e;
+        }
+        free(starts.v);
+        return resume;
+    }
+
+    ptrdiff_t ls = from;
+    while (ls < to) {
+        ptrdiff_t le = line_end(text, len, ls);
+        if (!scan_line(rx, text, len, ls, le, 1, &starts, fn, ctx)) { free(starts.v); return -1; }
+        ls = le + 1;
+        if (le >= len) break;
+    }
+    free(starts.v);
+    if (ls > len) ls = len;
+    return ls > to ? ls : to;
+}
@@ -0,0 +1,33 @@
+/*
+ * regex.h — Linear-time regular expressions for the find bar
+ * Portable C with no Win32 dependencies (see regex_bench.c).
+ *
+ * Supported syntax: literals, '.', [...] and [^...] classes with ranges,
+ * \d \w \s \D \W \S \t \n \r \xHH \uHHHH, groups ( ) and (?: ),
+ * alternation '|', quantifiers * + ? {m} {m,} {m,n}, and the line
+ * anchors ^ and $. \w and \s follow the Unicode tables in chartab.h;
+ * \d is ASCII. Matching is case-insensitive, never crosses a line
+ * break, and returns leftmost-longest non-empty matches.
+ */
+#ifndef PROSE_REGEX_H
+#define PROSE_REGEX_H
+
+#include <stddef.h>
+#include <wchar.h>
+
+typedef struct Regex Regex;
+
+/* Called once per match in ascending order; return 0 to stop the scan. */
+typedef int (*RxMatchFn)(void *ctx, ptrdiff_t start, ptrdiff_t end);
+
+/* Returns NULL on a malformed pattern and points *err at a message. */
+Regex *rx_compile(const wchar_t *pattern, const char **err);
+void   rx_free(Regex *rx);
+
+/* Report matches beginning in lines that start in [from, to). `from`
+ * must be 0 or follow a newline. Returns where the next call should
+ * resume (at or past `to`), or -1 if the callback stopped the scan. */
+ptrdiff_t rx_scan(Regex *rx, const wchar_t *text, ptrdiff_t len,
+                  ptrdiff_t from, ptrdiff_t to, RxMatchFn fn, void *ctx);
+
+#endif /* PROSE_REGEX_H */
@@ -0,0 +1,217 @@
+/*
+ * regex_bench.c — Native throughput check for regex.c
+ *
+ *   make bench            (uses HOSTCC, defaults to cc)
+ *   ./regex_bench [MB]
+ *
+ * Runs a pathological pattern suite — nested and ambiguous quantifiers
+ * that make backtracking engines exponential — over synthetic log text
+ * and runs of 'a'. Every pattern should report roughly the same MB/s;
+ * a blowup shows up as a row orders of magnitude slower than the rest.
+ * A short correctness table runs first, and a long-line table last:
+ * patterns whose candidate starts fail only at the end of the line,
+ * timed on one line at two lengths, where quadrupling the line should
+ * about quadruple the time.
+ */
+#include "regex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <locale.h>
+
+typedef struct { ptrdiff_t count, last_start, last_end; } Tally;
+
+static int tally(void *ctx, ptrdiff_t start, ptrdiff_t end) {
+    Tally *t = (Tally *)ctx;
+    t->count++;
+    t->last_start = start;
+    t->last_end = end;
+    return 1;
+}
+
+static ptrdiff_t count_all(Regex *rx, const wchar_t *text, ptrdiff_t len) {
+    Tally t = { 0, -1, -1 };
+    for (ptrdiff_t from = 0; from < len; )
+        from = rx_scan(rx, text, len, from, from + 256 * 1024, tally, &t);
+    return t.count;
+}
+
+/* ── Correctness ── */
+
+typedef struct { const wchar_t *pattern, *text; int count; int first_s, first_e; } Case;
+
+static const Case CASES[] = {
+    { L"abc",            L"xxABCxxabc",         2, 2, 5 },
+    { L"a|ab",           L"ab",                 1, 0, 2 },
+    { L"(a|ab)(c|bcd)",  L"abcd",               1, 0, 4 },
+    { L"^foo",           L"foo\nxfoo\nfoo",     2, 0, 3 },
+    { L"o$",             L"foo\nbar\nbo",       2, 2, 3 },
+    { L"\\d{3}-\\d{4}",  L"call 555-1234 now", 1, 5, 13 },
+    { L"[^a-c]+",        L"abcxyzabc",          1, 3, 6 },
+    { L"x*",             L"aaa",                0, -1, -1 },
+    { L"a.c",            L"a\nc abc",           1, 4, 7 },
+    { L"(?:ab)+",        L"ababab ab",          2, 0, 6 },
+    { L"\\w+@\\w+\\.com", L"mail bob@example.com", 1, 5, 20 },
+    { L"colou?r",        L"Color colour",       2, 0, 5 },
+    /* A failed prefix candidate hands the rest of its line on */
+    { L"ab+c",           L"abx abbc abc\nabc",  3, 4, 8 },
+    { L"a\\w*z",         L"aaa az\naz",         2, 4, 6 },
+};
+
+static int first_only(void *ctx, ptrdiff_t start, ptrdiff_t end) {
+    tally(ctx, start, end);
+    return 0;
+}
+
+static int run_cases(void) {
+    int n = (int)(sizeof(CASES) / sizeof(CASES[0]));
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        const Case *c = &CASES[i];
+        const char *err = NULL;
+        Regex *rx = rx_compile(c->pattern, &err);
+        if (!rx) { printf("  FAIL %ls: %s\n", c->pattern, err); failed++; continue; }
+        ptrdiff_t len = (ptrdiff_t)wcslen(c->text);
+        Tally all = { 0, -1, -1 }, first = { 0, -1, -1 };
+        rx_scan(rx, c->text, len, 0, len, tally, &all);
+        rx_scan(rx, c->text, len, 0, len, first_only, &first);
+        if (all.count != c->count || first.last_start != c->first_s || first.last_end != c->first_e) {
+            printf("  FAIL %ls on \"%ls\": %td matches, first [%td,%td)\n",
+                   c->pattern, c->text, all.count, first.last_start, first.last_end);
+            failed++;
+        }
+        rx_free(rx);
+    }
+    printf("correctness: %d/%d passed\n\n", n - failed, n);
+    return failed;
+}
+
+/* ── Throughput ── */
+
+static const wchar_t *SUITE[] = {
+    /* Baselines */
+    L"error",
+    L"timeout=\\d+ms",
+    L"^\\d{4}-\\d{2}-\\d{2} \\S+ WARN",
+    /* Classic catastrophic-backtracking shapes */
+    L"(a*)*b",
+    L"(a+)+b",
+    L"(a|a)*b",
+    L"(a|aa)*c",
+    L"(x+x+)+y",
+    L"(.*a){12}",
+    L"a{0,30}a{30}",
+    L"(\\w+\\s?)*$",
+    L".*.*.*=.*",
+    /* DFA state blowup: forces cache flushes and NFA fallback */
+    L"[ab]*a[ab]{16}z",
+};
+
+static wchar_t *make_text(ptrdiff_t len) {
+    static const wchar_t *words[] = {
+        L"request", L"user", L"session", L"cache", L"timeout=250ms", L"error", L"GET",
+        L"/api/v2/items", L"ok", L"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", L"key=value",
+    };
+    wchar_t *t = (wchar_t *)malloc((len + 1) * sizeof(wchar_t));
+    if (!t) return NULL;
+    unsigned seed = 12345;
+    ptrdiff_t i = 0;
+    int line = 0;
+    while (i < len) {
+        wchar_t head[64];
+        int n = swprintf(head, 64, L"2024-03-%02d 12:%02d:%02d.%03d WARN ",
+                         line % 28 + 1, line % 60, (line * 7) % 60, line % 1000);
+        for (int k = 0; k < n && i < len; k++) t[i++] = head[k];
+        int nw = 6 + line % 9;
+        for (int w = 0; w < nw && i < len; w++) {
+            seed = seed * 1103515245u + 12345u;
+            const wchar_t *wd = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+            for (; *wd && i < len; wd++) t[i++] = *wd;
+            if (i < len) t[i++] = L' ';
+        }
+        if (i < len) t[i++] = L'\n';
+        line++;
+    }
+    t[len] = 0;
+    return t;
+}
+
+/* ── Long lines ── */
+
+static const wchar_t *LONG_SUITE[] = {
+    L"a.*b",
+    L"aa*c",
+    L"a\\w*z",
+    L"(a|b)*c",
+    L"[^x]*y",
+};
+
+#define LONG_LINE   (64 * 1024)
+#define LONG_GROWTH 8.0           /* linear is ~4x, quadratic ~16x */
+
+/* Milliseconds per scan of the whole line, repeated until measurable */
+static double time_line(Regex *rx, const wchar_t *text, ptrdiff_t len) {
+    int reps = 0;
+    clock_t t0 = clock(), t;
+    do {
+        Tally tl = { 0, -1, -1 };
+        rx_scan(rx, text, len, 0, len, tally, &tl);
+        reps++;
+        t = clock();
+    } while (t - t0 < CLOCKS_PER_SEC / 20);
+    return (double)(t - t0) * 1000.0 / CLOCKS_PER_SEC / reps;
+}
+
+static int run_long_lines(void) {
+    ptrdiff_t big = 4 * LONG_LINE;
+    wchar_t *text = (wchar_t *)malloc((big + 1) * sizeof(wchar_t));
+    if (!text) { fprintf(stderr, "out of memory\n"); return 1; }
+    for (ptrdiff_t i = 0; i < big; i++) text[i] = L'a';
+    text[big] = 0;
+
+    int failed = 0;
+    printf("\n%-34s %10s %10s %9s\n", "one line of 'a'", "64K ms", "256K ms", "growth");
+    for (size_t i = 0; i < sizeof(LONG_SUITE) / sizeof(LONG_SUITE[0]); i++) {
+        const char *err = NULL;
+        Regex *rx = rx_compile(LONG_SUITE[i], &err);
+        if (!rx) { printf("%-34ls compile error: %s\n", LONG_SUITE[i], err); failed++; continue; }
+        double small_ms = time_line(rx, text, LONG_LINE);
+        double big_ms = time_line(rx, text, big);
+        double growth = small_ms > 0 ? big_ms / small_ms : 0.0;
+        int bad = growth > LONG_GROWTH;
+        printf("%-34ls %10.2f %10.2f %8.1fx%s\n", LONG_SUITE[i], small_ms, big_ms, growth,
+               bad ? "  SUPERLINEAR" : "");
+        failed += bad;
+        rx_free(rx);
+    }
+    free(text);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    setlocale(LC_CTYPE, "");
+    int mb = argc > 1 ? atoi(argv[1]) : 32;
+    if (mb <= 0) mb = 32;
+
+    int failed = run_cases();
+
+    ptrdiff_t len = (ptrdiff_t)mb * 1024 * 1024 / (ptrdiff_t)sizeof(wchar_t);
+    wchar_t *text = make_text(len);
+    if (!text) { fprintf(stderr, "out of memory\n"); return 1; }
+    printf("%-34s %10s %10s %9s\n", "pattern", "matches", "ms", "MB/s");
+
+    for (size_t i = 0; i < sizeof(SUITE) / sizeof(SUITE[0]); i++) {
+        const char *err = NULL;
+        clock_t t0 = clock();
+        Regex *rx = rx_compile(SUITE[i], &err);
+        if (!rx) { printf("%-34ls compile error: %s\n", SUITE[i], err); failed++; continue; }
+        ptrdiff_t n = count_all(rx, text, len);
+        double ms = (double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC;
+        printf("%-34ls %10td %10.1f %9.1f\n", SUITE[i], n, ms, ms > 0 ? mb / (ms / 1000.0) : 0.0);
+        rx_free(rx);
+    }
+    free(text);
+    failed += run_long_lines();
+    return failed ? 1 : 0;
+}
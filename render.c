@@ -109,7 +109,8 @@ void render_tabbar(HDC hdc) {
     for (int i = 0; i < g_editor.tab_count; i++) {
         Document *doc = g_editor.tabs[i];
         wchar_t label[128];
-        swprintf(label, 128, L"%ls%ls", doc->title, doc->modified ? L" \x2022" : L"");
+        swprintf(label, 128, L"%ls%ls", doc->title,
+                 doc->loading ? L" \x2026" : doc->modified ? L" \x2022" : L"");
         int tw = (int)wcslen(label) * DPI(8) + DPI(TAB_PAD) * 2;
         if (tw < DPI(TAB_MIN_W)) tw = DPI(TAB_MIN_W);
         if (tw > DPI(TAB_MAX_W)) tw = DPI(TAB_MAX_W);
@@ -122,6 +123,18 @@ void render_tabbar(HDC hdc) {
             draw_text(hdc, x + DPI(TAB_PAD), y + (tbh - DPI(12)) / 2, label, (int)wcslen(label), CLR_OVERLAY0);
         }
 
+        /* All-tabs search: hit count badge beside the close button */
+        if (g_editor.search.active && g_editor.search.all_tabs && doc->search_hits > 0) {
+            wchar_t hits[16];
+            swprintf(hits, 16, L"%d", doc->search_hits);
+            SIZE hs;
+            GetTextExtentPoint32W(hdc, hits, (int)wcslen(hits), &hs);
+            int bw = hs.cx + DPI(10);
+            int bx = x + tw - DPI(26) - bw;
+            fill_rounded_rect(hdc, bx, y + (tbh - DPI(16)) / 2, bw, DPI(16), DPI(8), CLR_SURFACE1);
+            draw_text(hdc, bx + DPI(5), y + (tbh - DPI(12)) / 2, hits, (int)wcslen(hits), CLR_ACCENT);
+        }
+
         draw_text(hdc, x + tw - DPI(20), y + (tbh - DPI(12)) / 2, L"\x00D7", 1, CLR_OVERLAY0);
 
         x += tw + DPI(4);
@@ -150,12 +163,36 @@ void render_statusbar(HDC hdc) {
     swprintf(left, 256, L"  %ls  \x2502  Ln %lld, Col %lld",
              doc->mode == MODE_PROSE ? L"\x270D Prose" : L"\x2699 Code",
              (long long)line, (long long)col);
+    if (doc->loading) {
+        int n = (int)wcslen(left);
+        swprintf(left + n, 256 - n, L"  \x2502  Loading\x2026");
+    }
+    if (doc->follow.on) {
+        int n = (int)wcslen(left);
+        swprintf(left + n, 256 - n, L"  \x2502  Following");
+    }
+    if (g_editor.search.active && g_editor.search.scanning) {
+        int n = (int)wcslen(left);
+        swprintf(left + n, 256 - n, L"  \x2502  %d+ matches, scanning\x2026", g_editor.search.match_count);
+    } else if (g_editor.search.active && g_editor.search.all_tabs && g_editor.search.query[0]) {
+        int tabs, pending;
+        int total = search_total_hits(&tabs, &pending);
+        int n = (int)wcslen(left);
+        swprintf(left + n, 256 - n, pending ? L"  \x2502  %d+ matches in %d tabs, scanning\x2026"
+                                            : L"  \x2502  %d matches in %d tabs", total, tabs);
+    }
     draw_text(hdc, DPI(8), y + (DPI(STATUSBAR_H) - DPI(12)) / 2, left, (int)wcslen(left), CLR_SUBTEXT);
 
     wchar_t right[256];
     int reading_time = (int)((doc->word_count + 237) / 238);
     if (doc->mode == MODE_PROSE) {
-        swprintf(right, 256, L"%lld words  \x2502  %lld chars  \x2502  ~%d min read  \x2502  %lld lines  ",
+        int n = 0;
+        if (g_spell_loaded && g_editor.spellcheck_enabled) {
+            n = doc->spell.ready ? swprintf(right, 256, L"%d misspelling%ls  \x2502  ",
+                                            doc->spell.count, doc->spell.count == 1 ? L"" : L"s")
+                                 : swprintf(right, 256, L"Checking spelling\x2026  \x2502  ");
+        }
+        swprintf(right + n, 256 - n, L"%lld words  \x2502  %lld chars  \x2502  ~%d min read  \x2502  %lld lines  ",
                  (long long)doc->word_count, (long long)doc->char_count, reading_time > 0 ? reading_time : 1, (long long)doc->line_count);
     } else {
         swprintf(right, 256, L"%lld lines  \x2502  %lld chars  ",
@@ -221,17 +258,29 @@ void render_searchbar(HDC hdc) {
     }
 
     if (!g_editor.search.replace_focused || !g_editor.search.replace_active) {
-        fill_rect(hdc, x + DPI(30), y + DPI(28), bar_w - DPI(130), 1, CLR_ACCENT);
+        fill_rect(hdc, x + DPI(30), y + DPI(28), bar_w - DPI(180), 1, CLR_ACCENT);
     }
 
+    /* All-tabs indicator (Ctrl+Shift+A) */
+    draw_text(hdc, x + bar_w - DPI(146), y + DPI(12), L"All", 3,
+              g_editor.search.all_tabs ? CLR_ACCENT : CLR_OVERLAY0);
+
+    /* Regex mode indicator (Ctrl+R) */
+    draw_text(hdc, x + bar_w - DPI(114), y + DPI(12), L".*", 2,
+              g_editor.search.regex ? CLR_ACCENT : CLR_OVERLAY0);
+
     wchar_t mc[32];
-    if (g_editor.search.match_count > 0) {
-        swprintf(mc, 32, L"%d/%d", g_editor.search.current_match + 1, g_editor.search.match_count);
+    int scanning = g_editor.search.scanning;
+    if (g_editor.search.query_invalid) {
+        wcscpy(mc, L"Bad pattern");
+    } else if (g_editor.search.match_count > 0) {
+        swprintf(mc, 32, scanning ? L"%d/%d+" : L"%d/%d",
+                 g_editor.search.current_match + 1, g_editor.search.match_count);
     } else {
-        wcscpy(mc, L"No results");
+        wcscpy(mc, scanning ? L"Scanning\x2026" : L"No results");
     }
     draw_text(hdc, x + bar_w - DPI(90), y + DPI(12), mc, (int)wcslen(mc),
-              g_editor.search.match_count > 0 ? CLR_SUBTEXT : CLR_RED);
+              (g_editor.search.match_count > 0 || scanning) ? CLR_SUBTEXT : CLR_RED);
 
     /* Close (X) button */
     {
@@ -316,11 +365,10 @@ void render_editor(HDC hdc) {
     if (g_editor.search.active && g_editor.search.match_count > 0) {
         bpos first_pos = use_wrap ? doc->wc.entries[first_vline].pos
                                   : lc_line_start(&doc->lc, first_vline);
-        int qlen = (int)wcslen(g_editor.search.query);
         int lo = 0, hi = g_editor.search.match_count - 1;
         while (lo < hi) {
             int mid = (lo + hi) / 2;
-            if (g_editor.search.match_positions[mid] + qlen <= first_pos) lo = mid + 1;
+            if (g_editor.search.match_positions[mid] + g_editor.search.match_lengths[mid] <= first_pos) lo = mid + 1;
             else hi = mid;
         }
         match_cursor = lo;
@@ -496,12 +544,11 @@ void render_editor(HDC hdc) {
         }
 
         if (g_editor.search.active && g_editor.search.match_count > 0) {
-            int qlen = (int)wcslen(g_editor.search.query);
             bpos line_end_pos = ls + safe_len;
             for (int m = match_cursor; m < g_editor.search.match_count; m++) {
                 bpos ms = g_editor.search.match_positions[m];
                 if (ms >= line_end_pos) break;
-                bpos me = ms + qlen;
+                bpos me = ms + g_editor.search.match_lengths[m];
                 if (me <= ls) { match_cursor = m + 1; continue; }
                 int hs = (int)((ms > ls) ? ms - ls : 0);
                 int he = (int)((me < line_end_pos) ? me - ls : safe_len);
@@ -588,32 +635,20 @@ void render_editor(HDC hdc) {
         }
 
         if (spell_pen && !dim_this_line) {
+            /* Squiggles come from the background checker's list */
             HPEN old_spell_pen = (HPEN)SelectObject(hdc, spell_pen);
-            int ws = -1;
-            for (int i = 0; i <= safe_len; i++) {
-                wchar_t c = (i < safe_len) ? line_chars[i] : L' ';
-                if (iswalpha(c) || c == L'\'') {
-                    if (ws < 0) ws = i;
-                } else {
-                    if (ws >= 0) {
-                        int wl = i - ws;
-                        wchar_t word[64];
-                        if (wl < 64) {
-                            for (int j = 0; j < wl; j++)
-                                word[j] = line_chars[ws + j];
-                            word[wl] = 0;
-                            if (!spell_check(word, wl)) {
-                                int ux = text_x + ((ws < safe_len) ? x_positions[ws] : x_positions[safe_len]);
-                                int ux_end = text_x + ((i < safe_len) ? x_positions[i] : x_positions[safe_len]);
-                                int uy = y + lh - 3;
-                                MoveToEx(hdc, ux, uy, NULL);
-                                for (int px = ux; px < ux_end; px += 4) {
-                                    LineTo(hdc, px + 2, uy + (((px - ux) / 4) % 2 ? 2 : 0));
-                                }
-                            }
-                        }
-                        ws = -1;
-                    }
+            SpellMarks *sm = &doc->spell;
+            bpos line_end_pos = ls + safe_len;
+            for (int k = spell_marks_lower_bound(sm, ls); k < sm->count && sm->pos[k] < line_end_pos; k++) {
+                int ws = (int)(sm->pos[k] - ls);
+                bpos we = sm->pos[k] + sm->len[k];
+                int wend = (int)(we < line_end_pos ? we - ls : safe_len);
+                int ux = text_x + x_positions[ws];
+                int ux_end = text_x + x_positions[wend];
+                int uy = y + lh - 3;
+                MoveToEx(hdc, ux, uy, NULL);
+                for (int px = ux; px < ux_end; px += 4) {
+                    LineTo(hdc, px + 2, uy + (((px - ux) / 4) % 2 ? 2 : 0));
                 }
             }
             SelectObject(hdc, old_spell_pen);
@@ -787,7 +822,7 @@ void render_stats_screen(HDC hdc) {
 
     fill_rect(hdc, 0, 0, cw, ch, g_theme.is_dark ? RGB(14, 14, 20) : RGB(240, 240, 245));
 
-    int pw = DPI(480), ph = DPI(420);
+    int pw = DPI(480), ph = DPI(664);
     if (pw > cw - DPI(40)) pw = cw - DPI(40);
     if (ph > ch - DPI(40)) ph = ch - DPI(40);
     int px = (cw - pw) / 2;
@@ -828,16 +863,21 @@ void render_stats_screen(HDC hdc) {
     bpos total_lines_added = 0;
     bpos total_words_now = 0;
     bpos total_chars_now = 0;
+    bpos total_paras = 0, total_sentences = 0;
+    bpos total_prose_words = 0, total_syllables = 0;
 
     for (int i = 0; i < g_editor.tab_count; i++) {
         Document *d = g_editor.tabs[i];
-        d->stats_dirty = 1;
-        update_stats_now(d);
         total_words_added += (d->word_count - d->session_start_words);
         total_chars_added += (d->char_count - d->session_start_chars);
         total_lines_added += (d->line_count - d->session_start_lines);
         total_words_now += d->word_count;
         total_chars_now += d->char_count;
+        if (d->is_results || d->analytics.off) continue;
+        total_paras += d->analytics.count;
+        total_sentences += d->analytics.sentences;
+        total_prose_words += d->analytics.words;
+        total_syllables += d->analytics.syllables;
     }
 
     {
@@ -902,6 +942,39 @@ void render_stats_screen(HDC hdc) {
         SIZE sz; GetTextExtentPoint32W(hdc, buf, (int)wcslen(buf), &sz);
         draw_text(hdc, right_col - sz.cx, y, buf, (int)wcslen(buf), CLR_TEXT);
     }
+    y += DPI(28);
+
+    /* Words per minute over the last half hour, one bar a minute */
+    {
+        enum { BARS = 30 };
+        int per_min[BARS];
+        analytics_timeline(per_min, BARS, 60000);
+        int peak = 1, recent = 0;
+        for (int i = 0; i < BARS; i++) {
+            if (per_min[i] > peak) peak = per_min[i];
+            if (i >= BARS - 5) recent += per_min[i];
+        }
+        wchar_t buf[64];
+        swprintf(buf, 64, L"%.1f wpm", recent > 0 ? recent / 5.0 : 0.0);
+        draw_text(hdc, left_margin, y, L"Last 5 Minutes", 14, CLR_SUBTEXT);
+        SIZE sz; GetTextExtentPoint32W(hdc, buf, (int)wcslen(buf), &sz);
+        draw_text(hdc, right_col - sz.cx, y, buf, (int)wcslen(buf), CLR_TEXT);
+        y += DPI(24);
+
+        int chart_h = DPI(40);
+        int slot = (right_col - left_margin) / BARS;
+        int bar_w = slot > 2 ? slot - DPI(2) : 1;
+        if (bar_w < 1) bar_w = 1;
+        fill_rect(hdc, left_margin, y + chart_h, right_col - left_margin, 1, CLR_SURFACE0);
+        for (int i = 0; i < BARS; i++) {
+            if (per_min[i] <= 0) continue;
+            int h = (int)((long long)per_min[i] * chart_h / peak);
+            if (h < DPI(2)) h = DPI(2);
+            fill_rect(hdc, left_margin + i * slot, y + chart_h - h, bar_w, h,
+                      i >= BARS - 5 ? CLR_ACCENT : CLR_SURFACE1);
+        }
+        y += chart_h;
+    }
     y += DPI(16);
 
     fill_rect(hdc, left_margin, y, pw - DPI(64), 1, CLR_SURFACE0);
@@ -930,6 +1003,47 @@ void render_stats_screen(HDC hdc) {
     }
     y += DPI(24);
 
+    {
+        wchar_t buf[64];
+        swprintf(buf, 64, L"%lld", (long long)total_paras);
+        draw_text(hdc, left_margin, y, L"Paragraphs", 10, CLR_SUBTEXT);
+        SIZE sz; GetTextExtentPoint32W(hdc, buf, (int)wcslen(buf), &sz);
+        draw_text(hdc, right_col - sz.cx, y, buf, (int)wcslen(buf), CLR_TEXT);
+    }
+    y += DPI(24);
+
+    {
+        wchar_t buf[64];
+        swprintf(buf, 64, L"%lld", (long long)total_sentences);
+        draw_text(hdc, left_margin, y, L"Sentences", 9, CLR_SUBTEXT);
+        SIZE sz; GetTextExtentPoint32W(hdc, buf, (int)wcslen(buf), &sz);
+        draw_text(hdc, right_col - sz.cx, y, buf, (int)wcslen(buf), CLR_TEXT);
+    }
+    y += DPI(24);
+
+    {
+        wchar_t buf[64];
+        swprintf(buf, 64, L"%.1f words", total_sentences > 0
+                 ? (double)total_prose_words / (double)total_sentences : 0.0);
+        draw_text(hdc, left_margin, y, L"Avg Sentence", 12, CLR_SUBTEXT);
+        SIZE sz; GetTextExtentPoint32W(hdc, buf, (int)wcslen(buf), &sz);
+        draw_text(hdc, right_col - sz.cx, y, buf, (int)wcslen(buf), CLR_TEXT);
+    }
+    y += DPI(24);
+
+    {
+        double ease = analytics_reading_ease(total_prose_words, total_sentences, total_syllables);
+        const wchar_t *grade = ease >= 80 ? L"easy" : ease >= 60 ? L"plain"
+                             : ease >= 30 ? L"difficult" : L"very difficult";
+        wchar_t buf[64];
+        if (total_sentences > 0) swprintf(buf, 64, L"%.0f (%ls)", ease, grade);
+        else safe_wcscpy(buf, 64, L"\x2014");
+        draw_text(hdc, left_margin, y, L"Reading Ease", 12, CLR_SUBTEXT);
+        SIZE sz; GetTextExtentPoint32W(hdc, buf, (int)wcslen(buf), &sz);
+        draw_text(hdc, right_col - sz.cx, y, buf, (int)wcslen(buf), CLR_TEXT);
+    }
+    y += DPI(24);
+
     {
         wchar_t buf[64];
         swprintf(buf, 64, L"%d", g_editor.tab_count);
@@ -937,6 +1051,19 @@ void render_stats_screen(HDC hdc) {
         SIZE sz; GetTextExtentPoint32W(hdc, buf, (int)wcslen(buf), &sz);
         draw_text(hdc, right_col - sz.cx, y, buf, (int)wcslen(buf), CLR_TEXT);
     }
+    y += DPI(24);
+
+    {
+        SpellCacheStats sc;
+        spell_cache_stats(&sc);
+        unsigned long long lookups = sc.hits + sc.misses;
+        wchar_t buf[64];
+        swprintf(buf, 64, L"%.1f%% hits, %llu evicted",
+                 lookups ? 100.0 * (double)sc.hits / (double)lookups : 0.0, sc.evictions);
+        draw_text(hdc, left_margin, y, L"Spell Cache", 11, CLR_SUBTEXT);
+        SIZE sz; GetTextExtentPoint32W(hdc, buf, (int)wcslen(buf), &sz);
+        draw_text(hdc, right_col - sz.cx, y, buf, (int)wcslen(buf), CLR_TEXT);
+    }
     y += DPI(32);
 
     SelectObject(hdc, g_editor.font_ui_small);
@@ -1028,16 +1155,55 @@ void render_menu_dropdown(HDC hdc) {
     }
 }
 
+void render_suggest_popup(HDC hdc) {
+    SuggestState *st = &g_editor.suggest;
+    if (!st->open) return;
+
+    RECT r;
+    spell_suggest_rect(&r);
+    int x = r.left, y = r.top, w = r.right - r.left, h = r.bottom - r.top;
+    int item_h = DPI(26);
+    int pad_x = DPI(12);
+
+    fill_rounded_rect(hdc, x + DPI(2), y + DPI(2), w, h, DPI(8), RGB(0, 0, 0));
+    fill_rounded_rect(hdc, x, y, w, h, DPI(8),
+                      g_theme.is_dark ? RGB(34, 34, 42) : RGB(248, 248, 248));
+    HPEN pen = CreatePen(PS_SOLID, 1, CLR_SURFACE1);
+    HBRUSH hollow = (HBRUSH)GetStockObject(HOLLOW_BRUSH);
+    HPEN old_pen = (HPEN)SelectObject(hdc, pen);
+    HBRUSH old_br = (HBRUSH)SelectObject(hdc, hollow);
+    RoundRect(hdc, x, y, x + w, y + h, DPI(8), DPI(8));
+    SelectObject(hdc, old_pen);
+    SelectObject(hdc, old_br);
+    DeleteObject(pen);
+
+    SelectObject(hdc, g_editor.font_ui_small);
+    SetBkMode(hdc, TRANSPARENT);
+
+    int cy = y + DPI(4);
+    if (st->count == 0) {
+        draw_text(hdc, x + pad_x, cy + (item_h - DPI(12)) / 2, L"No suggestions", 14, CLR_OVERLAY0);
+        return;
+    }
+    for (int i = 0; i < st->count; i++) {
+        COLORREF clr = CLR_TEXT;
+        if (st->hover == i) {
+            fill_rounded_rect(hdc, x + DPI(4), cy, w - DPI(8), item_h, DPI(4), CLR_ACCENT);
+            clr = RGB(255, 255, 255);
+        }
+        draw_text(hdc, x + pad_x, cy + (item_h - DPI(12)) / 2,
+                  st->words[i], (int)wcslen(st->words[i]), clr);
+        cy += item_h;
+    }
+}
+
 void render(HDC hdc) {
     arena_reset(&g_frame_arena);
 
-    Document *stats_doc = current_doc();
-    if (stats_doc) update_stats_now(stats_doc);
-
     int scroll_only = g_editor.scroll_only_repaint;
     g_editor.scroll_only_repaint = 0;
 
-    if (scroll_only && g_editor.menu_open < 0 && !g_editor.show_stats_screen) {
+    if (scroll_only && g_editor.menu_open < 0 && !g_editor.suggest.open && !g_editor.show_stats_screen) {
         render_editor(hdc);
         render_statusbar(hdc);
         render_searchbar(hdc);
@@ -1051,5 +1217,6 @@ void render(HDC hdc) {
         render_searchbar(hdc);
         render_stats_screen(hdc);
         render_menu_dropdown(hdc);
+        render_suggest_popup(hdc);
     }
 }
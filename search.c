@@ -1,153 +1,838 @@
 #include "prose_code.h"
 
-void search_update_matches(void) {
-    SearchState *ss = &g_editor.search;
-    Document *doc = current_doc();
-    if (!doc || ss->query[0] == 0) {
-        ss->match_count = 0;
-        return;
+/* ── Background search ──
+ * Each query change bumps g_search_gen and queues a worker on a snapshot
+ * of the document. The worker scans from the top of the viewport to the
+ * end, then wraps around to the start, posting sorted batches of match
+ * positions back to the window. Stale workers notice the generation
+ * change at the next chunk boundary and exit. In regex mode each worker
+ * compiles its own Regex, since the lazy DFA cache is not shared.
+ *
+ * In all-tabs mode every other open document also gets a full scan on
+ * the pool (guarded by g_tabs_gen) that reports its hit count. A
+ * hibernated tab has to be read from disk for that, so its scan waits
+ * until the query has been still for SEARCH_SETTLE_MS (TIMER_SEARCH_SETTLE)
+ * rather than running on every keystroke.
+ *
+ * Once a scan completes, the match list is maintained through the gap
+ * buffer edit hook: matches after an edit shift, and only the lines the
+ * edit touched are searched again. Matches never span a line break, so
+ * no other line can gain or lose one.
+ *
+ * Literal scans of large documents are limited to the candidate ranges
+ * from the document's trigram index (trigram.c) once it is built. */
+
+typedef struct {
+    bpos *pos;
+    int  *len;
+    int count;
+    int cap;
+    int count_only;
+} MatchList;
+
+typedef struct {
+    int regex;
+    wchar_t text[256];  /* case-folded in literal mode */
+    int len;
+} SearchQuery;
+
+typedef struct {
+    DocSnapshot *snap;
+    Document *doc;
+    LONG gen;
+    SearchQuery q;
+    bpos first;
+    bpos *ranges;   /* [from, to) pairs to scan */
+    int nranges;
+} SearchJob;
+
+typedef struct {
+    Document *doc;
+    LONG gen;
+    int done;
+    int count;
+    bpos *pos;
+    int  *len;
+} SearchBatch;
+
+/* Full scan of one tab, either for its hit count (posted back) or for
+ * Replace All across tabs (collected with a PoolGroup). A hibernated tab
+ * has no text in memory, so the worker reads its file instead. */
+typedef struct {
+    DocSnapshot *snap;
+    wchar_t path[MAX_PATH];  /* hibernated tab's file, when snap is NULL */
+    Document *doc;
+    unsigned int doc_id;
+    LONG gen;
+    int post;
+    int ok;
+    SearchQuery q;
+    bpos *ranges;
+    int nranges;
+    MatchList found;
+} TabScan;
+
+#define SEARCH_SETTLE_MS 400
+
+static volatile LONG g_search_gen;
+static volatile LONG g_tabs_gen;
+
+static Regex *g_edit_rx;   /* UI-thread copy for re-verifying edited lines */
+static int g_bulk_edit;    /* set while Replace All edits a buffer */
+
+static int ml_push(MatchList *ml, bpos pos, int len) {
+    if (ml->count_only) { ml->count++; return 1; }
+    if (ml->count >= ml->cap) {
+        int ncap = ml->cap ? ml->cap * 2 : 256;
+        bpos *p = (bpos *)realloc(ml->pos, ncap * sizeof(bpos));
+        if (!p) return 0;
+        ml->pos = p;
+        int *l = (int *)realloc(ml->len, ncap * sizeof(int));
+        if (!l) return 0;
+        ml->len = l;
+        ml->cap = ncap;
+    }
+    ml->pos[ml->count] = pos;
+    ml->len[ml->count] = len;
+    ml->count++;
+    return 1;
+}
+
+static void ml_free(MatchList *ml) {
+    free(ml->pos);
+    free(ml->len);
+}
+
+static int ml_push_match(void *ctx, ptrdiff_t start, ptrdiff_t end) {
+    return ml_push((MatchList *)ctx, start, (int)(end - start));
+}
+
+/* Report literal matches of the folded query `lq` starting in [from, to).
+ * The text is folded a block at a time (plus qlen - 1 units of overlap)
+ * so the inner loop is a plain wmemchr/wmemcmp over folded units.
+ * Returns 0 if the callback stopped the scan. */
+int search_literal(const wchar_t *text, bpos len, const wchar_t *lq, int qlen,
+                   bpos from, bpos to, RxMatchFn fn, void *ctx) {
+    wchar_t folded[FOLD_BLOCK + 256];
+    if (to > len - qlen + 1) to = len - qlen + 1;
+    for (bpos base = from; base < to; base += FOLD_BLOCK) {
+        bpos n = to - base < FOLD_BLOCK ? to - base : FOLD_BLOCK;
+        ch_fold_run(text + base, folded, n + qlen - 1);
+        for (bpos i = 0; i < n; i++) {
+            const wchar_t *hit = wmemchr(folded + i, lq[0], n - i);
+            if (!hit) break;
+            i = hit - folded;
+            if (qlen > 1 && wmemcmp(hit + 1, lq + 1, qlen - 1) != 0) continue;
+            if (!fn(ctx, base + i, base + i + qlen)) return 0;
+        }
+    }
+    return 1;
+}
+
+/* Scan [from, to) in literal or regex mode. Returns where the next
+ * chunk should start, or -1 on failure. */
+static bpos scan_chunk(Regex *rx, const SearchQuery *q, const wchar_t *text, bpos len,
+                       bpos from, bpos to, MatchList *out) {
+    if (rx) return rx_scan(rx, text, len, from, to, ml_push_match, out);
+    return search_literal(text, len, q->text, q->len, from, to, ml_push_match, out) ? to : -1;
+}
+
+static void post_batch(SearchJob *job, MatchList *ml, int done) {
+    SearchBatch *b = (SearchBatch *)calloc(1, sizeof(SearchBatch));
+    if (!b) return;
+    b->doc = job->doc;
+    b->gen = job->gen;
+    b->done = done;
+    b->count = ml->count;
+    b->pos = ml->pos;
+    b->len = ml->len;
+    ml->pos = NULL;
+    ml->len = NULL;
+    ml->count = ml->cap = 0;
+    if (!PostMessageW(g_editor.hwnd, WM_SEARCH_RESULTS, 0, (LPARAM)b)) {
+        free(b->pos);
+        free(b->len);
+        free(b);
+    }
+}
+
+static void search_worker(void *param) {
+    SearchJob *job = (SearchJob *)param;
+    const wchar_t *text = job->snap->text;
+    bpos len = job->snap->len;
+    MatchList found = { 0 };
+    Regex *rx = NULL;
+
+    bpos first = job->first;
+    if (job->q.regex) {
+        rx = rx_compile(job->q.text, NULL);
+        if (!rx) goto cancelled;
+        /* Regex scans whole lines, so start at a line boundary */
+        while (first > 0 && text[first - 1] != L'\n') first--;
+    }
+
+    /* Two passes: viewport → end, then start → viewport */
+    bpos passes[2][2] = { { first, len }, { 0, first } };
+    for (int p = 0; p < 2; p++) {
+        for (int r = 0; r < job->nranges; r++) {
+            bpos from = job->ranges[2 * r], end = job->ranges[2 * r + 1];
+            if (from < passes[p][0]) from = passes[p][0];
+            if (end > passes[p][1]) end = passes[p][1];
+            while (from < end) {
+                if (g_search_gen != job->gen) goto cancelled;
+                bpos to = from + SEARCH_CHUNK;
+                if (to > end) to = end;
+                from = scan_chunk(rx, &job->q, text, len, from, to, &found);
+                if (from < 0) goto cancelled;
+                if (found.count > 0) post_batch(job, &found, 0);
+            }
+        }
+    }
+    post_batch(job, &found, 1);
+
+cancelled:
+    rx_free(rx);
+    ml_free(&found);
+    snapshot_release(job->snap);
+    free(job->ranges);
+    free(job);
+}
+
+static void tab_scan_worker(void *param) {
+    TabScan *job = (TabScan *)param;
+    wchar_t *file_text = NULL;
+    const wchar_t *text;
+    bpos len, bytes;
+    Regex *rx = NULL;
+
+    if (job->snap) {
+        text = job->snap->text;
+        len = job->snap->len;
+    } else {
+        if (!(file_text = read_text_file(job->path, &len, &bytes))) goto out;
+        text = file_text;
+        job->ranges[1] = len;
+    }
+    if (job->q.regex && !(rx = rx_compile(job->q.text, NULL))) goto out;
+    for (int r = 0; r < job->nranges; r++) {
+        bpos end = job->ranges[2 * r + 1];
+        for (bpos from = job->ranges[2 * r]; from < end; ) {
+            if (job->post && g_tabs_gen != job->gen) goto out;
+            bpos to = from + SEARCH_CHUNK;
+            if (to > end) to = end;
+            from = scan_chunk(rx, &job->q, text, len, from, to, &job->found);
+            if (from < 0) goto out;
+        }
+    }
+    job->ok = 1;
+
+out:
+    rx_free(rx);
+    free(file_text);
+    snapshot_release(job->snap);
+    job->snap = NULL;
+    free(job->ranges);
+    job->ranges = NULL;
+    if (job->post && !PostMessageW(g_editor.hwnd, WM_SEARCH_TAB_HITS, 0, (LPARAM)job)) {
+        ml_free(&job->found);
+        free(job);
+    }
+}
+
+/* Ranges of `doc` worth scanning for q: the trigram index's candidates
+ * when it can answer, otherwise the whole text. Call right after taking
+ * the snapshot, so both describe the same text. */
+static int plan_ranges(Document *doc, const SearchQuery *q, bpos len, bpos **out) {
+    *out = NULL;
+    if (!q->regex) {
+        int n = tri_candidates(doc, q->text, q->len, out);
+        if (n >= 0) return n;
+        if (q->len >= 3) tri_request(doc);
+    }
+    *out = (bpos *)malloc(2 * sizeof(bpos));
+    if (!*out) return -1;
+    (*out)[0] = 0;
+    (*out)[1] = len;
+    return 1;
+}
+
+/* A tab still loading has no settled text to scan yet; its count stays
+ * pending until the load finishes and the search runs again. */
+static TabScan *tab_scan_new(Document *doc, const SearchQuery *q, int post) {
+    if (doc->loading) return NULL;
+    TabScan *job = (TabScan *)calloc(1, sizeof(TabScan));
+    if (!job) return NULL;
+    if (doc->hibernated) {
+        /* The whole file; the worker fills in its length */
+        safe_wcscpy(job->path, MAX_PATH, doc->filepath);
+        job->ranges = (bpos *)calloc(2, sizeof(bpos));
+        job->nranges = job->ranges ? 1 : -1;
+    } else {
+        job->snap = doc_snapshot(doc);
+        if (!job->snap) { free(job); return NULL; }
+        job->nranges = plan_ranges(doc, q, job->snap->len, &job->ranges);
     }
+    if (job->nranges < 0) {
+        snapshot_release(job->snap);
+        free(job);
+        return NULL;
+    }
+    job->doc = doc;
+    job->doc_id = doc->autosave_id;
+    job->gen = g_tabs_gen;
+    job->post = post;
+    job->q = *q;
+    job->found.count_only = post;
+    return job;
+}
+
+static void fold_query(const wchar_t *query, wchar_t *out, int qlen) {
+    ch_fold_run(query, out, qlen);
+    out[qlen] = 0;
+}
+
+/* Lowest match index at or after pos */
+static int match_lower_bound(SearchState *ss, bpos pos) {
+    int lo = 0, hi = ss->match_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (ss->match_positions[mid] < pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Merge a sorted run into match_positions, keeping current_match on the
+ * same match it pointed at (or on the first match after the cursor while
+ * nothing has been found yet). */
+static int reserve_matches(SearchState *ss, int total) {
+    if (total <= ss->match_capacity) return 1;
+    int ncap = ss->match_capacity ? ss->match_capacity : 256;
+    while (ncap < total) ncap *= 2;
+    bpos *tp = (bpos *)realloc(ss->match_positions, ncap * sizeof(bpos));
+    if (!tp) return 0;
+    ss->match_positions = tp;
+    int *tl = (int *)realloc(ss->match_lengths, ncap * sizeof(int));
+    if (!tl) return 0;
+    ss->match_lengths = tl;
+    ss->match_capacity = ncap;
+    return 1;
+}
+
+static void merge_matches(SearchState *ss, Document *doc, const bpos *pos, const int *len, int count) {
+    if (count <= 0) return;
+    bpos keep = ss->match_count > 0 ? ss->match_positions[ss->current_match] : doc->cursor;
+
+    int total = ss->match_count + count;
+    if (!reserve_matches(ss, total)) return;
 
+    bpos *mp = ss->match_positions;
+    int *ml = ss->match_lengths;
+    if (ss->match_count == 0 || mp[ss->match_count - 1] < pos[0]) {
+        memcpy(mp + ss->match_count, pos, count * sizeof(bpos));
+        memcpy(ml + ss->match_count, len, count * sizeof(int));
+    } else {
+        /* Merge from the back so no scratch buffer is needed */
+        int i = ss->match_count - 1, j = count - 1, k = total - 1;
+        while (j >= 0) {
+            if (i >= 0 && mp[i] > pos[j]) { mp[k] = mp[i]; ml[k] = ml[i]; k--; i--; }
+            else { mp[k] = pos[j]; ml[k] = len[j]; k--; j--; }
+        }
+    }
+    ss->match_count = total;
+
+    ss->current_match = match_lower_bound(ss, keep);
+    if (ss->current_match >= ss->match_count) ss->current_match = 0;
+}
+
+static bpos viewport_start(Document *doc) {
+    int lh = g_editor.line_height > 0 ? g_editor.line_height : 1;
+    bpos vline = doc->scroll_y / lh;
+    if (doc->mode == MODE_PROSE && doc->wc.count > 0) {
+        if (vline >= doc->wc.count) vline = doc->wc.count - 1;
+        return doc->wc.entries[vline].pos;
+    }
+    if (vline >= doc->lc.count) vline = doc->lc.count - 1;
+    return vline > 0 ? lc_line_start(&doc->lc, vline) : 0;
+}
+
+static void clear_matches(SearchState *ss) {
     free(ss->match_positions);
+    free(ss->match_lengths);
     ss->match_positions = NULL;
+    ss->match_lengths = NULL;
     ss->match_count = 0;
+    ss->match_capacity = 0;
+}
+
+void search_cancel(void) {
+    InterlockedIncrement(&g_search_gen);
+    InterlockedIncrement(&g_tabs_gen);
+    g_editor.search.scanning = 0;
+    rx_free(g_edit_rx);
+    g_edit_rx = NULL;
+}
+
+static void query_from_state(SearchQuery *q) {
+    SearchState *ss = &g_editor.search;
+    q->regex = ss->regex;
+    q->len = (int)wcslen(ss->query);
+    if (ss->regex) safe_wcscpy(q->text, 256, ss->query);
+    else fold_query(ss->query, q->text, q->len);
+}
+
+/* Restart the progressive scan of the current tab only. */
+static void search_start_current(void) {
+    SearchState *ss = &g_editor.search;
+    Document *doc = current_doc();
+    InterlockedIncrement(&g_search_gen);
+    ss->scanning = 0;
+    clear_matches(ss);
+    ss->match_doc = doc;
+    if (!doc || ss->query[0] == 0 || ss->query_invalid) return;
+    doc->search_hits = -1;
+
+    SearchJob *job = (SearchJob *)malloc(sizeof(SearchJob));
+    if (!job) return;
+    job->snap = doc_snapshot(doc);
+    if (!job->snap) { free(job); return; }
+    job->doc = doc;
+    job->gen = g_search_gen;
+    query_from_state(&job->q);
+    job->first = viewport_start(doc);
+    job->nranges = plan_ranges(doc, &job->q, job->snap->len, &job->ranges);
+    if (job->nranges < 0) {
+        snapshot_release(job->snap);
+        free(job);
+        return;
+    }
+
+    ss->scanning = 1;
+    pool_submit(search_worker, job);
+}
+
+/* Queue a hit count for every tab but the current one. Hibernated tabs
+ * stay pending until the query settles. */
+static void search_start_tabs(void) {
+    SearchState *ss = &g_editor.search;
+    Document *cur = current_doc();
+    InterlockedIncrement(&g_tabs_gen);
+    if (!ss->all_tabs || ss->query[0] == 0 || ss->query_invalid) return;
+
+    SearchQuery q;
+    query_from_state(&q);
+    int hibernated = 0;
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        Document *doc = g_editor.tabs[i];
+        if (doc == cur) continue;
+        doc->search_hits = -1;
+        if (doc->hibernated) { hibernated = 1; continue; }
+        TabScan *job = tab_scan_new(doc, &q, 1);
+        if (job) pool_submit(tab_scan_worker, job);
+    }
+    /* Restarting the timer defers the reads while typing goes on */
+    if (hibernated) SetTimer(g_editor.hwnd, TIMER_SEARCH_SETTLE, SEARCH_SETTLE_MS, NULL);
+}
+
+/* TIMER_SEARCH_SETTLE: count the hibernated tabs for the query now in
+ * the find bar */
+void search_on_settle(void) {
+    SearchState *ss = &g_editor.search;
+    KillTimer(g_editor.hwnd, TIMER_SEARCH_SETTLE);
+    if (!ss->active || !ss->all_tabs || ss->query[0] == 0 || ss->query_invalid) return;
+
+    SearchQuery q;
+    query_from_state(&q);
+    Document *cur = current_doc();
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        Document *doc = g_editor.tabs[i];
+        if (doc == cur || !doc->hibernated || doc->search_hits >= 0) continue;
+        TabScan *job = tab_scan_new(doc, &q, 1);
+        if (job) pool_submit(tab_scan_worker, job);
+    }
+}
+
+void search_update_matches(void) {
+    SearchState *ss = &g_editor.search;
+    search_cancel();
+    ss->query_invalid = 0;
+    for (int i = 0; i < g_editor.tab_count; i++) g_editor.tabs[i]->search_hits = 0;
+    if (ss->regex && ss->query[0] != 0) {
+        /* Validate on the UI thread so the find bar can flag it at once */
+        Regex *rx = rx_compile(ss->query, NULL);
+        if (!rx) ss->query_invalid = 1;
+        rx_free(rx);
+    }
+    search_start_current();
+    search_start_tabs();
+}
 
-    int qlen = (int)wcslen(ss->query);
-    bpos tlen = gb_length(&doc->gb);
-    if (tlen < (bpos)qlen) return;
-    int cap = 256;
-    ss->match_positions = (bpos *)malloc(cap * sizeof(bpos));
-    if (!ss->match_positions) return;
-
-    wchar_t *text = (wchar_t *)malloc((tlen + 1) * sizeof(wchar_t));
-    if (!text) { free(ss->match_positions); ss->match_positions = NULL; return; }
-    gb_copy_range(&doc->gb, 0, tlen, text);
-
-    for (bpos i = 0; i < tlen; i++) text[i] = towlower(text[i]);
-    wchar_t lower_query[256];
-    for (int i = 0; i < qlen; i++) lower_query[i] = towlower(ss->query[i]);
-    lower_query[qlen] = 0;
-
-    wchar_t first_ch = lower_query[0];
-    for (bpos i = 0; i <= tlen - (bpos)qlen; i++) {
-        if (text[i] != first_ch) continue;
-        if (wcsncmp(text + i, lower_query, qlen) == 0) {
-            if (ss->match_count >= cap) {
-                cap *= 2;
-                bpos *tmp = (bpos *)realloc(ss->match_positions, cap * sizeof(bpos));
-                if (!tmp) break;
-                ss->match_positions = tmp;
+/* Called before painting: re-run the scan if the active tab changed
+ * since the match list was built. */
+void search_sync_doc(void) {
+    SearchState *ss = &g_editor.search;
+    if (ss->active && ss->match_doc != current_doc()) search_start_current();
+}
+
+void search_on_results(LPARAM lParam) {
+    SearchBatch *b = (SearchBatch *)lParam;
+    SearchState *ss = &g_editor.search;
+    Document *doc = current_doc();
+
+    if (b->gen == g_search_gen) {
+        if (b->doc != doc) {
+            /* Tab changed under a running scan: retarget the search */
+            search_start_current();
+        } else {
+            merge_matches(ss, doc, b->pos, b->len, b->count);
+            if (b->done) {
+                ss->scanning = 0;
+                doc->search_hits = ss->match_count;
             }
-            ss->match_positions[ss->match_count++] = i;
         }
     }
+    free(b->pos);
+    free(b->len);
+    free(b);
+}
 
-    free(text);
+void search_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted) {
+    SearchState *ss = &g_editor.search;
+    if (g_bulk_edit || !ss->active || doc != ss->match_doc) return;
+    if (ss->query[0] == 0 || ss->query_invalid) return;
+    if (ss->scanning) {
+        /* Positions from the running scan are already stale */
+        search_start_current();
+        return;
+    }
 
-    if (ss->match_count > 0) {
-        if (ss->current_match >= ss->match_count)
-            ss->current_match = 0;
-        bpos cursor = doc->cursor;
-        for (int i = 0; i < ss->match_count; i++) {
-            if (ss->match_positions[i] >= cursor) {
-                ss->current_match = i;
-                break;
-            }
+    SearchQuery q;
+    query_from_state(&q);
+    if (q.regex && !g_edit_rx && !(g_edit_rx = rx_compile(q.text, NULL))) return;
+
+    /* Widen the edit to whole lines, in post-edit coordinates */
+    GapBuffer *gb = &doc->gb;
+    bpos len = gb_length(gb);
+    bpos ls = pos, le = pos + inserted;
+    while (ls > 0 && gb_char_at(gb, ls - 1) != L'\n') ls--;
+    while (le < len && gb_char_at(gb, le) != L'\n') le++;
+    bpos delta = inserted - removed;
+
+    MatchList found = { 0 };
+    if (le > ls) {
+        wchar_t *text = gb_extract_alloc(gb, ls, le - ls);
+        if (!text || scan_chunk(q.regex ? g_edit_rx : NULL, &q, text, le - ls, 0, le - ls, &found) < 0) {
+            free(text);
+            ml_free(&found);
+            search_start_current();
+            return;
         }
+        free(text);
+    }
+
+    /* Old matches in [a, b) started on the edited lines */
+    int a = match_lower_bound(ss, ls);
+    int b = match_lower_bound(ss, le - delta + 1);
+    int k = found.count;
+    int total = ss->match_count - (b - a) + k;
+    if (!reserve_matches(ss, total)) {
+        ml_free(&found);
+        search_start_current();
+        return;
+    }
+
+    bpos *mp = ss->match_positions;
+    int *ml = ss->match_lengths;
+    int tail = ss->match_count - b;
+    memmove(mp + a + k, mp + b, tail * sizeof(bpos));
+    memmove(ml + a + k, ml + b, tail * sizeof(int));
+    for (int i = a + k; i < total; i++) mp[i] += delta;
+    for (int i = 0; i < k; i++) {
+        mp[a + i] = ls + found.pos[i];
+        ml[a + i] = found.len[i];
     }
+    ml_free(&found);
+
+    int cm = ss->current_match;
+    if (cm >= b) cm += k - (b - a);
+    else if (cm >= a) cm = a;
+    ss->match_count = total;
+    ss->current_match = cm < total ? cm : 0;
+    doc->search_hits = total;
+}
+
+static Document *find_open_doc(Document *doc, unsigned int doc_id) {
+    for (int i = 0; i < g_editor.tab_count; i++)
+        if (g_editor.tabs[i] == doc && doc->autosave_id == doc_id) return doc;
+    return NULL;
+}
+
+void search_on_tab_hits(LPARAM lParam) {
+    TabScan *job = (TabScan *)lParam;
+    if (job->ok && job->gen == g_tabs_gen) {
+        Document *doc = find_open_doc(job->doc, job->doc_id);
+        if (doc && doc != current_doc()) doc->search_hits = job->found.count;
+    }
+    ml_free(&job->found);
+    free(job);
+}
+
+/* Sum of per-tab hits for the status bar; *pending is set while any tab
+ * is still being scanned. */
+int search_total_hits(int *tabs_with_hits, int *pending) {
+    int total = 0;
+    *tabs_with_hits = 0;
+    *pending = 0;
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        int h = g_editor.tabs[i]->search_hits;
+        if (h < 0) { (*pending)++; continue; }
+        total += h;
+        if (h > 0) (*tabs_with_hits)++;
+    }
+    return total;
+}
+
+/* Finish an in-flight scan on the calling thread. Used by operations that
+ * need the complete match list, such as Replace All. */
+void search_finish_now(void) {
+    SearchState *ss = &g_editor.search;
+    Document *doc = current_doc();
+    if (!ss->scanning || !doc) return;
+    InterlockedIncrement(&g_search_gen);
+    ss->scanning = 0;
+    clear_matches(ss);
+
+    SearchQuery q;
+    query_from_state(&q);
+    Regex *rx = NULL;
+    if (q.regex && !(rx = rx_compile(q.text, NULL))) return;
+    DocSnapshot *snap = doc_snapshot(doc);
+    if (!snap) { rx_free(rx); return; }
+
+    MatchList found = { 0 };
+    bpos *ranges;
+    int n = plan_ranges(doc, &q, snap->len, &ranges);
+    int ok = n >= 0;
+    for (int r = 0; ok && r < n; r++)
+        ok = scan_chunk(rx, &q, snap->text, snap->len, ranges[2 * r], ranges[2 * r + 1], &found) >= 0;
+    if (ok) merge_matches(ss, doc, found.pos, found.len, found.count);
+    doc->search_hits = ss->match_count;
+    free(ranges);
+    ml_free(&found);
+    rx_free(rx);
+    snapshot_release(snap);
+}
+
+void search_toggle_regex(void) {
+    g_editor.search.regex = !g_editor.search.regex;
+    if (g_editor.search.active) search_update_matches();
+}
+
+void search_toggle_all_tabs(void) {
+    g_editor.search.all_tabs = !g_editor.search.all_tabs;
+    if (g_editor.search.active) search_update_matches();
 }
 
 void toggle_search(void) {
     g_editor.search.active = !g_editor.search.active;
     if (!g_editor.search.active) {
-        g_editor.search.match_count = 0;
-        free(g_editor.search.match_positions);
-        g_editor.search.match_positions = NULL;
+        search_cancel();
+        clear_matches(&g_editor.search);
+        g_editor.search.match_doc = NULL;
         g_editor.search.replace_focused = 0;
+        for (int i = 0; i < g_editor.tab_count; i++) doc_drop_snapshot(g_editor.tabs[i]);
     } else {
         if (g_editor.search.query[0] != 0)
             search_update_matches();
     }
 }
 
-void search_next(void) {
-    SearchState *ss = &g_editor.search;
-    if (ss->match_count == 0) return;
-    ss->current_match = (ss->current_match + 1) % ss->match_count;
+static void select_match(SearchState *ss) {
     Document *doc = current_doc();
     if (doc) {
         bpos pos = ss->match_positions[ss->current_match];
         doc->sel_anchor = pos;
-        doc->cursor = pos + (bpos)wcslen(ss->query);
+        doc->cursor = pos + ss->match_lengths[ss->current_match];
         editor_ensure_cursor_visible();
     }
 }
 
+/* All-tabs mode: step to the next tab in `dir` that has hits and load
+ * its complete match list. */
+static int jump_to_tab_with_hits(int dir) {
+    SearchState *ss = &g_editor.search;
+    int n = g_editor.tab_count;
+    for (int k = 1; k < n; k++) {
+        int i = ((g_editor.active_tab + dir * k) % n + n) % n;
+        if (g_editor.tabs[i]->search_hits <= 0) continue;
+        /* Read whole, or the scan below would see only the first part */
+        if (!wake_tab(i, 1) || !activate_tab(i)) return 0;
+        search_start_current();
+        search_finish_now();
+        if (ss->match_count == 0) return 0;
+        ss->current_match = dir > 0 ? 0 : ss->match_count - 1;
+        return 1;
+    }
+    return 0;
+}
+
+void search_next(void) {
+    SearchState *ss = &g_editor.search;
+    if (ss->all_tabs && !ss->scanning &&
+        (ss->match_count == 0 || ss->current_match == ss->match_count - 1) &&
+        jump_to_tab_with_hits(1)) {
+        select_match(ss);
+        return;
+    }
+    if (ss->match_count == 0) return;
+    ss->current_match = (ss->current_match + 1) % ss->match_count;
+    select_match(ss);
+}
+
 void search_prev(void) {
     SearchState *ss = &g_editor.search;
+    if (ss->all_tabs && !ss->scanning &&
+        (ss->match_count == 0 || ss->current_match == 0) &&
+        jump_to_tab_with_hits(-1)) {
+        select_match(ss);
+        return;
+    }
     if (ss->match_count == 0) return;
     ss->current_match = (ss->current_match - 1 + ss->match_count) % ss->match_count;
-    Document *doc = current_doc();
-    if (doc) {
-        bpos pos = ss->match_positions[ss->current_match];
-        doc->sel_anchor = pos;
-        doc->cursor = pos + (bpos)wcslen(ss->query);
-        editor_ensure_cursor_visible();
-    }
+    select_match(ss);
 }
 
 void do_replace(void) {
     SearchState *ss = &g_editor.search;
     Document *doc = current_doc();
-    if (!doc || ss->match_count == 0) return;
+    if (!doc || doc->loading || ss->match_count == 0) return;
 
     bpos pos = ss->match_positions[ss->current_match];
-    int qlen = (int)wcslen(ss->query);
+    int mlen = ss->match_lengths[ss->current_match];
     int rlen = (int)wcslen(ss->replace_text);
 
     doc->cursor = pos;
-    doc->sel_anchor = pos + qlen;
+    doc->sel_anchor = pos + mlen;
     editor_delete_selection();
     editor_insert_text(ss->replace_text, rlen);
     doc->cursor = pos + rlen;
-    search_update_matches();
-}
 
-void do_replace_all(void) {
-    SearchState *ss = &g_editor.search;
-    Document *doc = current_doc();
-    if (!doc || ss->match_count == 0) return;
+    /* The edit hook has already updated the list; move to the next match */
+    if (ss->match_count > 0) {
+        ss->current_match = match_lower_bound(ss, pos + rlen);
+        if (ss->current_match >= ss->match_count) ss->current_match = 0;
+    }
+}
 
-    int qlen = (int)wcslen(ss->query);
-    int rlen = (int)wcslen(ss->replace_text);
+/* Replace every listed match in `doc` as a single undo group. */
+static void replace_matches(Document *doc, const bpos *positions, const int *lengths, int count) {
+    const wchar_t *rep = g_editor.search.replace_text;
+    int rlen = (int)wcslen(rep);
     bpos old_cursor = doc->cursor;
-    bpos diff = rlen - qlen;
+    bpos shift = 0;
 
     int group = ++doc->undo.next_group;
 
-    for (int i = 0; i < ss->match_count; i++) {
-        bpos pos = ss->match_positions[i] + (bpos)i * diff;
+    g_bulk_edit = 1;
+    for (int i = 0; i < count; i++) {
+        bpos pos = positions[i] + shift;
+        int mlen = lengths[i];
 
-        wchar_t *deleted = gb_extract_alloc(&doc->gb, pos, qlen);
+        wchar_t *deleted = gb_extract_alloc(&doc->gb, pos, mlen);
         if (deleted) {
-            undo_push(&doc->undo, UNDO_DELETE, pos, deleted, qlen, old_cursor, pos, group);
+            undo_push(&doc->undo, UNDO_DELETE, pos, deleted, mlen, old_cursor, pos, group);
             free(deleted);
         }
-        gb_delete(&doc->gb, pos, qlen);
+        gb_delete(&doc->gb, pos, mlen);
 
-        gb_insert(&doc->gb, pos, ss->replace_text, rlen);
-        undo_push(&doc->undo, UNDO_INSERT, pos, ss->replace_text, rlen, pos, pos + rlen, group);
+        gb_insert(&doc->gb, pos, rep, rlen);
+        undo_push(&doc->undo, UNDO_INSERT, pos, rep, rlen, pos, pos + rlen, group);
+        shift += rlen - mlen;
+        doc->cursor = pos + rlen;
     }
+    g_bulk_edit = 0;
 
     bpos total = gb_length(&doc->gb);
-    if (ss->match_count > 0) {
-        bpos last_pos = ss->match_positions[ss->match_count - 1] + (bpos)(ss->match_count - 1) * diff;
-        doc->cursor = last_pos + rlen;
-    }
     if (doc->cursor > total) doc->cursor = total;
+    doc->sel_anchor = -1;
 
     doc->modified = 1;
     recalc_lines(doc);
-    update_stats(doc);
+}
+
+/* Scan every tab in parallel, then apply each tab's replacements on the
+ * UI thread so no document changes while a worker reads its snapshot.
+ * Tabs still loading are left alone (tab_scan_new declines them), and
+ * the user is told how many. A hibernated tab with matches is read in
+ * whole first and scanned again, since the replacements go into its
+ * buffer; one whose file can no longer be read is closed afterwards, as
+ * activate_tab would. */
+static void replace_all_tabs(void) {
+    SearchQuery q;
+    query_from_state(&q);
+    search_cancel();
+
+    TabScan *scans[MAX_TABS];
+    int n = g_editor.tab_count, loading = 0;
+    PoolGroup grp;
+    pool_group_init(&grp);
+    for (int i = 0; i < n; i++) {
+        loading += g_editor.tabs[i]->loading != 0;
+        scans[i] = tab_scan_new(g_editor.tabs[i], &q, 0);
+        if (scans[i]) pool_group_submit(&grp, tab_scan_worker, scans[i]);
+    }
+    pool_group_wait(&grp);
+
+    Document *unreadable[MAX_TABS];
+    int nunreadable = 0;
+    for (int i = 0; i < n; i++) {
+        TabScan *job = scans[i];
+        if (!job) continue;
+        Document *doc = job->doc;
+        if (job->ok && job->found.count > 0 && doc->hibernated) {
+            ml_free(&job->found);
+            free(job);
+            job = NULL;
+            if (!session_wake(doc, 1)) unreadable[nunreadable++] = doc;
+            else if ((job = tab_scan_new(doc, &q, 0)) != NULL) tab_scan_worker(job);
+        }
+        if (job) {
+            if (job->ok && job->found.count > 0)
+                replace_matches(doc, job->found.pos, job->found.len, job->found.count);
+            ml_free(&job->found);
+            free(job);
+        }
+    }
+
+    /* Closed once every scan is done with, found by pointer since each
+     * close moves the tabs after it */
+    for (int k = 0; k < nunreadable; k++) {
+        for (int i = 0; i < g_editor.tab_count; i++) {
+            if (g_editor.tabs[i] == unreadable[k]) {
+                close_tab(i);
+                break;
+            }
+        }
+    }
+    if (loading) {
+        wchar_t msg[96];
+        swprintf(msg, 96, L"%d tab%ls still loading and %ls not changed.",
+                 loading, loading == 1 ? L" was" : L"s were", loading == 1 ? L"was" : L"were");
+        MessageBoxW(g_editor.hwnd, msg, L"Prose_Code", MB_OK | MB_ICONINFORMATION);
+    }
+}
+
+void do_replace_all(void) {
+    SearchState *ss = &g_editor.search;
+    Document *doc = current_doc();
+    if (!doc || doc->loading || ss->query[0] == 0 || ss->query_invalid) return;
+
+    if (ss->all_tabs) {
+        replace_all_tabs();
+    } else {
+        search_finish_now();
+        if (ss->match_count == 0) return;
+        replace_matches(doc, ss->match_positions, ss->match_lengths, ss->match_count);
+    }
     search_update_matches();
 }
@@ -0,0 +1,223 @@
+#include "prose_code.h"
+
+/* ── Session ──
+ * On a clean exit the tabs with a file behind them are written to
+ * ProseCode\session.bin: a header, then per tab a fixed record followed
+ * by its path in UTF-16. At the next start every tab comes back at once
+ * but only the active one is read; the rest are hibernated, holding
+ * their path, mode and position but no text, and activate_tab reads
+ * each the first time it is shown. Startup therefore costs one file,
+ * however many tabs were open.
+ *
+ * A file whose size or write time no longer matches its record opens
+ * at the top, since the saved position may not mean anything in it. */
+
+#define SESSION_MAGIC   0x53534350u   /* "PCSS" */
+#define SESSION_VERSION 1
+#define SESSION_MAX_SIZE (MAX_TABS * (sizeof(SessionRecord) + MAX_PATH * sizeof(wchar_t)))
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int count;      /* records that follow */
+    unsigned int active;     /* index of the active tab's record */
+} SessionHeader;
+
+typedef struct {
+    long long cursor;
+    long long sel_anchor;
+    unsigned long long size; /* of the file when the session was saved */
+    FILETIME time;
+    int scroll_y, scroll_x;
+    unsigned short mode;
+    unsigned short path_len; /* UTF-16 units that follow */
+} SessionRecord;
+
+static int session_path(wchar_t *out) {
+    wchar_t appdata[MAX_PATH];
+    if (GetEnvironmentVariableW(L"LOCALAPPDATA", appdata, MAX_PATH) == 0) return 0;
+    swprintf(out, MAX_PATH, L"%ls\\ProseCode\\session.bin", appdata);
+    return 1;
+}
+
+/* WM_CLOSE, after unsaved changes were dealt with */
+void session_save(void) {
+    wchar_t path[MAX_PATH];
+    if (!session_path(path)) return;
+    char *data = (char *)malloc(sizeof(SessionHeader) + SESSION_MAX_SIZE);
+    if (!data) return;
+
+    SessionHeader hdr = { SESSION_MAGIC, SESSION_VERSION, 0, 0 };
+    size_t len = sizeof(hdr);
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        Document *doc = g_editor.tabs[i];
+        if (!doc->filepath[0] || doc->is_results) continue;
+        if (i <= g_editor.active_tab) hdr.active = hdr.count;
+        SessionRecord r;
+        memset(&r, 0, sizeof(r));
+        r.cursor = doc->cursor;
+        r.sel_anchor = doc->sel_anchor;
+        r.size = doc->disk.size;
+        r.time = doc->disk.time;
+        r.scroll_y = doc->target_scroll_y;
+        r.scroll_x = doc->target_scroll_x;
+        r.mode = (unsigned short)doc->mode;
+        r.path_len = (unsigned short)wcslen(doc->filepath);
+        memcpy(data + len, &r, sizeof(r));
+        len += sizeof(r);
+        memcpy(data + len, doc->filepath, r.path_len * sizeof(wchar_t));
+        len += r.path_len * sizeof(wchar_t);
+        hdr.count++;
+    }
+    memcpy(data, &hdr, sizeof(hdr));
+
+    if (hdr.count == 0) {
+        DeleteFileW(path);
+        free(data);
+        return;
+    }
+    wchar_t tmp_path[MAX_PATH + 16];
+    swprintf(tmp_path, MAX_PATH + 16, L"%ls.tmp~", path);
+    autosave_ensure_dir();
+    HANDLE h = CreateFileW(tmp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h != INVALID_HANDLE_VALUE) {
+        DWORD written = 0;
+        BOOL ok = WriteFile(h, data, (DWORD)len, &written, NULL) && written == (DWORD)len;
+        CloseHandle(h);
+        if (!ok || !MoveFileExW(tmp_path, path, MOVEFILE_REPLACE_EXISTING)) DeleteFileW(tmp_path);
+    }
+    free(data);
+}
+
+/* At startup, after crash recovery: brings back the tabs of the last
+ * session, hibernated, and reads the one that was active. Files that
+ * are gone or already open (recovered) are skipped. */
+void session_restore(void) {
+    wchar_t path[MAX_PATH];
+    if (!session_path(path)) return;
+    HANDLE h = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    char *data = NULL;
+    DWORD got = 0;
+    if (GetFileSizeEx(h, &size) && size.QuadPart >= (LONGLONG)sizeof(SessionHeader) &&
+        size.QuadPart <= (LONGLONG)(sizeof(SessionHeader) + SESSION_MAX_SIZE)) {
+        data = (char *)malloc((size_t)size.QuadPart);
+        if (data && !(ReadFile(h, data, (DWORD)size.QuadPart, &got, NULL) &&
+                      got == (DWORD)size.QuadPart)) {
+            free(data);
+            data = NULL;
+        }
+    }
+    CloseHandle(h);
+    if (!data) return;
+
+    SessionHeader hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    if (hdr.magic != SESSION_MAGIC || hdr.version != SESSION_VERSION || hdr.count > MAX_TABS) {
+        free(data);
+        return;
+    }
+
+    /* An empty untitled first tab gives way, as in autosave_recover */
+    int replace = g_editor.tab_count == 1 && !g_editor.tabs[0]->modified &&
+                  !g_editor.tabs[0]->filepath[0] && gb_length(&g_editor.tabs[0]->gb) == 0;
+    int active = -1, first = -1;
+    size_t at = sizeof(hdr);
+    for (unsigned int i = 0; i < hdr.count; i++) {
+        SessionRecord r;
+        if (at + sizeof(r) > got) break;
+        memcpy(&r, data + at, sizeof(r));
+        at += sizeof(r);
+        if (r.path_len == 0 || r.path_len >= MAX_PATH ||
+            at + r.path_len * sizeof(wchar_t) > got)
+            break;
+        wchar_t file[MAX_PATH];
+        memcpy(file, data + at, r.path_len * sizeof(wchar_t));
+        file[r.path_len] = 0;
+        at += r.path_len * sizeof(wchar_t);
+        if (GetFileAttributesW(file) == INVALID_FILE_ATTRIBUTES || tab_with_path(file) >= 0) continue;
+        if (!replace && g_editor.tab_count >= MAX_TABS) break;
+
+        Document *doc = doc_create();
+        set_doc_path(doc, file);
+        doc->mode = r.mode == MODE_CODE ? MODE_CODE : MODE_PROSE;
+        doc->cursor = (bpos)r.cursor;
+        doc->sel_anchor = (bpos)r.sel_anchor;
+        doc->scroll_y = doc->target_scroll_y = r.scroll_y;
+        doc->scroll_x = doc->target_scroll_x = r.scroll_x;
+        doc->disk.size = r.size;
+        doc->disk.time = r.time;
+        doc->hibernated = 1;
+        int idx = 0;
+        if (replace) {
+            doc_free(g_editor.tabs[0]);
+            g_editor.tabs[0] = doc;
+            replace = 0;
+        } else {
+            idx = g_editor.tab_count++;
+            g_editor.tabs[idx] = doc;
+        }
+        if (first < 0) first = idx;
+        if (i <= hdr.active) active = idx;
+    }
+    free(data);
+    if (active < 0) active = first;
+
+    /* Recovered work stays in front */
+    Document *cur = current_doc();
+    if (active >= 0 && (!cur || !cur->modified)) activate_tab(active);
+    InvalidateRect(g_editor.hwnd, NULL, FALSE);
+}
+
+/* Reads a hibernated tab's file and puts it back where it was, if the
+ * file has not changed since. A large file streams in unless whole is
+ * set, and is placed once it is all in (stream_update). 0 if it could
+ * not be read: the tab is then left empty and unlinked from the path,
+ * for the caller to close. */
+int session_wake(Document *doc, int whole) {
+    if (!doc->hibernated) return 1;
+    doc->hibernated = 0;
+    WakePlace *w = &doc->wake;
+    w->disk = doc->disk;
+    w->cursor = doc->cursor;
+    w->sel_anchor = doc->sel_anchor;
+    w->scroll_y = doc->target_scroll_y;
+    w->scroll_x = doc->target_scroll_x;
+    EditorMode mode = doc->mode;
+    wchar_t path[MAX_PATH];
+    safe_wcscpy(path, MAX_PATH, doc->filepath);
+    if (!(whole ? load_file_whole(doc, path) : load_file(doc, path))) {
+        /* Saving the empty tab would wipe the file */
+        doc->filepath[0] = 0;
+        memset(&doc->disk, 0, sizeof(doc->disk));
+        doc->cursor = 0;
+        doc->sel_anchor = -1;
+        wchar_t msg[MAX_PATH + 64];
+        swprintf(msg, MAX_PATH + 64, L"Could not open \"%ls\".", path);
+        MessageBoxW(g_editor.hwnd, msg, L"Prose_Code", MB_OK | MB_ICONWARNING);
+        return 0;
+    }
+    doc->mode = mode;
+    if (doc->mode == MODE_PROSE && doc->wc.wrap_col > 0) doc->wrap_dirty = 1;
+    w->pending = 1;
+    if (!doc->loading) session_place(doc);
+    return 1;
+}
+
+/* Restores a woken tab's position once all of its text is in, unless
+ * the file on disk is no longer the one the position was saved for */
+void session_place(Document *doc) {
+    WakePlace *w = &doc->wake;
+    if (!w->pending) return;
+    w->pending = 0;
+    if (w->disk.size != doc->disk.size || CompareFileTime(&w->disk.time, &doc->disk.time) != 0)
+        return;
+    bpos len = gb_length(&doc->gb);
+    doc->cursor = w->cursor < len ? w->cursor : len;
+    doc->sel_anchor = w->sel_anchor < len ? w->sel_anchor : -1;
+    doc->scroll_y = doc->target_scroll_y = w->scroll_y;
+    doc->scroll_x = doc->target_scroll_x = w->scroll_x;
+}
@@ -7,106 +7,514 @@ static const GUID CLSID_SpellCheckerFactory =
 static const GUID IID_ISpellCheckerFactory =
     {0x8E018A9D, 0x2415, 0x4677, {0xBF, 0x08, 0x79, 0x4E, 0xA6, 0x1F, 0x94, 0xBB}};
 
-/* ── Spell cache (file-local) ── */
-static SpellCacheNode *g_spell_cache[SPELL_CACHE_BUCKETS];
-static int             g_spell_cache_count = 0;
+/* ── Spell cache (file-local) ──
+ * Fixed open-addressing table with linear probing, so a lookup or an
+ * insert never allocates. When SPELL_CACHE_MAX entries are live, CLOCK
+ * evicts one: the hand sweeps the slots clearing reference bits and
+ * removes the first entry not used since its last pass. Removal shifts
+ * the rest of the probe run back, so there are no tombstones.
+ *
+ * The table lives in g_spell_table, or in a copy-on-write view of the
+ * cache file saved by the previous session (see Persistent cache). */
+static SpellSlot       g_spell_table[SPELL_CACHE_SLOTS];
+static SpellSlot      *g_spell_cache = g_spell_table;
+static SpellCacheStats g_spell_stats;
+static int             g_spell_hand = 0;
+static int             g_spell_dirty = 0;      /* changed since loaded */
 
 ISpellChecker *g_spell_checker = NULL;
 int            g_spell_loaded  = 0;
 
-static unsigned int spell_hash(const wchar_t *word) {
-    unsigned int h = 5381;
-    while (*word) {
-        h = ((h << 5) + h) + towlower(*word);
-        word++;
+/* Local dictionary (dict.c); the COM checker is only used without one */
+static Dict *g_spell_dict = NULL;
+
+#define SPELL_LANG L"en-US"
+
+/* Identifies the source of the cached verdicts: a hash of the
+ * dictionary files, or of the COM checker's language */
+static unsigned long long g_spell_sig = 0;
+
+static unsigned long long fnv64(unsigned long long h, const void *data, size_t n) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
     }
     return h;
 }
 
-static int spell_cache_lookup(const wchar_t *lower, int len) {
-    unsigned int h = spell_hash(lower) & SPELL_CACHE_MASK;
-    for (SpellCacheNode *n = g_spell_cache[h]; n; n = n->next) {
-        if (wcsncmp(n->word, lower, len) == 0 && n->word[len] == 0)
-            return n->correct;
+static unsigned int spell_hash(const wchar_t *word, int len) {
+    unsigned int h = 5381;
+    for (int i = 0; i < len; i++)
+        h = ((h << 5) + h) + word[i];
+    return h ? h : 1;
+}
+
+static int spell_cache_lookup(const wchar_t *lower, int len, unsigned int h) {
+    for (unsigned int i = h & SPELL_CACHE_MASK; g_spell_cache[i].hash; i = (i + 1) & SPELL_CACHE_MASK) {
+        SpellSlot *s = &g_spell_cache[i];
+        if (s->hash == h && s->len == len && memcmp(s->word, lower, len * sizeof(wchar_t)) == 0) {
+            s->ref = 1;
+            g_spell_stats.hits++;
+            return s->correct;
+        }
     }
+    g_spell_stats.misses++;
     return -1;
 }
 
-static void spell_cache_insert(const wchar_t *lower, int len, int correct) {
-    if (g_spell_cache_count >= SPELL_CACHE_MAX) {
-        int evicted = 0;
-        for (int i = 0; i < SPELL_CACHE_BUCKETS; i += 2) {
-            SpellCacheNode *n = g_spell_cache[i];
-            while (n) {
-                SpellCacheNode *next = n->next;
-                free(n->word);
-                free(n);
-                evicted++;
-                n = next;
+/* Empty slot i, pulling later entries of the probe run back into it. */
+static void spell_cache_remove(unsigned int i) {
+    unsigned int j = i;
+    for (;;) {
+        j = (j + 1) & SPELL_CACHE_MASK;
+        if (!g_spell_cache[j].hash) break;
+        unsigned int home = g_spell_cache[j].hash & SPELL_CACHE_MASK;
+        /* Leave it if its home lies cyclically in (i, j] */
+        int stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (stays) continue;
+        g_spell_cache[i] = g_spell_cache[j];
+        i = j;
+    }
+    g_spell_cache[i].hash = 0;
+    g_spell_stats.count--;
+    g_spell_dirty = 1;
+}
+
+static void spell_cache_evict(void) {
+    for (;;) {
+        SpellSlot *s = &g_spell_cache[g_spell_hand];
+        if (s->hash) {
+            if (!s->ref) {
+                spell_cache_remove((unsigned int)g_spell_hand);
+                g_spell_stats.evictions++;
+                return;
             }
-            g_spell_cache[i] = NULL;
+            s->ref = 0;
         }
-        g_spell_cache_count -= evicted;
+        g_spell_hand = (g_spell_hand + 1) & SPELL_CACHE_MASK;
     }
-    unsigned int h = spell_hash(lower) & SPELL_CACHE_MASK;
-    SpellCacheNode *n = (SpellCacheNode *)malloc(sizeof(SpellCacheNode));
-    if (!n) return;
-    n->word = (wchar_t *)malloc((len + 1) * sizeof(wchar_t));
-    if (!n->word) { free(n); return; }
-    memcpy(n->word, lower, len * sizeof(wchar_t));
-    n->word[len] = 0;
-    n->correct = correct;
-    n->next = g_spell_cache[h];
-    g_spell_cache[h] = n;
-    g_spell_cache_count++;
 }
 
-int spell_check(const wchar_t *word, int len) {
-    if (len <= 1) return 1;
-    if (!g_spell_loaded) return 1;
-    if (!g_editor.spellcheck_enabled) return 1;
+static void spell_cache_insert(const wchar_t *lower, int len, unsigned int h, int correct) {
+    if (len > SPELL_KEY_MAX) return;
+    if (g_spell_stats.count >= SPELL_CACHE_MAX) spell_cache_evict();
+    unsigned int i = h & SPELL_CACHE_MASK;
+    while (g_spell_cache[i].hash) i = (i + 1) & SPELL_CACHE_MASK;
+    SpellSlot *s = &g_spell_cache[i];
+    s->hash = h;
+    s->len = (unsigned char)len;
+    s->correct = (unsigned char)correct;
+    s->ref = 0;
+    memcpy(s->word, lower, len * sizeof(wchar_t));
+    g_spell_stats.count++;
+    g_spell_dirty = 1;
+}
+
+void spell_cache_stats(SpellCacheStats *out) {
+    *out = g_spell_stats;
+}
 
-    for (int i = 0; i < len; i++) {
-        if (iswdigit(word[i])) return 1;
+/* ── Backends ── */
+
+/* ISpellChecker::Check takes arbitrary text and enumerates its errors */
+static int com_check(SpellBackend *self, const wchar_t *text, ptrdiff_t len,
+                     SpellErrorFn fn, void *ctx) {
+    IEnumSpellingError *errors = NULL;
+    if (!g_spell_checker) return 0;
+    HRESULT hr = g_spell_checker->lpVtbl->Check(g_spell_checker, text, &errors);
+    if (FAILED(hr) || !errors) return 0;
+
+    ISpellingError *err = NULL;
+    while (errors->lpVtbl->Next(errors, &err) == S_OK && err) {
+        ULONG start = 0, elen = 0;
+        CORRECTIVE_ACTION action = CORRECTIVE_ACTION_NONE;
+        err->lpVtbl->get_CorrectiveAction(err, &action);
+        /* A batch can repeat a word, which the checker flags for deletion */
+        if (action != CORRECTIVE_ACTION_DELETE &&
+            SUCCEEDED(err->lpVtbl->get_StartIndex(err, &start)) &&
+            SUCCEEDED(err->lpVtbl->get_Length(err, &elen)) && start < (ULONG)len) {
+            fn(ctx, start, elen);
+        }
+        err->lpVtbl->Release(err);
+        err = NULL;
     }
+    errors->lpVtbl->Release(errors);
+    return 1;
+}
+
+static SpellBackend  g_com_backend = { com_check, 0 };
+static DictBackend   g_dict_backend;
+static SpellBackend *g_spell_backend = NULL;
+
+/* 1 if the pool may check spelling; the COM checker stays on the UI thread */
+int spell_backend_thread_safe(void) {
+    return g_spell_backend && g_spell_backend->thread_safe;
+}
+
+/* ── Checking ──
+ * Words of a run of text are collected in order. Cached words keep
+ * their verdict; the others, with repeats merged, go to the backend as
+ * one batch when the window fills or the text ends. */
+
+typedef struct {
+    bpos pos;
+    int len;
+    int slot;           /* batch index, or -1 if the cache answered */
+    int correct;
+} CheckWord;
+
+typedef struct {
+    const wchar_t *text;
+    int use_cache;
+    SpellErrorFn fn;
+    void *ctx;
+    int count, batched;
+    CheckWord words[SPELL_BATCH_WORDS];
+    const wchar_t *batch[SPELL_BATCH_WORDS];
+    int batch_len[SPELL_BATCH_WORDS];
+    unsigned int batch_hash[SPELL_BATCH_WORDS];
+    wchar_t batch_lower[SPELL_BATCH_WORDS][SPELL_WORD_MAX];
+} TextCheck;
+
+static void check_flush(TextCheck *tc) {
+    unsigned char ok[SPELL_BATCH_WORDS];
+    /* If the backend fails nothing is flagged or cached */
+    int checked = tc->batched > 0 &&
+                  speller_batch(g_spell_backend, tc->batch, tc->batch_len, tc->batched, ok);
+    if (checked && tc->use_cache) {
+        for (int i = 0; i < tc->batched; i++)
+            spell_cache_insert(tc->batch_lower[i], tc->batch_len[i], tc->batch_hash[i], ok[i]);
+    }
+    for (int i = 0; i < tc->count; i++) {
+        CheckWord *w = &tc->words[i];
+        int correct = w->slot < 0 ? w->correct : !checked || ok[w->slot];
+        if (!correct) tc->fn(tc->ctx, w->pos, w->len);
+    }
+    tc->count = tc->batched = 0;
+}
+
+static void check_word(TextCheck *tc, bpos pos, int len) {
+    const wchar_t *word = tc->text + pos;
+    if (speller_skip(word, len)) return;
+    if (tc->count == SPELL_BATCH_WORDS) check_flush(tc);
+
+    wchar_t lower[SPELL_WORD_MAX];
+    ch_fold_run(word, lower, len);
+    unsigned int h = spell_hash(lower, len);
+    CheckWord *w = &tc->words[tc->count++];
+    w->pos = pos;
+    w->len = len;
+    w->slot = -1;
+    if (tc->use_cache && len <= SPELL_KEY_MAX &&
+        (w->correct = spell_cache_lookup(lower, len, h)) >= 0) return;
+
+    int s = 0;
+    while (s < tc->batched && !(tc->batch_hash[s] == h && tc->batch_len[s] == len &&
+                                memcmp(tc->batch_lower[s], lower, len * sizeof(wchar_t)) == 0))
+        s++;
+    if (s == tc->batched) {
+        tc->batch[s] = word;
+        tc->batch_len[s] = len;
+        tc->batch_hash[s] = h;
+        memcpy(tc->batch_lower[s], lower, len * sizeof(wchar_t));
+        tc->batched++;
+    }
+    w->slot = s;
+}
+
+static void check_text(const wchar_t *text, bpos n, int use_cache, SpellErrorFn fn, void *ctx) {
+    TextCheck tc;
+    tc.text = text;
+    tc.use_cache = use_cache;
+    tc.fn = fn;
+    tc.ctx = ctx;
+    tc.count = tc.batched = 0;
+    bpos p = 0, wl;
+    while ((wl = speller_next_word(text, n, &p)) > 0) {
+        check_word(&tc, p, wl < SPELL_WORD_MAX ? (int)wl : SPELL_WORD_MAX);
+        p += wl;
+    }
+    check_flush(&tc);
+}
+
+/* Reports the misspelled words of text[0..n) through fn, in order. The
+ * backend sees each uncached word once per batch of SPELL_BATCH_WORDS,
+ * and its verdicts fill the cache. UI thread only. */
+void spell_check_text(const wchar_t *text, bpos n, SpellErrorFn fn, void *ctx) {
+    if (g_spell_loaded) check_text(text, n, 1, fn, ctx);
+}
+
+/* The same without the cache, for the pool. Reports nothing unless
+ * spell_backend_thread_safe(). */
+void spell_check_text_local(const wchar_t *text, bpos n, SpellErrorFn fn, void *ctx) {
+    if (spell_backend_thread_safe()) check_text(text, n, 0, fn, ctx);
+}
+
+static void note_error(void *ctx, ptrdiff_t start, ptrdiff_t len) {
+    *(int *)ctx = 0;
+}
+
+int spell_check(const wchar_t *word, int len) {
+    int correct = 1;
+    spell_check_text(word, len, note_error, &correct);
+    return correct;
+}
 
-    wchar_t lower[64];
-    if (len >= 64) return 1;
-    for (int i = 0; i < len; i++) lower[i] = towlower(word[i]);
-    lower[len] = 0;
+/* ── Suggestions ── */
 
-    int cached = spell_cache_lookup(lower, len);
-    if (cached >= 0) return cached;
+/* Gives a folded suggestion the capitalisation of the word it replaces */
+static void match_case(const wchar_t *word, int len, wchar_t *s) {
+    int upper = 0;
+    for (int i = 0; i < len; i++) upper += ch_isupper(word[i]) != 0;
+    if (len > 1 && upper == len) {
+        for (; *s; s++) *s = towupper(*s);
+    } else if (ch_isupper(word[0])) {
+        s[0] = towupper(s[0]);
+    }
+}
+
+/* Fills out[] with up to k corrections for word, best first, each
+ * NUL-terminated. Returns how many. */
+int spell_suggest(const wchar_t *word, int len, wchar_t (*out)[SPELL_WORD_MAX], int k) {
+    if (!g_spell_loaded || len <= 1 || len >= SPELL_WORD_MAX) return 0;
+    if (k > SPELL_SUGGEST_MAX) k = SPELL_SUGGEST_MAX;
+    int count = 0;
 
-    if (g_spell_checker) {
-        wchar_t tmp[64];
+    if (g_spell_dict) {
+        wchar_t lower[SPELL_WORD_MAX];
+        DictSuggestion found[SPELL_SUGGEST_MAX];
+        ch_fold_run(word, lower, len);
+        count = dict_suggest(g_spell_dict, lower, len, 2, found, k);
+        for (int i = 0; i < count; i++) {
+            memcpy(out[i], found[i].word, found[i].len * sizeof(wchar_t));
+            out[i][found[i].len] = 0;
+            match_case(word, len, out[i]);
+        }
+    } else if (g_spell_checker) {
+        wchar_t tmp[SPELL_WORD_MAX];
         memcpy(tmp, word, len * sizeof(wchar_t));
         tmp[len] = 0;
-
-        IEnumSpellingError *errors = NULL;
-        HRESULT hr = g_spell_checker->lpVtbl->Check(g_spell_checker, tmp, &errors);
-        if (SUCCEEDED(hr) && errors) {
-            ISpellingError *err = NULL;
-            hr = errors->lpVtbl->Next(errors, &err);
-            if (err) {
-                err->lpVtbl->Release(err);
-                errors->lpVtbl->Release(errors);
-                spell_cache_insert(lower, len, 0);
-                return 0;
+        IEnumString *list = NULL;
+        HRESULT hr = g_spell_checker->lpVtbl->Suggest(g_spell_checker, tmp, (void **)&list);
+        if (SUCCEEDED(hr) && list) {
+            LPWSTR str = NULL;
+            ULONG got = 0;
+            while (count < k && list->lpVtbl->Next(list, 1, &str, &got) == S_OK && got == 1) {
+                if (str) {
+                    safe_wcscpy(out[count++], SPELL_WORD_MAX, str);
+                    CoTaskMemFree(str);
+                }
+                str = NULL;
             }
-            errors->lpVtbl->Release(errors);
-            spell_cache_insert(lower, len, 1);
-            return 1;
+            list->lpVtbl->Release(list);
+        }
+    }
+    return count;
+}
+
+/* ── Dictionary files ── */
+
+static char *read_all(const wchar_t *path, size_t *out_len) {
+    HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER size;
+    char *data = NULL;
+    DWORD got = 0;
+    if (GetFileSizeEx(hFile, &size) && size.QuadPart < (LONGLONG)(64 * 1024 * 1024) &&
+        (data = (char *)malloc((size_t)size.QuadPart + 1)) != NULL &&
+        !ReadFile(hFile, data, (DWORD)size.QuadPart, &got, NULL)) {
+        free(data);
+        data = NULL;
+    }
+    CloseHandle(hFile);
+    if (data) *out_len = got;
+    return data;
+}
+
+/* Load en_US.dic, else the first *.dic, else words.txt from dir. A .dic
+ * with a matching .aff is read as Hunspell; anything else as a list. */
+static Dict *load_dict_from(const wchar_t *dir) {
+    wchar_t dic_path[MAX_PATH], aff_path[MAX_PATH];
+    swprintf(dic_path, MAX_PATH, L"%ls\\en_US.dic", dir);
+    if (GetFileAttributesW(dic_path) == INVALID_FILE_ATTRIBUTES) {
+        wchar_t pattern[MAX_PATH];
+        WIN32_FIND_DATAW fd;
+        swprintf(pattern, MAX_PATH, L"%ls\\*.dic", dir);
+        HANDLE hFind = FindFirstFileW(pattern, &fd);
+        if (hFind != INVALID_HANDLE_VALUE) {
+            swprintf(dic_path, MAX_PATH, L"%ls\\%ls", dir, fd.cFileName);
+            FindClose(hFind);
+        } else {
+            swprintf(dic_path, MAX_PATH, L"%ls\\words.txt", dir);
+        }
+    }
+
+    size_t dic_len = 0, aff_len = 0;
+    char *dic = read_all(dic_path, &dic_len);
+    if (!dic) return NULL;
+    char *aff = NULL;
+    wchar_t *ext = wcsrchr(dic_path, L'.');
+    if (ext && _wcsicmp(ext, L".dic") == 0) {
+        safe_wcscpy(aff_path, MAX_PATH, dic_path);
+        wcscpy(aff_path + (ext - dic_path), L".aff");
+        aff = read_all(aff_path, &aff_len);
+    }
+    Dict *d = dict_load(dic, dic_len, aff, aff_len, NULL);
+    if (d) {
+        g_spell_sig = fnv64(0xcbf29ce484222325ull, dic, dic_len);
+        if (aff) g_spell_sig = fnv64(g_spell_sig, aff, aff_len);
+    }
+    free(dic);
+    free(aff);
+    return d;
+}
+
+/* Looks beside the executable, then in %LOCALAPPDATA%\ProseCode. */
+static Dict *load_dict(void) {
+    wchar_t dir[MAX_PATH];
+    DWORD n = GetModuleFileNameW(NULL, dir, MAX_PATH);
+    if (n > 0 && n < MAX_PATH) {
+        wchar_t *slash = wcsrchr(dir, L'\\');
+        if (slash) {
+            wcscpy(slash, L"\\dict");
+            Dict *d = load_dict_from(dir);
+            if (d) return d;
         }
-        if (errors) errors->lpVtbl->Release(errors);
     }
+    wchar_t appdata[MAX_PATH];
+    if (GetEnvironmentVariableW(L"LOCALAPPDATA", appdata, MAX_PATH) == 0) return NULL;
+    swprintf(dir, MAX_PATH, L"%ls\\ProseCode\\dict", appdata);
+    return load_dict_from(dir);
+}
+
+/* ── Persistent cache ──
+ * At exit the table is written to %LOCALAPPDATA%\ProseCode\spell.cache,
+ * and the next session maps that file copy-on-write and uses it in
+ * place, without parsing or copying it. spell_cache_valid does read
+ * every slot once at startup, so the whole view is paged in then; only
+ * the pages that later lookups write to are copied. The header records
+ * the backend signature; another dictionary or language discards the
+ * file. */
+
+#define SPELL_FILE_MAGIC   0x43534350u   /* "PCSC" */
+#define SPELL_FILE_VERSION 1
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int slots;
+    unsigned int slot_size;
+    unsigned long long backend;
+    unsigned int count;
+    unsigned int reserved;
+} SpellFileHeader;
 
+static HANDLE g_spell_map = NULL;
+static void  *g_spell_view = NULL;
+
+static int spell_cache_path(wchar_t *out) {
+    wchar_t appdata[MAX_PATH];
+    if (GetEnvironmentVariableW(L"LOCALAPPDATA", appdata, MAX_PATH) == 0) return 0;
+    swprintf(out, MAX_PATH, L"%ls\\ProseCode\\spell.cache", appdata);
     return 1;
 }
 
+static void spell_cache_unmap(void) {
+    if (g_spell_view) UnmapViewOfFile(g_spell_view);
+    if (g_spell_map) CloseHandle(g_spell_map);
+    g_spell_view = NULL;
+    g_spell_map = NULL;
+    g_spell_cache = g_spell_table;
+}
+
+/* A table from disk is only used if every entry could have been made
+ * by spell_cache_insert, so a damaged file cannot break probing. */
+static int spell_cache_valid(const SpellSlot *slots, unsigned int *count) {
+    unsigned int n = 0;
+    for (int i = 0; i < SPELL_CACHE_SLOTS; i++) {
+        if (!slots[i].hash) continue;
+        if (slots[i].len == 0 || slots[i].len > SPELL_KEY_MAX || slots[i].correct > 1) return 0;
+        n++;
+    }
+    *count = n;
+    return n <= SPELL_CACHE_MAX;
+}
+
+static void spell_cache_map(void) {
+    wchar_t path[MAX_PATH];
+    if (!spell_cache_path(path)) return;
+    HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER size;
+    size_t want = sizeof(SpellFileHeader) + sizeof(SpellSlot) * SPELL_CACHE_SLOTS;
+    if (GetFileSizeEx(hFile, &size) && size.QuadPart == (LONGLONG)want)
+        g_spell_map = CreateFileMappingW(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!g_spell_map) return;
+    g_spell_view = MapViewOfFile(g_spell_map, FILE_MAP_COPY, 0, 0, 0);
+
+    const SpellFileHeader *hdr = (const SpellFileHeader *)g_spell_view;
+    SpellSlot *slots = (SpellSlot *)(hdr + 1);
+    unsigned int count = 0;
+    if (!hdr || hdr->magic != SPELL_FILE_MAGIC || hdr->version != SPELL_FILE_VERSION ||
+        hdr->slots != SPELL_CACHE_SLOTS || hdr->slot_size != sizeof(SpellSlot) ||
+        hdr->backend != g_spell_sig || !spell_cache_valid(slots, &count)) {
+        spell_cache_unmap();
+        return;
+    }
+    g_spell_cache = slots;
+    g_spell_stats.count = count;
+    g_spell_dirty = 0;
+}
+
+/* Write the table back for the next session; called before
+ * spell_cache_free at exit. */
+void spell_cache_save(void) {
+    wchar_t path[MAX_PATH], tmp_path[MAX_PATH + 16];
+    if (!g_spell_loaded || !g_spell_dirty || !spell_cache_path(path)) return;
+    swprintf(tmp_path, MAX_PATH + 16, L"%ls.tmp~", path);
+
+    autosave_ensure_dir();
+    HANDLE hFile = CreateFileW(tmp_path, GENERIC_WRITE, 0, NULL,
+                               CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return;
+
+    SpellFileHeader hdr = { SPELL_FILE_MAGIC, SPELL_FILE_VERSION, SPELL_CACHE_SLOTS,
+                            sizeof(SpellSlot), g_spell_sig, (unsigned int)g_spell_stats.count, 0 };
+    DWORD want = (DWORD)(sizeof(SpellSlot) * SPELL_CACHE_SLOTS);
+    DWORD written = 0, written_slots = 0;
+    BOOL ok = WriteFile(hFile, &hdr, sizeof(hdr), &written, NULL) && written == sizeof(hdr) &&
+              WriteFile(hFile, g_spell_cache, want, &written_slots, NULL) && written_slots == want;
+    CloseHandle(hFile);
+
+    /* The old file cannot be replaced while it is mapped */
+    if (ok && g_spell_view) {
+        memcpy(g_spell_table, g_spell_cache, sizeof(g_spell_table));
+        spell_cache_unmap();
+    }
+    if (!ok || !MoveFileExW(tmp_path, path, MOVEFILE_REPLACE_EXISTING))
+        DeleteFileW(tmp_path);
+    else
+        g_spell_dirty = 0;
+}
+
 void spell_init(void) {
-    memset(g_spell_cache, 0, sizeof(g_spell_cache));
+    memset(g_spell_table, 0, sizeof(g_spell_table));
 
+    g_spell_dict = load_dict();
+    if (g_spell_dict) {
+        speller_dict_backend(&g_dict_backend, g_spell_dict);
+        g_spell_backend = &g_dict_backend.base;
+        g_spell_loaded = 1;
+        spell_cache_map();
+        return;
+    }
+
+    /* No dictionary installed: fall back to the Windows spell checker */
     ISpellCheckerFactory *factory = NULL;
     HRESULT hr = CoCreateInstance(
         &CLSID_SpellCheckerFactory, NULL, CLSCTX_INPROC_SERVER,
@@ -114,12 +522,16 @@ void spell_init(void) {
 
     if (SUCCEEDED(hr) && factory) {
         BOOL supported = FALSE;
-        factory->lpVtbl->IsSupported(factory, L"en-US", &supported);
+        factory->lpVtbl->IsSupported(factory, SPELL_LANG, &supported);
 
         if (supported) {
-            hr = factory->lpVtbl->CreateSpellChecker(factory, L"en-US", &g_spell_checker);
+            hr = factory->lpVtbl->CreateSpellChecker(factory, SPELL_LANG, &g_spell_checker);
             if (SUCCEEDED(hr) && g_spell_checker) {
+                g_spell_backend = &g_com_backend;
+                g_spell_sig = fnv64(0xcbf29ce484222325ull, L"com:" SPELL_LANG,
+                                    sizeof(L"com:" SPELL_LANG));
                 g_spell_loaded = 1;
+                spell_cache_map();
             }
         }
         factory->lpVtbl->Release(factory);
@@ -130,16 +542,16 @@ void spell_init(void) {
     }
 }
 
+void spell_dict_free(void) {
+    g_spell_backend = NULL;
+    g_spell_loaded = 0;
+    dict_free(g_spell_dict);
+    g_spell_dict = NULL;
+}
+
 void spell_cache_free(void) {
-    for (int i = 0; i < SPELL_CACHE_BUCKETS; i++) {
-        SpellCacheNode *n = g_spell_cache[i];
-        while (n) {
-            SpellCacheNode *next = n->next;
-            free(n->word);
-            free(n);
-            n = next;
-        }
-        g_spell_cache[i] = NULL;
-    }
-    g_spell_cache_count = 0;
+    spell_cache_unmap();
+    memset(g_spell_table, 0, sizeof(g_spell_table));
+    memset(&g_spell_stats, 0, sizeof(g_spell_stats));
+    g_spell_hand = 0;
 }
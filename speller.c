@@ -0,0 +1,106 @@
+/*
+ * speller.c — Batched spell checking over a pluggable backend
+ *
+ * A batch is the words joined by single spaces. Their start offsets are
+ * recorded while joining, so each range the backend reports is mapped
+ * back by binary search to every word it overlaps.
+ */
+#include "speller.h"
+#include "chartab.h"
+#include <string.h>
+
+/* ── Words ── */
+
+static int is_word_char(wchar_t c) {
+    return ch_isalpha(c) || c == L'\'';
+}
+
+ptrdiff_t speller_next_word(const wchar_t *text, ptrdiff_t n, ptrdiff_t *pos) {
+    ptrdiff_t i = *pos;
+    while (i < n && !is_word_char(text[i])) i++;
+    ptrdiff_t s = i;
+    while (i < n && is_word_char(text[i])) i++;
+    *pos = s;
+    return i - s;
+}
+
+int speller_skip(const wchar_t *word, ptrdiff_t len) {
+    if (len <= 1 || len >= SPELL_WORD_MAX) return 1;
+    for (ptrdiff_t i = 0; i < len; i++) {
+        if (ch_isdigit(word[i])) return 1;
+    }
+    return 0;
+}
+
+/* ── Dictionary backend ── */
+
+static int dict_word_ok(const Dict *d, const wchar_t *word, ptrdiff_t len) {
+    wchar_t lower[SPELL_WORD_MAX];
+    ch_fold_run(word, lower, len);
+    /* Quotes around a word are not part of it */
+    ptrdiff_t s = 0, e = len;
+    while (s < e && lower[s] == L'\'') s++;
+    while (e > s && lower[e - 1] == L'\'') e--;
+    return e - s <= 1 || dict_lookup(d, lower + s, e - s);
+}
+
+static int dict_backend_check(SpellBackend *self, const wchar_t *text, ptrdiff_t len,
+                              SpellErrorFn fn, void *ctx) {
+    const Dict *d = ((DictBackend *)self)->dict;
+    ptrdiff_t p = 0, wl;
+    while ((wl = speller_next_word(text, len, &p)) > 0) {
+        if (!speller_skip(text + p, wl) && !dict_word_ok(d, text + p, wl)) fn(ctx, p, wl);
+        p += wl;
+    }
+    return 1;
+}
+
+void speller_dict_backend(DictBackend *b, const Dict *dict) {
+    b->base.check = dict_backend_check;
+    b->base.thread_safe = 1;
+    b->dict = dict;
+}
+
+/* ── Batches ── */
+
+typedef struct {
+    const ptrdiff_t *starts;
+    const int *lens;
+    int n;
+    unsigned char *ok;
+} BatchMap;
+
+static void batch_error(void *ctx, ptrdiff_t start, ptrdiff_t len) {
+    BatchMap *m = (BatchMap *)ctx;
+    ptrdiff_t end = start + (len > 0 ? len : 1);
+    /* First word ending after start */
+    int lo = 0, hi = m->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m->starts[mid] + m->lens[mid] <= start) lo = mid + 1;
+        else hi = mid;
+    }
+    for (int i = lo; i < m->n && m->starts[i] < end; i++) m->ok[i] = 0;
+}
+
+int speller_batch(SpellBackend *b, const wchar_t *const *words, const int *lens, int n,
+                  unsigned char *ok) {
+    wchar_t text[SPELL_BATCH_CHARS + 1];
+    ptrdiff_t starts[SPELL_BATCH_WORDS];
+    ptrdiff_t len = 0;
+    if (n <= 0 || n > SPELL_BATCH_WORDS) return 0;
+    for (int i = 0; i < n; i++) {
+        if (i > 0) text[len++] = L' ';
+        starts[i] = len;
+        memcpy(text + len, words[i], lens[i] * sizeof(wchar_t));
+        len += lens[i];
+    }
+    text[len] = 0;
+
+    unsigned char verdict[SPELL_BATCH_WORDS];
+    memset(verdict, 1, n);
+    BatchMap m = { starts, lens, n, verdict };
+    if (!b->check(b, text, len, batch_error, &m)) return 0;
+    memcpy(ok, verdict, n);
+    return 1;
+}
@@ -0,0 +1,58 @@
+/*
+ * speller.h — Pluggable spell checker backends and batched checking
+ * Portable C with no Win32 dependencies.
+ *
+ * A backend checks a run of text and reports the misspelled ranges in
+ * it, the way ISpellChecker::Check does. speller_batch joins many words
+ * into one such call and maps the reported ranges back to the words, so
+ * an expensive backend is called once per line rather than once per
+ * word. The dictionary backend here runs in-process on any platform,
+ * which also makes it a stand-in for the Windows checker.
+ */
+#ifndef PROSE_SPELLER_H
+#define PROSE_SPELLER_H
+
+#include <stddef.h>
+#include <wchar.h>
+#include "dict.h"
+
+#define SPELL_WORD_MAX    64     /* longer words are never checked */
+#define SPELL_BATCH_WORDS 128
+#define SPELL_BATCH_CHARS (SPELL_BATCH_WORDS * SPELL_WORD_MAX)
+
+typedef void (*SpellErrorFn)(void *ctx, ptrdiff_t start, ptrdiff_t len);
+
+typedef struct SpellBackend SpellBackend;
+struct SpellBackend {
+    /* Reports every misspelled range of text[0..len), which is
+     * NUL-terminated. Returns 0 if the text could not be checked. */
+    int (*check)(SpellBackend *self, const wchar_t *text, ptrdiff_t len,
+                 SpellErrorFn fn, void *ctx);
+    int thread_safe;     /* check may run on any thread */
+};
+
+/* Checks words against a loaded dictionary */
+typedef struct {
+    SpellBackend base;
+    const Dict *dict;
+} DictBackend;
+
+void speller_dict_backend(DictBackend *b, const Dict *dict);
+
+/* Finds the next word (a run of letters and apostrophes) at or after
+ * *pos in text[0..n). Returns its length with *pos at its start, or 0
+ * when there are no more words. */
+ptrdiff_t speller_next_word(const wchar_t *text, ptrdiff_t n, ptrdiff_t *pos);
+
+/* 1 for words that are never flagged: single letters, words of
+ * SPELL_WORD_MAX or more and anything containing a digit. */
+int speller_skip(const wchar_t *word, ptrdiff_t len);
+
+/* Checks n words (0 < n <= SPELL_BATCH_WORDS, each shorter than
+ * SPELL_WORD_MAX) in one backend call, setting ok[i] to 1 if words[i]
+ * is spelled correctly and 0 if not. Returns 0, leaving ok[] unset, if
+ * the backend failed. */
+int speller_batch(SpellBackend *b, const wchar_t *const *words, const int *lens, int n,
+                  unsigned char *ok);
+
+#endif /* PROSE_SPELLER_H */
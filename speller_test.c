@@ -0,0 +1,139 @@
+/*
+ * speller_test.c — Native check of speller_batch's range mapping
+ *
+ *   make test             (uses HOSTCC, defaults to cc)
+ *   ./speller_test
+ *
+ * A stub backend reports scripted ranges of the joined batch, the way
+ * ISpellChecker::Check may: ranges spanning several words, ranges that
+ * start or end inside a word or on the separator, and one range per
+ * occurrence of a repeated word. Each case lists the verdicts expected
+ * for its words.
+ */
+#include "speller.h"
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#define MAX_RANGES 8
+
+typedef struct {
+    SpellBackend base;
+    const ptrdiff_t *ranges;     /* start, len pairs */
+    int nranges;
+    int fail;
+    wchar_t seen[SPELL_BATCH_CHARS + 1];
+} StubBackend;
+
+static int stub_check(SpellBackend *self, const wchar_t *text, ptrdiff_t len,
+                      SpellErrorFn fn, void *ctx) {
+    StubBackend *b = (StubBackend *)self;
+    wcsncpy(b->seen, text, SPELL_BATCH_CHARS);
+    b->seen[len < SPELL_BATCH_CHARS ? len : SPELL_BATCH_CHARS] = 0;
+    if (b->fail) return 0;
+    for (int i = 0; i < b->nranges; i++) fn(ctx, b->ranges[2 * i], b->ranges[2 * i + 1]);
+    return 1;
+}
+
+typedef struct {
+    const char *name;
+    const wchar_t *words[6];
+    const wchar_t *joined;
+    ptrdiff_t ranges[2 * MAX_RANGES];
+    int nranges;
+    const char *expect;          /* '1' correct, '0' flagged, per word */
+} Case;
+
+static const Case CASES[] = {
+    /* "one two three": offsets 0, 4, 8 */
+    { "no errors",            { L"one", L"two", L"three" }, L"one two three",
+      { 0 }, 0, "111" },
+    { "exact word",           { L"one", L"two", L"three" }, L"one two three",
+      { 4, 3 }, 1, "101" },
+    { "range over two words", { L"one", L"two", L"three" }, L"one two three",
+      { 0, 7 }, 1, "001" },
+    { "range over all words", { L"one", L"two", L"three" }, L"one two three",
+      { 0, 13 }, 1, "000" },
+    { "starts inside a word", { L"one", L"two", L"three" }, L"one two three",
+      { 5, 1 }, 1, "101" },
+    { "ends inside the next", { L"one", L"two", L"three" }, L"one two three",
+      { 2, 3 }, 1, "001" },
+    { "separator only",       { L"one", L"two", L"three" }, L"one two three",
+      { 3, 1 }, 1, "111" },
+    { "empty range",          { L"one", L"two", L"three" }, L"one two three",
+      { 8, 0 }, 1, "110" },
+    { "last character",       { L"one", L"two", L"three" }, L"one two three",
+      { 12, 1 }, 1, "110" },
+    /* "teh the teh": each occurrence is reported on its own */
+    { "repeated, both",       { L"teh", L"the", L"teh" }, L"teh the teh",
+      { 0, 3, 8, 3 }, 2, "010" },
+    { "repeated, first only", { L"teh", L"the", L"teh" }, L"teh the teh",
+      { 0, 3 }, 1, "011" },
+    { "repeated, out of order", { L"teh", L"the", L"teh" }, L"teh the teh",
+      { 8, 3, 0, 3 }, 2, "010" },
+    { "same range twice",     { L"teh", L"the", L"teh" }, L"teh the teh",
+      { 4, 3, 4, 3 }, 2, "101" },
+};
+
+static int run_case(const Case *c) {
+    const wchar_t *const *words = c->words;
+    int lens[6], n = 0;
+    while (n < 6 && words[n]) {
+        lens[n] = (int)wcslen(words[n]);
+        n++;
+    }
+    StubBackend b;
+    memset(&b, 0, sizeof(b));
+    b.base.check = stub_check;
+    b.ranges = c->ranges;
+    b.nranges = c->nranges;
+
+    unsigned char ok[6];
+    memset(ok, 2, sizeof(ok));
+    if (!speller_batch(&b.base, words, lens, n, ok)) {
+        printf("  FAIL %s: batch failed\n", c->name);
+        return 1;
+    }
+    char got[7];
+    for (int i = 0; i < n; i++) got[i] = ok[i] == 1 ? '1' : ok[i] == 0 ? '0' : '?';
+    got[n] = 0;
+    if (wcscmp(b.seen, c->joined) != 0 || strcmp(got, c->expect) != 0) {
+        printf("  FAIL %s: joined \"%ls\", verdicts %s, expected \"%ls\", %s\n",
+               c->name, b.seen, got, c->joined, c->expect);
+        return 1;
+    }
+    return 0;
+}
+
+/* A failed check or an out-of-range count leaves ok[] as it was */
+static int run_errors(void) {
+    const wchar_t *words[] = { L"one", L"two" };
+    int lens[] = { 3, 3 };
+    unsigned char ok[2] = { 7, 7 };
+    StubBackend b;
+    memset(&b, 0, sizeof(b));
+    b.base.check = stub_check;
+    b.fail = 1;
+    int failed = 0;
+    if (speller_batch(&b.base, words, lens, 2, ok) || ok[0] != 7 || ok[1] != 7) {
+        printf("  FAIL backend failure: verdicts were written\n");
+        failed++;
+    }
+    b.fail = 0;
+    if (speller_batch(&b.base, words, lens, 0, ok) ||
+        speller_batch(&b.base, words, lens, SPELL_BATCH_WORDS + 1, ok) || ok[0] != 7) {
+        printf("  FAIL batch size: out-of-range count accepted\n");
+        failed++;
+    }
+    return failed;
+}
+
+int main(void) {
+    int n = (int)(sizeof(CASES) / sizeof(CASES[0]));
+    int failed = 0;
+    for (int i = 0; i < n; i++) failed += run_case(&CASES[i]);
+    int errors = run_errors();
+    printf("speller_batch: %d/%d cases passed, %d error checks failed\n",
+           n - failed, n, errors);
+    return failed || errors ? 1 : 0;
+}
@@ -0,0 +1,498 @@
+#include "prose_code.h"
+
+/* ── Background spell checking ──
+ * Each document keeps its misspellings as a sorted list of absolute
+ * ranges (doc->spell), which the renderer draws and F8 walks. A pass
+ * over a snapshot fills the list; from then on the buffer edit hook
+ * keeps it current, shifting later ranges and re-checking only the
+ * lines the edit touched. Words never span a line break.
+ *
+ * Per-line results are also cached by a hash of the line's content,
+ * shared by all documents, so a pass only checks lines it has never
+ * seen: reopening a file or undoing an edit is nearly free. With a local
+ * dictionary the pass runs on the pool. The COM checker must stay on the
+ * UI thread, so without a dictionary the pass runs there instead, in
+ * slices of SPELL_SLICE_LINES lines; each line's uncached words reach
+ * it as one batched call. */
+
+typedef void (*SpellCheckFn)(const wchar_t *text, bpos n, SpellErrorFn fn, void *ctx);
+
+typedef struct {
+    bpos *pos;
+    int  *len;
+    int count;
+    int cap;
+} SpellFound;
+
+typedef struct {
+    DocSnapshot *snap;
+    Document *doc;
+    unsigned int doc_id;
+    LONG gen;
+    int on_ui;          /* COM checker: slices on the UI thread */
+    bpos next;          /* where the next slice resumes */
+    int failed;
+    SpellFound found;
+} SpellJob;
+
+/* Line cache entry; ranges are (column, length) pairs in g_line_ranges */
+typedef struct {
+    unsigned long long hash;   /* 0 = empty */
+    bpos len;
+    int first, count;
+} SpellLine;
+
+static SpellLine *g_lines;
+static int g_line_count;
+static int *g_line_ranges;
+static int g_range_count, g_range_cap;
+static CRITICAL_SECTION g_line_lock;
+
+static volatile LONG g_spell_gen;
+
+static int found_push(SpellFound *f, bpos pos, int len) {
+    if (f->count >= f->cap) {
+        int ncap = f->cap ? f->cap * 2 : 256;
+        bpos *p = (bpos *)realloc(f->pos, ncap * sizeof(bpos));
+        if (!p) return 0;
+        f->pos = p;
+        int *l = (int *)realloc(f->len, ncap * sizeof(int));
+        if (!l) return 0;
+        f->len = l;
+        f->cap = ncap;
+    }
+    f->pos[f->count] = pos;
+    f->len[f->count] = len;
+    f->count++;
+    return 1;
+}
+
+static void found_free(SpellFound *f) {
+    free(f->pos);
+    free(f->len);
+}
+
+/* ── Line cache ── */
+
+static unsigned long long line_hash(const wchar_t *line, bpos n) {
+    unsigned long long h = 0xcbf29ce484222325ull;
+    for (bpos i = 0; i < n; i++) {
+        h ^= (unsigned short)line[i];
+        h *= 0x100000001b3ull;
+    }
+    return h ? h : 1;
+}
+
+/* Appends a cached line's misspellings, offset by base. Returns 1 on a
+ * hit, 0 on a miss and -1 if out of memory. */
+static int line_cache_get(unsigned long long h, bpos n, bpos base, SpellFound *out) {
+    int result = 0;
+    EnterCriticalSection(&g_line_lock);
+    for (unsigned i = (unsigned)h & (SPELL_LINE_SLOTS - 1); g_lines && g_lines[i].hash;
+         i = (i + 1) & (SPELL_LINE_SLOTS - 1)) {
+        SpellLine *e = &g_lines[i];
+        if (e->hash != h || e->len != n) continue;
+        result = 1;
+        for (int k = 0; k < e->count && result > 0; k++) {
+            const int *r = &g_line_ranges[2 * (e->first + k)];
+            if (!found_push(out, base + r[0], r[1])) result = -1;
+        }
+        break;
+    }
+    LeaveCriticalSection(&g_line_lock);
+    return result;
+}
+
+static void line_cache_put(unsigned long long h, bpos n, const SpellFound *f, int first, bpos base) {
+    int count = f->count - first;
+    EnterCriticalSection(&g_line_lock);
+    if (!g_lines) g_lines = (SpellLine *)calloc(SPELL_LINE_SLOTS, sizeof(SpellLine));
+    /* A full cache is simply emptied; live lines come straight back */
+    if (g_line_count >= SPELL_LINE_SLOTS * 3 / 4 || g_range_count + count > SPELL_LINE_RANGES) {
+        if (g_lines) memset(g_lines, 0, SPELL_LINE_SLOTS * sizeof(SpellLine));
+        g_line_count = 0;
+        g_range_count = 0;
+    }
+    if (g_range_count + count > g_range_cap) {
+        int ncap = g_range_cap ? g_range_cap * 2 : 4096;
+        while (ncap < g_range_count + count) ncap *= 2;
+        int *nr = (int *)realloc(g_line_ranges, ncap * 2 * sizeof(int));
+        if (!nr) { LeaveCriticalSection(&g_line_lock); return; }
+        g_line_ranges = nr;
+        g_range_cap = ncap;
+    }
+    if (g_lines) {
+        unsigned i = (unsigned)h & (SPELL_LINE_SLOTS - 1);
+        while (g_lines[i].hash && !(g_lines[i].hash == h && g_lines[i].len == n))
+            i = (i + 1) & (SPELL_LINE_SLOTS - 1);
+        if (!g_lines[i].hash) g_line_count++;
+        SpellLine *e = &g_lines[i];
+        e->hash = h;
+        e->len = n;
+        e->first = g_range_count;
+        e->count = count;
+        for (int k = 0; k < count; k++) {
+            g_line_ranges[2 * (g_range_count + k)] = (int)(f->pos[first + k] - base);
+            g_line_ranges[2 * (g_range_count + k) + 1] = f->len[first + k];
+        }
+        g_range_count += count;
+    }
+    LeaveCriticalSection(&g_line_lock);
+}
+
+/* ── Checking ── */
+
+typedef struct {
+    SpellFound *out;
+    bpos base;
+    int ok;
+} LineFound;
+
+static void line_error(void *ctx, ptrdiff_t start, ptrdiff_t len) {
+    LineFound *lf = (LineFound *)ctx;
+    if (lf->ok && !found_push(lf->out, lf->base + start, (int)len)) lf->ok = 0;
+}
+
+/* Append the misspellings of one line starting at base. */
+static int check_line(const wchar_t *line, bpos n, bpos base, SpellCheckFn check, SpellFound *out) {
+    unsigned long long h = line_hash(line, n);
+    int hit = line_cache_get(h, n, base, out);
+    if (hit != 0) return hit > 0;
+
+    int first = out->count;
+    LineFound lf = { out, base, 1 };
+    check(line, n, line_error, &lf);
+    if (!lf.ok) return 0;
+    if (n <= SPELL_LINE_CACHE_LEN) line_cache_put(h, n, out, first, base);
+    return 1;
+}
+
+/* Check up to max_lines lines of the snapshot. Returns 1 when done. */
+static int run_job(SpellJob *job, bpos max_lines, SpellCheckFn check) {
+    const wchar_t *text = job->snap->text;
+    bpos len = job->snap->len;
+    bpos p = job->next;
+    for (bpos lines = 0; p <= len && lines < max_lines; lines++) {
+        if ((lines & 1023) == 0 && g_spell_gen != job->gen) { job->failed = 1; return 1; }
+        const wchar_t *nl = p < len ? wmemchr(text + p, L'\n', len - p) : NULL;
+        bpos e = nl ? nl - text : len;
+        if (!check_line(text + p, e - p, p, check, &job->found)) { job->failed = 1; return 1; }
+        p = e + 1;
+    }
+    job->next = p;
+    return p > len;
+}
+
+static void spell_worker(void *param) {
+    SpellJob *job = (SpellJob *)param;
+    run_job(job, (bpos)1 << 62, spell_check_text_local);
+    if (!PostMessageW(g_editor.hwnd, WM_SPELL_RESULTS, 0, (LPARAM)job)) {
+        snapshot_release(job->snap);
+        found_free(&job->found);
+        free(job);
+    }
+}
+
+static void spell_start(Document *doc) {
+    SpellJob *job = (SpellJob *)calloc(1, sizeof(SpellJob));
+    if (!job) return;
+    job->snap = doc_snapshot(doc);
+    if (!job->snap) { free(job); return; }
+    job->doc = doc;
+    job->doc_id = doc->autosave_id;
+    job->gen = g_spell_gen;
+    job->on_ui = !spell_backend_thread_safe();
+    if (!job->on_ui) {
+        pool_submit(spell_worker, job);
+    } else if (!PostMessageW(g_editor.hwnd, WM_SPELL_RESULTS, 0, (LPARAM)job)) {
+        snapshot_release(job->snap);
+        free(job);
+        return;
+    }
+    doc->spell.scanning = 1;
+}
+
+static Document *spell_find_doc(Document *doc, unsigned int doc_id) {
+    for (int i = 0; i < g_editor.tab_count; i++)
+        if (g_editor.tabs[i] == doc && doc->autosave_id == doc_id) return doc;
+    return NULL;
+}
+
+void spell_on_results(LPARAM lParam) {
+    SpellJob *job = (SpellJob *)lParam;
+    Document *doc = spell_find_doc(job->doc, job->doc_id);
+
+    if (doc && job->on_ui && !job->failed && job->gen == g_spell_gen &&
+        doc->gb.mutation == job->snap->mutation && !run_job(job, SPELL_SLICE_LINES, spell_check_text)) {
+        /* Yield to input and painting before the next slice */
+        if (PostMessageW(g_editor.hwnd, WM_SPELL_RESULTS, 0, lParam)) return;
+        job->failed = 1;
+    }
+
+    if (doc) {
+        doc->spell.scanning = 0;
+        if (!job->failed && job->gen == g_spell_gen && doc->gb.mutation == job->snap->mutation) {
+            SpellMarks *sm = &doc->spell;
+            free(sm->pos);
+            free(sm->len);
+            sm->pos = job->found.pos;
+            sm->len = job->found.len;
+            sm->count = job->found.count;
+            sm->cap = job->found.cap;
+            sm->ready = 1;
+            job->found.pos = NULL;
+            job->found.len = NULL;
+        }
+        /* Otherwise the text changed under the pass; spell_sync_doc
+         * starts another, which the line cache makes cheap. */
+    }
+    snapshot_release(job->snap);
+    found_free(&job->found);
+    free(job);
+}
+
+/* Called before painting: start a pass for the current tab if its
+ * misspelling list is missing and its text is all in. */
+void spell_sync_doc(void) {
+    Document *doc = current_doc();
+    if (!doc || doc->loading || doc->mode != MODE_PROSE || !g_spell_loaded || !g_editor.spellcheck_enabled) return;
+    if (!doc->spell.ready && !doc->spell.scanning) spell_start(doc);
+}
+
+/* First mark at or after pos */
+int spell_marks_lower_bound(const SpellMarks *sm, bpos pos) {
+    int lo = 0, hi = sm->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (sm->pos[mid] < pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void spell_marks_clear(SpellMarks *sm) {
+    free(sm->pos);
+    free(sm->len);
+    sm->pos = NULL;
+    sm->len = NULL;
+    sm->count = sm->cap = 0;
+    sm->ready = 0;
+}
+
+void spell_marks_free(SpellMarks *sm) {
+    spell_marks_clear(sm);
+}
+
+void spell_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted) {
+    SpellMarks *sm = &doc->spell;
+    spell_suggest_close();
+    if (!sm->ready) return;
+    if (removed > SPELL_MAX_PATCH || inserted > SPELL_MAX_PATCH) {
+        spell_marks_clear(sm);
+        return;
+    }
+
+    /* Widen the edit to whole lines, in post-edit coordinates */
+    GapBuffer *gb = &doc->gb;
+    bpos len = gb_length(gb);
+    bpos ls = pos, le = pos + inserted;
+    while (ls > 0 && gb_char_at(gb, ls - 1) != L'\n') ls--;
+    while (le < len && gb_char_at(gb, le) != L'\n') le++;
+    bpos delta = inserted - removed;
+
+    SpellFound found = { 0 };
+    wchar_t *text = le > ls ? gb_extract_alloc(gb, ls, le - ls) : NULL;
+    int ok = le == ls || text != NULL;
+    for (bpos p = 0; ok && p <= le - ls; ) {
+        bpos e = p;
+        while (e < le - ls && text[e] != L'\n') e++;
+        ok = check_line(text + p, e - p, ls + p, spell_check_text, &found);
+        p = e + 1;
+    }
+    free(text);
+
+    /* Old marks in [a, b) started on the edited lines */
+    int a = spell_marks_lower_bound(sm, ls);
+    int b = spell_marks_lower_bound(sm, le - delta + 1);
+    int k = found.count;
+    int total = sm->count - (b - a) + k;
+    if (ok && total > sm->cap) {
+        int ncap = sm->cap ? sm->cap : 256;
+        while (ncap < total) ncap *= 2;
+        bpos *np = (bpos *)realloc(sm->pos, ncap * sizeof(bpos));
+        if (np) sm->pos = np;
+        int *nl = np ? (int *)realloc(sm->len, ncap * sizeof(int)) : NULL;
+        if (nl) { sm->len = nl; sm->cap = ncap; }
+        ok = nl != NULL;
+    }
+    if (!ok) {
+        found_free(&found);
+        spell_marks_clear(sm);
+        return;
+    }
+
+    int tail = sm->count - b;
+    memmove(sm->pos + a + k, sm->pos + b, tail * sizeof(bpos));
+    memmove(sm->len + a + k, sm->len + b, tail * sizeof(int));
+    for (int i = a + k; i < total; i++) sm->pos[i] += delta;
+    memcpy(sm->pos + a, found.pos, k * sizeof(bpos));
+    memcpy(sm->len + a, found.len, k * sizeof(int));
+    sm->count = total;
+    found_free(&found);
+}
+
+void spell_toggle(void) {
+    g_editor.spellcheck_enabled = !g_editor.spellcheck_enabled;
+    if (!g_editor.spellcheck_enabled) {
+        InterlockedIncrement(&g_spell_gen);
+        for (int i = 0; i < g_editor.tab_count; i++) spell_marks_clear(&g_editor.tabs[i]->spell);
+    }
+}
+
+/* Select the next (dir > 0) or previous misspelling, wrapping around. */
+void spell_goto_next(int dir) {
+    Document *doc = current_doc();
+    if (!doc || doc->spell.count == 0) return;
+    SpellMarks *sm = &doc->spell;
+    int i;
+    if (dir > 0) {
+        i = spell_marks_lower_bound(sm, doc->cursor);
+        if (i < sm->count && sm->pos[i] == doc->cursor && has_selection(doc)) i++;
+        if (i >= sm->count) i = 0;
+    } else {
+        bpos from = has_selection(doc) ? selection_start(doc) : doc->cursor;
+        i = spell_marks_lower_bound(sm, from) - 1;
+        if (i < 0) i = sm->count - 1;
+    }
+    doc->sel_anchor = sm->pos[i];
+    doc->cursor = sm->pos[i] + sm->len[i];
+    editor_ensure_cursor_visible();
+}
+
+/* ── Suggestions ──
+ * A popup under a misspelled word lists its corrections; picking one
+ * replaces the word. Any edit closes it, since the range would be
+ * stale. */
+
+static int is_word_char(wchar_t c) {
+    return ch_isalpha(c) || c == L'\'';
+}
+
+/* Open the popup for the word at or just before pos, if misspelled. */
+void spell_suggest_at(bpos pos) {
+    SuggestState *st = &g_editor.suggest;
+    Document *doc = current_doc();
+    st->open = 0;
+    if (!doc || !g_spell_loaded) return;
+
+    GapBuffer *gb = &doc->gb;
+    bpos len = gb_length(gb), s = pos, e = pos;
+    while (s > 0 && is_word_char(gb_char_at(gb, s - 1))) s--;
+    while (e < len && is_word_char(gb_char_at(gb, e))) e++;
+    while (s < e && gb_char_at(gb, s) == L'\'') s++;
+    while (e > s && gb_char_at(gb, e - 1) == L'\'') e--;
+    if (e - s < 2 || e - s >= SPELL_WORD_MAX) return;
+
+    wchar_t word[SPELL_WORD_MAX];
+    gb_copy_range(gb, s, e - s, word);
+    if (spell_check(word, (int)(e - s))) return;
+
+    st->count = spell_suggest(word, (int)(e - s), st->words, SPELL_SUGGEST_MAX);
+    st->hover = st->count > 0 ? 0 : -1;
+    st->pos = s;
+    st->len = (int)(e - s);
+    pos_to_point(s, &st->x, &st->y);
+    st->y += g_editor.line_height;
+    st->open = 1;
+}
+
+/* Popup bounds: below the word, or above it if that would run off the
+ * editor. */
+void spell_suggest_rect(RECT *r) {
+    SuggestState *st = &g_editor.suggest;
+    int w = DPI(220);
+    int h = DPI(8) + (st->count > 0 ? st->count : 1) * DPI(26);
+    int x = st->x, y = st->y;
+    if (y + h > g_editor.client_h - DPI(STATUSBAR_H)) y = st->y - g_editor.line_height - h;
+    if (x + w > g_editor.client_w) x = g_editor.client_w - w;
+    if (x < 0) x = 0;
+    SetRect(r, x, y, x + w, y + h);
+}
+
+/* Item under the point; -1 elsewhere in the popup, -2 outside it. */
+int spell_suggest_hit(int mx, int my) {
+    SuggestState *st = &g_editor.suggest;
+    RECT r;
+    POINT pt = { mx, my };
+    if (!st->open) return -2;
+    spell_suggest_rect(&r);
+    if (!PtInRect(&r, pt)) return -2;
+    int i = (my - r.top - DPI(4)) / DPI(26);
+    return my >= r.top + DPI(4) && i < st->count ? i : -1;
+}
+
+void spell_suggest_apply(int i) {
+    SuggestState *st = &g_editor.suggest;
+    Document *doc = current_doc();
+    if (st->open && doc && i >= 0 && i < st->count) {
+        bpos pos = st->pos;
+        int rlen = (int)wcslen(st->words[i]);
+        doc->sel_anchor = pos;
+        doc->cursor = pos + st->len;
+        editor_delete_selection();
+        editor_insert_text(st->words[i], rlen);
+        doc->cursor = pos + rlen;
+        editor_ensure_cursor_visible();
+    }
+    spell_suggest_close();
+}
+
+void spell_suggest_close(void) {
+    g_editor.suggest.open = 0;
+}
+
+/* Keyboard handling while the popup is open. Returns 1 if the key was
+ * consumed; any other key closes the popup and goes to the editor. */
+int spell_suggest_key(WPARAM vk) {
+    SuggestState *st = &g_editor.suggest;
+    if (!st->open) return 0;
+    switch (vk) {
+    case VK_UP:
+        if (st->count > 0) st->hover = st->hover <= 0 ? st->count - 1 : st->hover - 1;
+        return 1;
+    case VK_DOWN:
+        if (st->count > 0) st->hover = st->hover + 1 >= st->count ? 0 : st->hover + 1;
+        return 1;
+    case VK_RETURN:
+    case VK_TAB:
+        spell_suggest_apply(st->hover);
+        return 1;
+    case VK_ESCAPE:
+        spell_suggest_close();
+        return 1;
+    case VK_SHIFT:
+    case VK_CONTROL:
+    case VK_MENU:
+        return 1;
+    }
+    spell_suggest_close();
+    return 0;
+}
+
+void spell_scan_init(void) {
+    InitializeCriticalSection(&g_line_lock);
+}
+
+/* Stop passes in flight; called before the pool shuts down. */
+void spell_scan_cancel(void) {
+    InterlockedIncrement(&g_spell_gen);
+}
+
+void spell_scan_free(void) {
+    free(g_lines);
+    free(g_line_ranges);
+    g_lines = NULL;
+    g_line_ranges = NULL;
+    g_line_count = g_range_count = g_range_cap = 0;
+    DeleteCriticalSection(&g_line_lock);
+}
@@ -106,9 +106,9 @@ int tokenize_line_code(const wchar_t *chars, int line_len, SynToken *out, int in
 
     {
         int j = 0;
-        while (j < line_len && iswspace(chars[j])) j++;
+        while (j < line_len && ch_isspace(chars[j])) j++;
         if (j < line_len && chars[j] == L'#') {
-            if (j + 1 < line_len && iswalpha(chars[j + 1])) {
+            if (j + 1 < line_len && ch_isalpha(chars[j + 1])) {
                 for (int k = 0; k < line_len; k++) out[k] = TOK_PREPROCESSOR;
                 return 0;
             }
@@ -142,7 +142,7 @@ normal_scan:
             return 0;
         }
 
-        if (c == L'#' && (i == 0 || !iswalpha(chars[i - 1]))) {
+        if (c == L'#' && (i == 0 || !ch_isalpha(chars[i - 1]))) {
             for (int j = i; j < line_len; j++) out[j] = TOK_COMMENT;
             return 0;
         }
@@ -161,13 +161,13 @@ normal_scan:
             continue;
         }
 
-        if (iswdigit(c) || (c == L'.' && i + 1 < line_len && iswdigit(chars[i + 1]))) {
+        if (ch_isdigit(c) || (c == L'.' && i + 1 < line_len && ch_isdigit(chars[i + 1]))) {
             int ns = i;
             if (c == L'0' && i + 1 < line_len) {
                 wchar_t next = chars[i + 1];
                 if (next == L'x' || next == L'X') {
                     i += 2;
-                    while (i < line_len && iswxdigit(chars[i])) i++;
+                    while (i < line_len && ch_isxdigit(chars[i])) i++;
                 } else if (next == L'b' || next == L'B') {
                     i += 2;
                     while (i < line_len && (chars[i] == L'0' || chars[i] == L'1')) i++;
@@ -176,11 +176,11 @@ normal_scan:
                 }
             } else {
                 decimal:
-                while (i < line_len && (iswdigit(chars[i]) || chars[i] == L'.')) i++;
+                while (i < line_len && (ch_isdigit(chars[i]) || chars[i] == L'.')) i++;
                 if (i < line_len && (chars[i] == L'e' || chars[i] == L'E')) {
                     i++;
                     if (i < line_len && (chars[i] == L'+' || chars[i] == L'-')) i++;
-                    while (i < line_len && iswdigit(chars[i])) i++;
+                    while (i < line_len && ch_isdigit(chars[i])) i++;
                 }
             }
             while (i < line_len && (chars[i] == L'u' || chars[i] == L'U' ||
@@ -190,11 +190,11 @@ normal_scan:
             continue;
         }
 
-        if (iswalpha(c) || c == L'_') {
+        if (ch_isalpha(c) || c == L'_') {
             int ws = i;
             wchar_t word[64];
             int wl = 0;
-            while (i < line_len && (iswalnum(chars[i]) || chars[i] == L'_')) {
+            while (i < line_len && (ch_isalnum(chars[i]) || chars[i] == L'_')) {
                 if (wl < 63) word[wl++] = chars[i];
                 i++;
             }
@@ -205,7 +205,7 @@ normal_scan:
                 tok = TOK_KEYWORD;
             } else if (i < line_len && chars[i] == L'(') {
                 tok = TOK_FUNCTION;
-            } else if (iswupper(word[0])) {
+            } else if (ch_isupper(word[0])) {
                 tok = TOK_TYPE;
             }
             for (int j = ws; j < i; j++) out[j] = tok;
@@ -245,9 +245,9 @@ void tokenize_line_prose(const wchar_t *chars, int line_len, SynToken *out) {
         out[0] = TOK_MD_LIST;
     }
 
-    if (iswdigit(first)) {
+    if (ch_isdigit(first)) {
         int j = 0;
-        while (j < line_len && iswdigit(chars[j])) j++;
+        while (j < line_len && ch_isdigit(chars[j])) j++;
         if (j < line_len && chars[j] == L'.' && j + 1 < line_len && chars[j + 1] == L' ') {
             for (int k = 0; k <= j; k++) out[k] = TOK_MD_LIST;
         }
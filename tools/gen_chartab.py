@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Generate chartab.c: BMP case-folding and character-class tables.
+
+    python3 tools/gen_chartab.py > chartab.c      (or: make tables)
+
+Both tables are two-level: the high byte of a UTF-16 unit picks a
+256-entry block, the low byte indexes into it. Identical blocks are
+stored once, so most of the BMP shares a handful of blocks.
+
+Folding follows simple case folding (one unit to one unit). Characters
+whose fold needs more than one unit, or lies outside the BMP, fold to
+themselves. The fold table stores 16-bit deltas so that runs of
+letters with the same offset to their fold share a block.
+"""
+import sys
+import unicodedata
+
+CH_ALPHA = 0x01
+CH_DIGIT = 0x02
+CH_UPPER = 0x04
+CH_LOWER = 0x08
+CH_SPACE = 0x10
+CH_XDIGIT = 0x20
+
+
+def fold(cp):
+    if 0xD800 <= cp <= 0xDFFF:
+        return cp
+    ch = chr(cp)
+    for f in (ch.casefold(), ch.lower()):
+        if len(f) == 1 and ord(f) <= 0xFFFF:
+            return ord(f)
+    return cp
+
+
+def classes(cp):
+    if 0xD800 <= cp <= 0xDFFF:
+        return 0
+    ch = chr(cp)
+    cat = unicodedata.category(ch)
+    bits = 0
+    # Combining marks count as letters so decomposed words stay whole
+    if cat[0] == 'L' or cat in ('Mn', 'Mc'):
+        bits |= CH_ALPHA
+    if cat == 'Nd':
+        bits |= CH_DIGIT
+    if ch.isupper():
+        bits |= CH_UPPER
+    if ch.islower():
+        bits |= CH_LOWER
+    if ch.isspace():
+        bits |= CH_SPACE
+    if ch in '0123456789abcdefABCDEF':
+        bits |= CH_XDIGIT
+    return bits
+
+
+def two_level(values):
+    blocks, index, seen = [], [], {}
+    for hi in range(256):
+        block = tuple(values[hi * 256:(hi + 1) * 256])
+        if block not in seen:
+            seen[block] = len(blocks)
+            blocks.append(block)
+        index.append(seen[block])
+    return index, blocks
+
+
+def emit_array(out, decl, values, per_line, fmt):
+    out.write(decl + ' = {\n')
+    for i in range(0, len(values), per_line):
+        out.write('    ' + ', '.join(fmt % v for v in values[i:i + per_line]) + ',\n')
+    out.write('};\n\n')
+
+
+def emit_blocks(out, ctype, name, blocks, per_line, fmt):
+    out.write('const %s %s[%d][256] = {\n' % (ctype, name, len(blocks)))
+    for b in blocks:
+        out.write('    {\n')
+        for i in range(0, 256, per_line):
+            out.write('        ' + ', '.join(fmt % v for v in b[i:i + per_line]) + ',\n')
+        out.write('    },\n')
+    out.write('};\n\n')
+
+
+FOLD_RUN = r'''/* ── Vectorized fold ──
+ * Eight UTF-16 units at a time: an all-ASCII vector folds with a range
+ * compare and add, anything else drops to the table for that vector. */
+
+#if defined(__SSE2__) && WCHAR_MAX <= 0xFFFF
+#include <emmintrin.h>
+#endif
+
+void ch_fold_run(const wchar_t *src, wchar_t *dst, ptrdiff_t n) {
+    ptrdiff_t i = 0;
+#if defined(__SSE2__) && WCHAR_MAX <= 0xFFFF
+    const __m128i non_ascii = _mm_set1_epi16((short)0xFF80);
+    const __m128i below_a = _mm_set1_epi16('A' - 1);
+    const __m128i above_z = _mm_set1_epi16('Z' + 1);
+    const __m128i to_lower = _mm_set1_epi16(0x20);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, non_ascii), _mm_setzero_si128());
+        if (_mm_movemask_epi8(ascii) != 0xFFFF) {
+            for (int k = 0; k < 8; k++) dst[i + k] = ch_fold(src[i + k]);
+            continue;
+        }
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(v, below_a), _mm_cmplt_epi16(v, above_z));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi16(v, _mm_and_si128(upper, to_lower)));
+    }
+#endif
+    for (; i < n; i++) dst[i] = ch_fold(src[i]);
+}
+'''
+
+
+def main():
+    out = sys.stdout
+    fold_delta = [(fold(cp) - cp) & 0xFFFF for cp in range(0x10000)]
+    class_bits = [classes(cp) for cp in range(0x10000)]
+    fidx, fblocks = two_level(fold_delta)
+    cidx, cblocks = two_level(class_bits)
+    assert len(fblocks) <= 256 and len(cblocks) <= 256
+
+    out.write('/*\n')
+    out.write(' * chartab.c — Unicode %s case-folding and character-class tables\n'
+              % unicodedata.unidata_version)
+    out.write(' *\n')
+    out.write(' * GENERATED by tools/gen_chartab.py — do not edit by hand.\n')
+    out.write(' * fold: %d blocks, class: %d blocks\n' % (len(fblocks), len(cblocks)))
+    out.write(' */\n')
+    out.write('#include "chartab.h"\n\n')
+    emit_array(out, 'const unsigned char ch_fold_index[256]', fidx, 16, '%3d')
+    emit_blocks(out, 'unsigned short', 'ch_fold_blocks', fblocks, 12, '0x%04X')
+    emit_array(out, 'const unsigned char ch_class_index[256]', cidx, 16, '%3d')
+    emit_blocks(out, 'unsigned char', 'ch_class_blocks', cblocks, 16, '0x%02X')
+    out.write(FOLD_RUN)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,335 @@
+#include "prose_code.h"
+
+/* ── Trigram index ──
+ * Large documents get one Bloom filter per TRI_CHUNK-unit chunk holding
+ * the case-folded trigrams that start in that chunk. A literal query of
+ * three or more characters only needs to scan chunks whose filters hold
+ * every trigram of the query; the rest are skipped unread.
+ *
+ * The index is built on the pool from a snapshot the first time a large
+ * document is searched. For an unmodified file it is also written beside
+ * the autosave files, keyed by path and checked against the length and a
+ * checksum of the text, so reopening the file loads it instead.
+ *
+ * Edits keep it valid in place: chunk starts shift, and the trigrams
+ * overlapping the edit are added to the filter of the chunk they start
+ * in. Bits are never cleared, so stale trigrams only cost a wasted chunk
+ * scan. A chunk that grows far past TRI_CHUNK is always scanned, and an
+ * index with too many of those is dropped and rebuilt. */
+
+#define TRI_BLOOM_BYTES (TRI_BLOOM_BITS / 8)
+#define TRI_MAGIC       0x58494350u   /* "PCIX" */
+#define TRI_VERSION     1
+
+struct TriIndex {
+    int count;
+    bpos *starts;          /* chunk start offsets, ascending; starts[0] == 0 */
+    unsigned char *bits;   /* count filters, TRI_BLOOM_BYTES each */
+};
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int chunk;
+    unsigned int bloom_bits;
+    unsigned long long len;
+    unsigned long long checksum;
+    unsigned int count;
+    unsigned int reserved;
+} TriFileHeader;
+
+typedef struct {
+    DocSnapshot *snap;
+    Document *doc;
+    unsigned int doc_id;
+    int mutation;
+    LONG gen;
+    wchar_t path[MAX_PATH + 32];   /* empty when the index is not persisted */
+    TriIndex *ix;
+} TriJob;
+
+static volatile LONG g_tri_gen;
+
+/* Two filter bits per trigram, both taken from one multiplicative hash */
+static void tri_hash(wchar_t a, wchar_t b, wchar_t c, unsigned *h1, unsigned *h2) {
+    unsigned long long k = (unsigned long long)(unsigned short)a |
+                           (unsigned long long)(unsigned short)b << 16 |
+                           (unsigned long long)(unsigned short)c << 32;
+    k *= 0x9E3779B97F4A7C15ull;
+    *h1 = (unsigned)(k >> 51) & (TRI_BLOOM_BITS - 1);
+    *h2 = (unsigned)(k >> 38) & (TRI_BLOOM_BITS - 1);
+}
+
+static void tri_set(unsigned char *f, wchar_t a, wchar_t b, wchar_t c) {
+    unsigned h1, h2;
+    tri_hash(a, b, c, &h1, &h2);
+    f[h1 >> 3] |= (unsigned char)(1 << (h1 & 7));
+    f[h2 >> 3] |= (unsigned char)(1 << (h2 & 7));
+}
+
+static int tri_test(const unsigned char *f, unsigned h1, unsigned h2) {
+    return (f[h1 >> 3] >> (h1 & 7) & 1) && (f[h2 >> 3] >> (h2 & 7) & 1);
+}
+
+static TriIndex *tri_alloc(int count) {
+    TriIndex *ix = (TriIndex *)calloc(1, sizeof(TriIndex));
+    if (!ix) return NULL;
+    ix->count = count;
+    ix->starts = (bpos *)malloc(count * sizeof(bpos));
+    ix->bits = (unsigned char *)calloc(count, TRI_BLOOM_BYTES);
+    if (!ix->starts || !ix->bits) { tri_free(ix); return NULL; }
+    for (int c = 0; c < count; c++) ix->starts[c] = (bpos)c * TRI_CHUNK;
+    return ix;
+}
+
+void tri_free(TriIndex *ix) {
+    if (!ix) return;
+    free(ix->starts);
+    free(ix->bits);
+    free(ix);
+}
+
+static int tri_chunk_count(bpos len) {
+    bpos n = (len + TRI_CHUNK - 1) / TRI_CHUNK;
+    return n > 0 ? (int)n : 1;
+}
+
+/* Last chunk starting at or before pos */
+static int tri_chunk_of(const TriIndex *ix, bpos pos) {
+    int lo = 0, hi = ix->count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (ix->starts[mid] <= pos) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+static unsigned long long tri_checksum(const wchar_t *text, bpos len) {
+    unsigned long long h = 0xcbf29ce484222325ull;
+    for (bpos i = 0; i < len; i++) {
+        h ^= (unsigned short)text[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+/* Returns NULL if out of memory or cancelled by tri_cancel. */
+static TriIndex *tri_build(const wchar_t *text, bpos len, LONG gen) {
+    TriIndex *ix = tri_alloc(tri_chunk_count(len));
+    if (!ix) return NULL;
+    wchar_t folded[TRI_CHUNK + 2];
+    for (int c = 0; c < ix->count; c++) {
+        if ((c & 255) == 0 && g_tri_gen != gen) { tri_free(ix); return NULL; }
+        bpos base = (bpos)c * TRI_CHUNK;
+        bpos avail = len - base < TRI_CHUNK + 2 ? len - base : TRI_CHUNK + 2;
+        ch_fold_run(text + base, folded, avail);
+        unsigned char *f = ix->bits + (size_t)c * TRI_BLOOM_BYTES;
+        for (bpos i = 0; i + 2 < avail; i++) tri_set(f, folded[i], folded[i + 1], folded[i + 2]);
+    }
+    return ix;
+}
+
+/* ── Persistence ── */
+
+static TriIndex *tri_read(const wchar_t *path, bpos len, unsigned long long sum) {
+    HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return NULL;
+
+    TriIndex *ix = NULL;
+    TriFileHeader hdr;
+    DWORD got = 0;
+    if (ReadFile(hFile, &hdr, sizeof(hdr), &got, NULL) && got == sizeof(hdr) &&
+        hdr.magic == TRI_MAGIC && hdr.version == TRI_VERSION &&
+        hdr.chunk == TRI_CHUNK && hdr.bloom_bits == TRI_BLOOM_BITS &&
+        hdr.len == (unsigned long long)len && hdr.checksum == sum &&
+        (int)hdr.count == tri_chunk_count(len) && (ix = tri_alloc((int)hdr.count)) != NULL) {
+        DWORD want = (DWORD)((size_t)ix->count * TRI_BLOOM_BYTES);
+        if (!ReadFile(hFile, ix->bits, want, &got, NULL) || got != want) {
+            tri_free(ix);
+            ix = NULL;
+        }
+    }
+    CloseHandle(hFile);
+    return ix;
+}
+
+static void tri_write(const wchar_t *path, const TriIndex *ix, bpos len, unsigned long long sum) {
+    wchar_t tmp_path[MAX_PATH + 48];
+    swprintf(tmp_path, MAX_PATH + 48, L"%ls.tmp~", path);
+    HANDLE hFile = CreateFileW(tmp_path, GENERIC_WRITE, 0, NULL,
+                               CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return;
+
+    TriFileHeader hdr = { TRI_MAGIC, TRI_VERSION, TRI_CHUNK, TRI_BLOOM_BITS,
+                          (unsigned long long)len, sum, (unsigned int)ix->count, 0 };
+    DWORD want = (DWORD)((size_t)ix->count * TRI_BLOOM_BYTES);
+    DWORD written = 0, written_bits = 0;
+    BOOL ok = WriteFile(hFile, &hdr, sizeof(hdr), &written, NULL) && written == sizeof(hdr) &&
+              WriteFile(hFile, ix->bits, want, &written_bits, NULL) && written_bits == want;
+    CloseHandle(hFile);
+    if (!ok || !MoveFileExW(tmp_path, path, MOVEFILE_REPLACE_EXISTING))
+        DeleteFileW(tmp_path);
+}
+
+/* ── Background build ── */
+
+static void tri_worker(void *param) {
+    TriJob *job = (TriJob *)param;
+    const wchar_t *text = job->snap->text;
+    bpos len = job->snap->len;
+
+    unsigned long long sum = job->path[0] ? tri_checksum(text, len) : 0;
+    if (job->path[0]) job->ix = tri_read(job->path, len, sum);
+    if (!job->ix) {
+        job->ix = tri_build(text, len, job->gen);
+        if (job->ix && job->path[0]) tri_write(job->path, job->ix, len, sum);
+    }
+
+    snapshot_release(job->snap);
+    job->snap = NULL;
+    if (!PostMessageW(g_editor.hwnd, WM_TRI_BUILT, 0, (LPARAM)job)) {
+        tri_free(job->ix);
+        free(job);
+    }
+}
+
+/* Start building an index for doc unless it is small, still loading,
+ * already indexed, or has a build in flight. */
+void tri_request(Document *doc) {
+    if (doc->loading || doc->tri || doc->tri_pending || gb_length(&doc->gb) < TRI_MIN_DOC) return;
+    TriJob *job = (TriJob *)calloc(1, sizeof(TriJob));
+    if (!job) return;
+    job->snap = doc_snapshot(doc);
+    if (!job->snap) { free(job); return; }
+    job->doc = doc;
+    job->doc_id = doc->autosave_id;
+    job->mutation = job->snap->mutation;
+    job->gen = g_tri_gen;
+    if (!doc->modified && doc->filepath[0]) autosave_index_path(doc, job->path);
+    doc->tri_pending = 1;
+    pool_submit(tri_worker, job);
+}
+
+void tri_on_built(LPARAM lParam) {
+    TriJob *job = (TriJob *)lParam;
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        Document *doc = g_editor.tabs[i];
+        if (doc != job->doc || doc->autosave_id != job->doc_id) continue;
+        doc->tri_pending = 0;
+        /* An index of text that has since been edited is useless */
+        if (job->ix && doc->gb.mutation == job->mutation) {
+            tri_free(doc->tri);
+            doc->tri = job->ix;
+            job->ix = NULL;
+        }
+        break;
+    }
+    tri_free(job->ix);
+    free(job);
+}
+
+/* Abandon in-flight builds; called before the pool shuts down. */
+void tri_cancel(void) {
+    InterlockedIncrement(&g_tri_gen);
+}
+
+/* ── Incremental update ── */
+
+void tri_on_edit(Document *doc, bpos pos, bpos removed, bpos inserted) {
+    TriIndex *ix = doc->tri;
+    if (!ix) return;
+    if (removed > TRI_MAX_PATCH || inserted > TRI_MAX_PATCH) {
+        tri_free(ix);
+        doc->tri = NULL;
+        return;
+    }
+
+    bpos *s = ix->starts;
+    int first = tri_chunk_of(ix, pos) + 1;
+    for (int c = first; c < ix->count; c++) {
+        if (s[c] > pos + removed) s[c] += inserted - removed;
+        else s[c] = pos + inserted;
+    }
+
+    /* Trigrams starting in [pos - 2, pos + inserted) now read new text */
+    bpos len = gb_length(&doc->gb);
+    bpos a = pos >= 2 ? pos - 2 : 0;
+    bpos b = pos + inserted;
+    if (b > len - 2) b = len - 2;
+    if (a >= b) return;
+    wchar_t *t = gb_extract_alloc(&doc->gb, a, b - a + 2);
+    if (!t) {
+        /* Can't record the new trigrams, so the index would miss them */
+        tri_free(ix);
+        doc->tri = NULL;
+        return;
+    }
+    ch_fold_run(t, t, b - a + 2);
+    int c = tri_chunk_of(ix, a);
+    for (bpos i = a; i < b; i++) {
+        while (c + 1 < ix->count && s[c + 1] <= i) c++;
+        tri_set(ix->bits + (size_t)c * TRI_BLOOM_BYTES, t[i - a], t[i - a + 1], t[i - a + 2]);
+    }
+    free(t);
+}
+
+/* ── Queries ── */
+
+/* Ranges of match start positions worth scanning for the folded literal
+ * `lq`, as `[from, to)` pairs in *out. Returns the number of ranges, or
+ * -1 when the index can't answer (none built, or a query under three
+ * characters). */
+int tri_candidates(Document *doc, const wchar_t *lq, int qlen, bpos **out) {
+    TriIndex *ix = doc->tri;
+    if (!ix || qlen < 3) return -1;
+
+    unsigned h1[254], h2[254];
+    int nt = qlen - 2;
+    for (int t = 0; t < nt; t++) tri_hash(lq[t], lq[t + 1], lq[t + 2], &h1[t], &h2[t]);
+
+    const bpos *s = ix->starts;
+    bpos len = gb_length(&doc->gb);
+    bpos *r = NULL;
+    int n = 0, cap = 0, oversize = 0;
+    for (int c = 0; c < ix->count; c++) {
+        bpos cs = s[c], ce = c + 1 < ix->count ? s[c + 1] : len;
+        if (ce <= cs) continue;
+        if (ce - cs > (bpos)TRI_CHUNK * 4) {
+            oversize++;
+        } else {
+            /* A match starting here can read into the following chunks */
+            int last = c;
+            while (last + 1 < ix->count && s[last + 1] < ce + qlen - 3) last++;
+            int hit = 1;
+            for (int t = 0; t < nt && hit; t++) {
+                hit = 0;
+                for (int k = c; k <= last && !hit; k++)
+                    hit = tri_test(ix->bits + (size_t)k * TRI_BLOOM_BYTES, h1[t], h2[t]);
+            }
+            if (!hit) continue;
+        }
+        if (n > 0 && r[2 * n - 1] == cs) { r[2 * n - 1] = ce; continue; }
+        if (n == cap) {
+            int ncap = cap ? cap * 2 : 64;
+            bpos *nr = (bpos *)realloc(r, ncap * 2 * sizeof(bpos));
+            if (!nr) { free(r); return -1; }
+            r = nr;
+            cap = ncap;
+        }
+        r[2 * n] = cs;
+        r[2 * n + 1] = ce;
+        n++;
+    }
+
+    if (oversize > ix->count / 8) {
+        /* Mostly rewritten since it was built; start over */
+        free(r);
+        tri_free(ix);
+        doc->tri = NULL;
+        return -1;
+    }
+    *out = r;
+    return n;
+}
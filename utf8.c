@@ -0,0 +1,230 @@
+/*
+ * utf8.c — Streaming UTF-8 to UTF-16 decoding and back
+ *
+ * Lead bytes set the number of continuation bytes and the range the
+ * first of them may take, which rules out overlong forms, surrogates and
+ * anything above U+10FFFF without a separate check on the result.
+ */
+#include "utf8.h"
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define UTF8_REPLACEMENT 0xFFFD
+
+void utf8_decoder_init(Utf8Decoder *d) {
+    d->cp = 0;
+    d->need = 0;
+    d->lo = 0x80;
+    d->hi = 0xBF;
+    d->out = 0;
+    d->line_cap = 1024;
+    d->lines = (ptrdiff_t *)malloc(d->line_cap * sizeof(ptrdiff_t));
+    d->line_count = d->lines ? 1 : 0;
+    d->lines_failed = d->lines == NULL;
+    if (d->lines) d->lines[0] = 0;
+}
+
+void utf8_decoder_free(Utf8Decoder *d) {
+    free(d->lines);
+    d->lines = NULL;
+    d->line_count = d->line_cap = 0;
+}
+
+static void add_line(Utf8Decoder *d, ptrdiff_t start) {
+    if (d->lines_failed) return;
+    if (d->line_count == d->line_cap) {
+        ptrdiff_t ncap = d->line_cap * 2;
+        ptrdiff_t *nl = (ptrdiff_t *)realloc(d->lines, ncap * sizeof(ptrdiff_t));
+        if (!nl) { d->lines_failed = 1; return; }
+        d->lines = nl;
+        d->line_cap = ncap;
+    }
+    d->lines[d->line_count++] = start;
+}
+
+/* Writes one code point, returning the units used */
+static int put(Utf8Decoder *d, wchar_t *dst, ptrdiff_t o, unsigned cp) {
+#if WCHAR_MAX <= 0xFFFF
+    if (cp > 0xFFFF) {
+        cp -= 0x10000;
+        dst[o] = (wchar_t)(0xD800 + (cp >> 10));
+        dst[o + 1] = (wchar_t)(0xDC00 + (cp & 0x3FF));
+        return 2;
+    }
+#endif
+    dst[o] = (wchar_t)cp;
+    if (cp == '\n') add_line(d, d->out + o + 1);
+    return 1;
+}
+
+ptrdiff_t utf8_decode(Utf8Decoder *d, const char *src, size_t n, wchar_t *dst) {
+    const unsigned char *s = (const unsigned char *)src;
+    size_t i = 0;
+    ptrdiff_t o = 0;
+    while (i < n) {
+#if defined(__SSE2__)
+        if (!d->need) {
+            const __m128i cr = _mm_set1_epi8('\r');
+            const __m128i lf = _mm_set1_epi8('\n');
+            for (; i + 16 <= n; i += 16, o += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+                if (_mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, cr))) break;
+#if WCHAR_MAX <= 0xFFFF
+                const __m128i zero = _mm_setzero_si128();
+                _mm_storeu_si128((__m128i *)(dst + o), _mm_unpacklo_epi8(v, zero));
+                _mm_storeu_si128((__m128i *)(dst + o + 8), _mm_unpackhi_epi8(v, zero));
+#else
+                for (int k = 0; k < 16; k++) dst[o + k] = s[i + k];
+#endif
+                unsigned nl = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+                while (nl) {
+                    add_line(d, d->out + o + __builtin_ctz(nl) + 1);
+                    nl &= nl - 1;
+                }
+            }
+        }
+        /* The rest of this 16-byte window goes through the scalar loop */
+        size_t stop = i + 16 < n ? i + 16 : n;
+#else
+        size_t stop = n;
+#endif
+        while (i < stop) {
+            unsigned c = s[i];
+            if (d->need) {
+                if (c < d->lo || c > d->hi) {
+                    /* Broken sequence: one replacement, then c starts afresh */
+                    o += put(d, dst, o, UTF8_REPLACEMENT);
+                    d->need = 0;
+                    d->lo = 0x80;
+                    d->hi = 0xBF;
+                    continue;
+                }
+                d->cp = (d->cp << 6) | (c & 0x3F);
+                d->lo = 0x80;
+                d->hi = 0xBF;
+                i++;
+                if (--d->need == 0) o += put(d, dst, o, d->cp);
+                continue;
+            }
+            i++;
+            if (c < 0x80) {
+                if (c != '\r') o += put(d, dst, o, c);
+            } else if (c >= 0xC2 && c <= 0xDF) {
+                d->cp = c & 0x1F;
+                d->need = 1;
+            } else if (c >= 0xE0 && c <= 0xEF) {
+                d->cp = c & 0x0F;
+                d->need = 2;
+                if (c == 0xE0) d->lo = 0xA0;        /* overlong */
+                else if (c == 0xED) d->hi = 0x9F;   /* surrogates */
+            } else if (c >= 0xF0 && c <= 0xF4) {
+                d->cp = c & 0x07;
+                d->need = 3;
+                if (c == 0xF0) d->lo = 0x90;        /* overlong */
+                else if (c == 0xF4) d->hi = 0x8F;   /* above U+10FFFF */
+            } else {
+                o += put(d, dst, o, UTF8_REPLACEMENT);
+            }
+        }
+    }
+    d->out += o;
+    return o;
+}
+
+ptrdiff_t utf8_decode_end(Utf8Decoder *d, wchar_t *dst) {
+    if (!d->need) return 0;
+    d->need = 0;
+    d->lo = 0x80;
+    d->hi = 0xBF;
+    put(d, dst, 0, UTF8_REPLACEMENT);
+    d->out++;
+    return 1;
+}
+
+/* ── Encoding ── */
+
+void utf8_encoder_init(Utf8Encoder *e, int crlf) {
+    e->high = 0;
+    e->crlf = crlf;
+}
+
+static size_t put_utf8(char *dst, unsigned cp) {
+    unsigned char *d = (unsigned char *)dst;
+    if (cp < 0x800) {
+        d[0] = (unsigned char)(0xC0 | (cp >> 6));
+        d[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        d[0] = (unsigned char)(0xE0 | (cp >> 12));
+        d[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        d[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    d[0] = (unsigned char)(0xF0 | (cp >> 18));
+    d[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+    d[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+    d[3] = (unsigned char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+size_t utf8_encode(Utf8Encoder *e, const wchar_t *src, ptrdiff_t n, char *dst) {
+    size_t o = 0;
+    ptrdiff_t i = 0;
+    while (i < n) {
+#if defined(__SSE2__) && WCHAR_MAX <= 0xFFFF
+        if (!e->high) {
+            const __m128i non_ascii = _mm_set1_epi16((short)0xFF80);
+            const __m128i lf = _mm_set1_epi16(e->crlf ? '\n' : 0x80);
+            for (; i + 8 <= n; i += 8, o += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i bad = _mm_or_si128(
+                    _mm_xor_si128(_mm_cmpeq_epi16(_mm_and_si128(v, non_ascii), _mm_setzero_si128()),
+                                  _mm_set1_epi16(-1)),
+                    _mm_cmpeq_epi16(v, lf));
+                if (_mm_movemask_epi8(bad)) break;
+                _mm_storel_epi64((__m128i *)(dst + o), _mm_packus_epi16(v, v));
+            }
+        }
+        /* The rest of this 8-unit window goes through the scalar loop */
+        ptrdiff_t stop = i + 8 < n ? i + 8 : n;
+#else
+        ptrdiff_t stop = n;
+#endif
+        for (; i < stop; i++) {
+            unsigned c = (unsigned)src[i];
+#if WCHAR_MAX > 0xFFFF
+            if (c > 0x10FFFF) c = UTF8_REPLACEMENT;
+#endif
+            if (e->high) {
+                if (c >= 0xDC00 && c <= 0xDFFF) {
+                    o += put_utf8(dst + o, 0x10000 + ((e->high - 0xD800) << 10) + (c - 0xDC00));
+                    e->high = 0;
+                    continue;
+                }
+                o += put_utf8(dst + o, UTF8_REPLACEMENT);
+                e->high = 0;
+            }
+            if (c < 0x80) {
+                if (c == '\n' && e->crlf) dst[o++] = '\r';
+                dst[o++] = (char)c;
+            } else if (c >= 0xD800 && c <= 0xDBFF) {
+                e->high = c;
+            } else if (c >= 0xDC00 && c <= 0xDFFF) {
+                o += put_utf8(dst + o, UTF8_REPLACEMENT);
+            } else {
+                o += put_utf8(dst + o, c);
+            }
+        }
+    }
+    return o;
+}
+
+size_t utf8_encode_end(Utf8Encoder *e, char *dst) {
+    if (!e->high) return 0;
+    e->high = 0;
+    return put_utf8(dst, UTF8_REPLACEMENT);
+}
@@ -0,0 +1,64 @@
+/*
+ * utf8.h — Streaming UTF-8 to UTF-16 decoding and back
+ * Portable C with no Win32 dependencies.
+ *
+ * Decoding: input arrives in chunks of any size; a sequence split across
+ * chunks is carried over in the decoder. CR is dropped, and each maximal
+ * invalid subsequence becomes one U+FFFD, as MultiByteToWideChar does.
+ * The start of every line is recorded as it is written, so a line index
+ * needs no second pass over the text.
+ *
+ * Encoding: text is taken in pieces of any size, such as the two halves
+ * of a gap buffer, with a surrogate pair split between pieces carried
+ * over. LF can be written as CRLF, and an unpaired surrogate becomes
+ * U+FFFD, as WideCharToMultiByte does.
+ *
+ * All-ASCII runs go 16 bytes (or 8 units) at a time on SSE2.
+ */
+#ifndef PROSE_UTF8_H
+#define PROSE_UTF8_H
+
+#include <stddef.h>
+#include <wchar.h>
+
+typedef struct {
+    unsigned cp;            /* code point of the pending sequence */
+    int need;               /* continuation bytes it still expects */
+    unsigned char lo, hi;   /* range allowed for the next one */
+    ptrdiff_t out;          /* units written so far */
+    ptrdiff_t *lines;       /* line start offsets; lines[0] is 0 */
+    ptrdiff_t line_count;
+    ptrdiff_t line_cap;
+    int lines_failed;       /* lines[] could not grow and is incomplete */
+} Utf8Decoder;
+
+void utf8_decoder_init(Utf8Decoder *d);
+void utf8_decoder_free(Utf8Decoder *d);
+
+/* Decodes src[0..n) into dst, which needs room for n + 1 units, and
+ * returns the number written. */
+ptrdiff_t utf8_decode(Utf8Decoder *d, const char *src, size_t n, wchar_t *dst);
+
+/* Ends the stream, writing U+FFFD for a truncated final sequence.
+ * Returns the units written to dst, at most 1. */
+ptrdiff_t utf8_decode_end(Utf8Decoder *d, wchar_t *dst);
+
+typedef struct {
+    unsigned high;   /* high surrogate waiting for its pair, or 0 */
+    int crlf;        /* write LF as CRLF */
+} Utf8Encoder;
+
+/* Bytes utf8_encode may write for n units */
+#define UTF8_ENCODE_MAX(n) ((size_t)(n) * 3 + 3)
+
+void utf8_encoder_init(Utf8Encoder *e, int crlf);
+
+/* Encodes src[0..n) into dst, which needs UTF8_ENCODE_MAX(n) bytes, and
+ * returns the number written. */
+size_t utf8_encode(Utf8Encoder *e, const wchar_t *src, ptrdiff_t n, char *dst);
+
+/* Ends the stream, writing U+FFFD for a trailing high surrogate.
+ * Returns the bytes written to dst, at most 3. */
+size_t utf8_encode_end(Utf8Encoder *e, char *dst);
+
+#endif /* PROSE_UTF8_H */
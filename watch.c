@@ -0,0 +1,493 @@
+#include "prose_code.h"
+
+/* ── Watching open files ──
+ * A thread holds a change notification on the directory of every open
+ * file and posts WM_FILE_CHANGED when one fires; the window waits for
+ * the writes to settle (TIMER_FILE_CHANGE), then compares each file's
+ * size and write time with what was last loaded or saved. Directories
+ * that cannot be watched (some network shares, or more than one wait
+ * can hold) are polled every WATCH_POLL_MS instead. The autosave tick
+ * keeps the set of directories up to date.
+ *
+ * A changed file is read again and diffed (diff.c) against the buffer,
+ * and only the differing hunks are replaced, as one undo group, so the
+ * cursor, scroll position, caches and undo history all carry over. A
+ * document with unsaved changes asks first.
+ *
+ * A followed file (follow mode, for logs) is instead read on from the
+ * byte offset the buffer ends at, on every notification and every tick.
+ * The new bytes go in FOLLOW_CHUNK pieces, decoded straight into the
+ * gap and committed one by one, so each edit hook (stats, search
+ * matches, spelling, trigrams) sees a small append and patches itself
+ * rather than rescanning. The line cache takes the line starts the
+ * decoder collected and word wrap is redone from the old last line on.
+ * A file that was replaced (rotated) or got shorter (truncated) is read
+ * again through the diff. */
+
+#define WATCH_MAX_DIRS  (MAXIMUM_WAIT_OBJECTS - 1)
+#define WATCH_POLL_MS   2000
+#define WATCH_SETTLE_MS 200
+#define FOLLOW_CHUNK    (60 * 1024)          /* decodes to under TRI_MAX_PATCH */
+#define FOLLOW_MAX_READ (16 * 1024 * 1024)   /* per check; the rest comes next */
+
+enum { CHECK_ALL, CHECK_UNWATCHED, CHECK_FOLLOWED };
+
+typedef struct {
+    wchar_t path[MAX_PATH];
+    int watched;             /* the thread holds a notification for it */
+} WatchDir;
+
+static CRITICAL_SECTION g_watch_lock;
+static int g_watch_init;
+static HANDLE g_watch_wake;          /* the list changed, or quit */
+static HANDLE g_watch_thread;
+static WatchDir g_watch_dirs[MAX_TABS];
+static int g_watch_count;
+static volatile LONG g_watch_quit;
+static DWORD g_watch_polled;
+static int g_watch_busy;             /* a reload prompt is open */
+static int g_watch_pending;          /* a notified check was put off */
+static int g_watch_timer;            /* TIMER_FILE_CHANGE is set */
+
+static DWORD WINAPI watch_thread(LPVOID param) {
+    (void)param;
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+    int n = 0;
+    handles[0] = g_watch_wake;
+    for (;;) {
+        DWORD r = WaitForMultipleObjects(n + 1, handles, FALSE, INFINITE);
+        if (r == WAIT_OBJECT_0) {
+            if (g_watch_quit) break;
+            for (int i = 1; i <= n; i++) FindCloseChangeNotification(handles[i]);
+            n = 0;
+
+            /* Opening can be slow on a share, so work on a copy */
+            WatchDir dirs[MAX_TABS];
+            EnterCriticalSection(&g_watch_lock);
+            int count = g_watch_count;
+            memcpy(dirs, g_watch_dirs, count * sizeof(WatchDir));
+            LeaveCriticalSection(&g_watch_lock);
+            for (int i = 0; i < count; i++) {
+                HANDLE h = INVALID_HANDLE_VALUE;
+                if (n < WATCH_MAX_DIRS) {
+                    h = FindFirstChangeNotificationW(dirs[i].path, FALSE,
+                            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE |
+                            FILE_NOTIFY_CHANGE_LAST_WRITE);
+                }
+                dirs[i].watched = h != INVALID_HANDLE_VALUE;
+                if (dirs[i].watched) handles[++n] = h;
+            }
+            EnterCriticalSection(&g_watch_lock);
+            for (int i = 0; i < count; i++) {
+                for (int j = 0; j < g_watch_count; j++) {
+                    if (_wcsicmp(g_watch_dirs[j].path, dirs[i].path) == 0)
+                        g_watch_dirs[j].watched = dirs[i].watched;
+                }
+            }
+            LeaveCriticalSection(&g_watch_lock);
+        } else if (r > WAIT_OBJECT_0 && r <= WAIT_OBJECT_0 + (DWORD)n) {
+            FindNextChangeNotification(handles[r - WAIT_OBJECT_0]);
+            PostMessageW(g_editor.hwnd, WM_FILE_CHANGED, 0, 0);
+        } else {
+            break;
+        }
+    }
+    for (int i = 1; i <= n; i++) FindCloseChangeNotification(handles[i]);
+    return 0;
+}
+
+static int stamp_read(const wchar_t *path, FileStamp *st) {
+    WIN32_FILE_ATTRIBUTE_DATA fa;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &fa)) return 0;
+    st->size = ((unsigned long long)fa.nFileSizeHigh << 32) | fa.nFileSizeLow;
+    st->time = fa.ftLastWriteTime;
+    return 1;
+}
+
+static int stamp_equal(const FileStamp *a, const FileStamp *b) {
+    return a->size == b->size && CompareFileTime(&a->time, &b->time) == 0;
+}
+
+void watch_stamp(Document *doc) {
+    if (!doc->filepath[0] || !stamp_read(doc->filepath, &doc->disk))
+        memset(&doc->disk, 0, sizeof(doc->disk));
+}
+
+static void dir_of(const wchar_t *path, wchar_t *out) {
+    safe_wcscpy(out, MAX_PATH, path);
+    wchar_t *slash = wcsrchr(out, L'\\');
+    wchar_t *fwd = wcsrchr(out, L'/');
+    if (fwd > slash) slash = fwd;
+    if (!slash) out[0] = 0;
+    else if (slash > out && slash[-1] == L':') slash[1] = 0;   /* a drive root */
+    else *slash = 0;
+}
+
+static int dir_listed(const WatchDir *dirs, int count, const wchar_t *path) {
+    for (int i = 0; i < count; i++) {
+        if (_wcsicmp(dirs[i].path, path) == 0) return i;
+    }
+    return -1;
+}
+
+/* Hands the thread the directories of the open files, if they changed */
+static void watch_sync(void) {
+    WatchDir dirs[MAX_TABS];
+    int count = 0;
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        Document *doc = g_editor.tabs[i];
+        if (!doc->filepath[0] || doc->is_results) continue;
+        wchar_t dir[MAX_PATH];
+        dir_of(doc->filepath, dir);
+        if (!dir[0] || dir_listed(dirs, count, dir) >= 0) continue;
+        safe_wcscpy(dirs[count].path, MAX_PATH, dir);
+        dirs[count].watched = 0;
+        count++;
+    }
+
+    if (!g_watch_init) {
+        InitializeCriticalSection(&g_watch_lock);
+        g_watch_wake = CreateEventW(NULL, FALSE, FALSE, NULL);
+        g_watch_init = 1;
+    }
+    EnterCriticalSection(&g_watch_lock);
+    int same = count == g_watch_count;
+    for (int i = 0; same && i < count; i++)
+        same = dir_listed(g_watch_dirs, g_watch_count, dirs[i].path) >= 0;
+    if (!same) {
+        for (int i = 0; i < count; i++) {
+            int j = dir_listed(g_watch_dirs, g_watch_count, dirs[i].path);
+            if (j >= 0) dirs[i].watched = g_watch_dirs[j].watched;
+        }
+        memcpy(g_watch_dirs, dirs, count * sizeof(WatchDir));
+        g_watch_count = count;
+    }
+    LeaveCriticalSection(&g_watch_lock);
+    if (same || !g_watch_wake) return;
+
+    if (!g_watch_thread && count > 0)
+        g_watch_thread = CreateThread(NULL, 0, watch_thread, NULL, 0, NULL);
+    SetEvent(g_watch_wake);
+}
+
+/* ── Reloading ── */
+
+/* Where old position pos lands once the hunks are applied; a position
+ * inside a replaced range keeps its offset into it where it can */
+static bpos map_pos(const DiffHunk *hunks, ptrdiff_t count, bpos pos) {
+    bpos shift = 0;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        const DiffHunk *h = &hunks[i];
+        if (pos < h->a_pos) break;
+        if (pos < h->a_pos + h->a_len) {
+            bpos off = pos - h->a_pos;
+            return h->b_pos + (off < h->b_len ? off : h->b_len);
+        }
+        shift += h->b_len - h->a_len;
+    }
+    return pos + shift;
+}
+
+static void apply_hunks(Document *doc, const wchar_t *old, const wchar_t *text,
+                        const DiffHunk *hunks, ptrdiff_t count) {
+    bpos cursor = map_pos(hunks, count, doc->cursor);
+    bpos anchor = doc->sel_anchor >= 0 ? map_pos(hunks, count, doc->sel_anchor) : -1;
+    bpos old_cursor = doc->cursor;
+    int group = ++doc->undo.next_group;
+
+    /* Someone else's writing, not typing */
+    int live = doc->analytics.live;
+    doc->analytics.live = 0;
+    bpos shift = 0;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        const DiffHunk *h = &hunks[i];
+        bpos pos = h->a_pos + shift;
+        if (h->a_len > 0) {
+            undo_push(&doc->undo, UNDO_DELETE, pos, old + h->a_pos, h->a_len, old_cursor, cursor, group);
+            gb_delete(&doc->gb, pos, h->a_len);
+        }
+        if (h->b_len > 0) {
+            gb_insert(&doc->gb, pos, text + h->b_pos, h->b_len);
+            undo_push(&doc->undo, UNDO_INSERT, pos, text + h->b_pos, h->b_len, old_cursor, cursor, group);
+        }
+        shift += h->b_len - h->a_len;
+    }
+    doc->analytics.live = live;
+
+    doc->cursor = cursor;
+    doc->sel_anchor = anchor;
+    recalc_lines(doc);
+}
+
+/* Brings doc up to the file on disk, returning whether its text changed
+ * and the bytes read in *bytes (-1 on failure, to be tried again at the
+ * next change or poll) */
+static int reload_doc(Document *doc, const FileStamp *st, bpos *bytes) {
+    bpos new_len;
+    wchar_t *text = read_text_file(doc->filepath, &new_len, bytes);
+    if (!text) {
+        *bytes = -1;
+        return 0;
+    }
+    bpos old_len = gb_length(&doc->gb);
+    wchar_t *old = gb_extract_alloc(&doc->gb, 0, old_len);
+    DiffHunk *hunks = NULL;
+    ptrdiff_t count = old ? diff_text(old, old_len, text, new_len, &hunks) : -1;
+    if (count < 0) *bytes = -1;
+    if (count >= 0) {
+        if (count > 0) apply_hunks(doc, old, text, hunks, count);
+        doc->disk = *st;
+        doc->undo.save_point = doc->undo.current;
+        if (doc->modified) autosave_delete_for_doc(doc);
+        doc->modified = 0;
+    }
+    free(hunks);
+    free(old);
+    free(text);
+    return count > 0;
+}
+
+/* ── Following ── */
+
+static HANDLE follow_open(Document *doc, BY_HANDLE_FILE_INFORMATION *info,
+                          unsigned long long *size) {
+    HANDLE h = CreateFileW(doc->filepath, GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return h;
+    if (!GetFileInformationByHandle(h, info)) {
+        CloseHandle(h);
+        return INVALID_HANDLE_VALUE;
+    }
+    *size = ((unsigned long long)info->nFileSizeHigh << 32) | info->nFileSizeLow;
+    return h;
+}
+
+static void follow_identify(FollowState *f, const BY_HANDLE_FILE_INFORMATION *info) {
+    f->volume = info->dwVolumeSerialNumber;
+    f->index_hi = info->nFileIndexHigh;
+    f->index_lo = info->nFileIndexLow;
+}
+
+/* Reads the whole file again and follows on from its end */
+static int follow_restart(Document *doc, const BY_HANDLE_FILE_INFORMATION *info) {
+    FollowState *f = &doc->follow;
+    FileStamp st;
+    bpos bytes;
+    if (!stamp_read(doc->filepath, &st)) return 0;
+    int changed = reload_doc(doc, &st, &bytes);
+    if (bytes < 0) return changed;
+    follow_identify(f, info);
+    f->offset = (unsigned long long)bytes;
+    utf8_decoder_free(&f->dec);
+    utf8_decoder_init(&f->dec);
+    return changed;
+}
+
+/* Appends what was written since the last read; returns whether the
+ * text changed */
+static int follow_update(Document *doc) {
+    FollowState *f = &doc->follow;
+    BY_HANDLE_FILE_INFORMATION info;
+    unsigned long long size;
+    HANDLE h = follow_open(doc, &info, &size);
+    /* Between a rotation's rename and the new file, there may be none */
+    if (h == INVALID_HANDLE_VALUE) return 0;
+    if (info.dwVolumeSerialNumber != f->volume || info.nFileIndexHigh != f->index_hi ||
+        info.nFileIndexLow != f->index_lo || size < f->offset) {
+        CloseHandle(h);
+        return follow_restart(doc, &info);
+    }
+    unsigned long long left = size - f->offset;
+    if (left > FOLLOW_MAX_READ) left = FOLLOW_MAX_READ;
+    LARGE_INTEGER at;
+    at.QuadPart = (LONGLONG)f->offset;
+    char *chunk = left > 0 ? (char *)malloc(FOLLOW_CHUNK) : NULL;
+    if (!chunk || !SetFilePointerEx(h, at, NULL, FILE_BEGIN)) {
+        free(chunk);
+        CloseHandle(h);
+        return 0;
+    }
+
+    GapBuffer *gb = &doc->gb;
+    int at_end = doc->cursor == gb_length(gb) && doc->sel_anchor < 0;
+    bpos first_line = doc->lc.count - 1;
+    int lines_ok = !doc->lc.dirty;
+    int changed = 0;
+    int live = doc->analytics.live;
+    doc->analytics.live = 0;   /* someone else's writing, not typing */
+    while (left > 0) {
+        wchar_t *dst = gb_append_reserve(gb, FOLLOW_CHUNK + 1);
+        DWORD want = left < FOLLOW_CHUNK ? (DWORD)left : FOLLOW_CHUNK, got = 0;
+        if (!dst || !ReadFile(h, chunk, want, &got, NULL) || got == 0) break;
+        const char *p = chunk;
+        DWORD n = got;
+        if (f->offset == 0 && n >= 3 && (unsigned char)p[0] == 0xEF &&
+            (unsigned char)p[1] == 0xBB && (unsigned char)p[2] == 0xBF) {
+            p += 3;
+            n -= 3;
+        }
+        f->offset += got;
+        left -= got;
+
+        /* Line starts come back as buffer positions */
+        f->dec.out = gb_length(gb);
+        if (f->dec.line_count > 0) f->dec.line_count = 1;
+        bpos wlen = utf8_decode(&f->dec, p, n, dst);
+        gb_append_commit(gb, wlen);
+        changed |= wlen > 0;
+        lines_ok = lines_ok && !f->dec.lines_failed &&
+                   lc_notify_append(&doc->lc, f->dec.lines + 1, f->dec.line_count - 1);
+    }
+    doc->analytics.live = live;
+    free(chunk);
+    CloseHandle(h);
+
+    /* Reads are capped to keep the window responsive; catch up shortly */
+    if (f->offset < size) {
+        SetTimer(g_editor.hwnd, TIMER_FILE_CHANGE, WATCH_SETTLE_MS, NULL);
+        g_watch_timer = 1;
+    }
+    if (!changed) return 0;
+    if (!lines_ok) {
+        recalc_lines(doc);
+    } else if (doc->mode == MODE_PROSE && doc->wc.wrap_col > 0 && !doc->wrap_dirty) {
+        wc_extend(&doc->wc, gb, &doc->lc, first_line);
+    }
+    if (at_end) {
+        doc->cursor = gb_length(gb);
+        if (doc == current_doc()) editor_ensure_cursor_visible();
+    }
+    return 1;
+}
+
+void follow_toggle(Document *doc) {
+    if (!doc || doc->is_results || doc->loading) return;
+    FollowState *f = &doc->follow;
+    if (f->on) {
+        /* Catch up, so the stamp below matches the text */
+        follow_update(doc);
+        follow_free(doc);
+        watch_stamp(doc);
+        return;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    unsigned long long size;
+    if (!doc->filepath[0]) return;
+    HANDLE h = follow_open(doc, &info, &size);
+    if (h == INVALID_HANDLE_VALUE) return;
+    CloseHandle(h);
+
+    utf8_decoder_init(&f->dec);
+    f->on = 1;
+    follow_identify(f, &info);
+    f->offset = size;
+    /* Unsaved text stays and new lines go after it; otherwise the buffer
+     * is brought up to the file first */
+    if (!doc->modified) follow_restart(doc, &info);
+    doc->cursor = gb_length(&doc->gb);
+    doc->sel_anchor = -1;
+    if (doc == current_doc()) editor_ensure_cursor_visible();
+}
+
+void follow_free(Document *doc) {
+    if (!doc->follow.on) return;
+    doc->follow.on = 0;
+    utf8_decoder_free(&doc->follow.dec);
+}
+
+/* ── Checking ── */
+
+static int check_doc(Document *doc) {
+    FileStamp st;
+    if (!doc->filepath[0] || doc->is_results || doc->loading || doc->hibernated) return 0;
+    if (doc->follow.on) return follow_update(doc);
+    /* Gone or unreadable for now: keep the buffer as it is */
+    if (!stamp_read(doc->filepath, &st) || stamp_equal(&st, &doc->disk)) return 0;
+
+    if (doc->modified) {
+        wchar_t msg[512];
+        swprintf(msg, 512,
+                 L"\"%ls\" has changed on disk.\n\nReload it? Your unsaved changes "
+                 L"can be brought back with Undo.", doc->title);
+        if (MessageBoxW(g_editor.hwnd, msg, L"File Changed",
+                        MB_YESNO | MB_ICONQUESTION) != IDYES) {
+            doc->disk = st;
+            return 0;
+        }
+    }
+    bpos bytes;
+    return reload_doc(doc, &st, &bytes);
+}
+
+/* Compares open files with the disk: all of them, those in directories
+ * without a notification, or only followed ones (always included) */
+static void check_docs(int which) {
+    /* Our own save may not be applied yet; the next tick looks again */
+    if (g_watch_busy || save_busy()) {
+        if (which == CHECK_ALL) g_watch_pending = 1;
+        return;
+    }
+    if (which == CHECK_ALL) g_watch_pending = 0;
+    g_watch_busy = 1;
+    int changed = 0;
+    for (int i = 0; i < g_editor.tab_count; i++) {
+        Document *doc = g_editor.tabs[i];
+        if (which == CHECK_FOLLOWED && !doc->follow.on) continue;
+        if (which == CHECK_UNWATCHED && !doc->follow.on && doc->filepath[0]) {
+            wchar_t dir[MAX_PATH];
+            dir_of(doc->filepath, dir);
+            EnterCriticalSection(&g_watch_lock);
+            int j = dir_listed(g_watch_dirs, g_watch_count, dir);
+            int watched = j >= 0 && g_watch_dirs[j].watched;
+            LeaveCriticalSection(&g_watch_lock);
+            if (watched) continue;
+        }
+        changed |= check_doc(doc);
+    }
+    g_watch_busy = 0;
+    if (changed) InvalidateRect(g_editor.hwnd, NULL, FALSE);
+}
+
+/* WM_FILE_CHANGED: a file is often written in several steps, so look
+ * WATCH_SETTLE_MS after the first notification. The timer is not pushed
+ * back by later ones, or a log written without pause would never be
+ * looked at. */
+void watch_on_change(void) {
+    if (g_watch_timer) return;
+    SetTimer(g_editor.hwnd, TIMER_FILE_CHANGE, WATCH_SETTLE_MS, NULL);
+    g_watch_timer = 1;
+}
+
+/* TIMER_FILE_CHANGE */
+void watch_check(void) {
+    KillTimer(g_editor.hwnd, TIMER_FILE_CHANGE);
+    g_watch_timer = 0;
+    check_docs(CHECK_ALL);
+}
+
+void watch_tick(void) {
+    watch_sync();
+    if (!g_watch_init) return;
+    if (g_watch_pending) {
+        check_docs(CHECK_ALL);
+        return;
+    }
+    DWORD now = GetTickCount();
+    int poll = now - g_watch_polled >= WATCH_POLL_MS;
+    if (poll) g_watch_polled = now;
+    /* A writer's size updates may not reach the directory (and so the
+     * notification) until it closes the file; followed files are read
+     * every tick */
+    check_docs(poll ? CHECK_UNWATCHED : CHECK_FOLLOWED);
+}
+
+void watch_shutdown(void) {
+    if (g_watch_thread) {
+        InterlockedExchange(&g_watch_quit, 1);
+        SetEvent(g_watch_wake);
+        WaitForSingleObject(g_watch_thread, INFINITE);
+        CloseHandle(g_watch_thread);
+        g_watch_thread = NULL;
+    }
+}
@@ -39,6 +39,30 @@ bpos mouse_to_pos(int mx, int my) {
     return ls + col;
 }
 
+/* Client coordinates of the top-left corner of the character at pos */
+void pos_to_point(bpos pos, int *x, int *y) {
+    Document *doc = current_doc();
+    *x = *y = 0;
+    if (!doc) return;
+
+    int edit_y = DPI(TITLEBAR_H + MENUBAR_H + TABBAR_H);
+    int gw = gutter_width(doc);
+    int lh = g_editor.line_height;
+
+    if (doc->mode == MODE_PROSE && doc->wc.count > 0) {
+        bpos vline = wc_visual_line_of(&doc->wc, pos);
+        bpos vls = doc->wc.entries[vline].pos;
+        *x = gw + col_to_pixel_x(&doc->gb, vls, pos - vls, g_editor.char_width);
+        *y = edit_y + (int)(vline * lh) - doc->scroll_y;
+        return;
+    }
+
+    bpos line = lc_line_of(&doc->lc, pos);
+    bpos ls = lc_line_start(&doc->lc, line);
+    *x = gw + col_to_pixel_x(&doc->gb, ls, pos - ls, g_editor.char_width) - doc->scroll_x;
+    *y = edit_y + (int)(line * lh) - doc->scroll_y;
+}
+
 /* Scrollbar geometry helper — returns thumb_y and thumb_h for the current scroll state */
 int scrollbar_thumb_geometry(int *out_thumb_y, int *out_thumb_h, int *out_edit_y, int *out_edit_h) {
     Document *doc = current_doc();
@@ -72,13 +96,13 @@ bpos word_start(GapBuffer *gb, bpos pos) {
     /* Skip non-word characters first (spaces, punctuation) */
     while (pos > 0) {
         wchar_t c = gb_char_at(gb, pos - 1);
-        if (iswalnum(c) || c == L'_') break;
+        if (ch_isalnum(c) || c == L'_') break;
         pos--;
     }
     /* Then skip the word itself */
     while (pos > 0) {
         wchar_t c = gb_char_at(gb, pos - 1);
-        if (!iswalnum(c) && c != L'_') break;
+        if (!ch_isalnum(c) && c != L'_') break;
         pos--;
     }
     return pos;
@@ -88,7 +112,7 @@ bpos word_end(GapBuffer *gb, bpos pos) {
     bpos len = gb_length(gb);
     while (pos < len) {
         wchar_t c = gb_char_at(gb, pos);
-        if (!iswalnum(c) && c != L'_') break;
+        if (!ch_isalnum(c) && c != L'_') break;
         pos++;
     }
     return pos;
@@ -285,8 +309,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         g_editor.cursor_visible = 1; g_editor.cursor_last_active = GetTickCount();
         g_editor.session_start_time = GetTickCount();
 
-        /* Start autosave timer — fires every 30 seconds */
-        SetTimer(hwnd, TIMER_AUTOSAVE, 30000, NULL);
+        /* Start autosave timer — appends the edit journal every second */
+        SetTimer(hwnd, TIMER_AUTOSAVE, 1000, NULL);
 
         return 0;
     }
@@ -385,6 +409,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         PAINTSTRUCT ps;
         HDC hdc = BeginPaint(hwnd, &ps);
         if (g_editor.hdc_back) {
+            search_sync_doc();
+            spell_sync_doc();
             render(g_editor.hdc_back);
             /* BitBlt only the dirty region — avoids full-window blit for cursor blink,
              * scrollbar hover, and other small invalidations. */
@@ -473,8 +499,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             }
         }
         if (wParam == TIMER_AUTOSAVE) {
+            watch_tick();
             autosave_tick();
         }
+        if (wParam == TIMER_FILE_CHANGE) {
+            watch_check();
+        }
+        if (wParam == TIMER_SEARCH_SETTLE) {
+            search_on_settle();
+        }
         if (wParam == TIMER_DRAG_SCROLL) {
             Document *doc = current_doc();
             if (doc && g_editor.mouse_captured) {
@@ -550,6 +583,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_MOUSEWHEEL: {
         Document *doc = current_doc();
         if (!doc) break;
+        if (g_editor.suggest.open) {
+            spell_suggest_close();
+            InvalidateRect(hwnd, NULL, FALSE);
+        }
         int delta = GET_WHEEL_DELTA_WPARAM(wParam);
         /* Shift+Wheel = horizontal scroll in code mode */
         if ((LOWORD(wParam) & MK_SHIFT) && doc->mode == MODE_CODE) {
@@ -594,6 +631,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
         }
 
+        /* Spelling suggestions: pick one, or click away to dismiss */
+        if (g_editor.suggest.open) {
+            int hit = spell_suggest_hit(mx, my);
+            if (hit >= 0) spell_suggest_apply(hit);
+            InvalidateRect(hwnd, NULL, FALSE);
+            if (hit != -2) return 0;
+            spell_suggest_close();
+        }
+
         /* Title bar area */
         if (my < DPI(TITLEBAR_H)) {
             /* Check window control buttons (rightmost) */
@@ -697,7 +743,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             int tx = DPI(8);
             for (int i = 0; i < g_editor.tab_count; i++) {
                 wchar_t label[128];
-                swprintf(label, 128, L"%ls%ls", g_editor.tabs[i]->title, g_editor.tabs[i]->modified ? L" \x2022" : L"");
+                swprintf(label, 128, L"%ls%ls", g_editor.tabs[i]->title,
+                         g_editor.tabs[i]->loading ? L" \x2026" : g_editor.tabs[i]->modified ? L" \x2022" : L"");
                 int tw = (int)wcslen(label) * DPI(8) + DPI(TAB_PAD) * 2;
                 if (tw < DPI(TAB_MIN_W)) tw = DPI(TAB_MIN_W);
                 if (tw > DPI(TAB_MAX_W)) tw = DPI(TAB_MAX_W);
@@ -707,7 +754,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     if (mx >= tx + tw - DPI(24)) {
                         close_tab(i);
                     } else {
-                        g_editor.active_tab = i;
+                        activate_tab(i);
                     }
                     InvalidateRect(hwnd, NULL, FALSE);
                     return 0;
@@ -813,7 +860,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 if (doc) {
                     bpos tlen = gb_length(&doc->gb);
                     wchar_t ch = (pos < tlen) ? gb_char_at(&doc->gb, pos) : 0;
-                    if (iswalnum(ch) || ch == L'_') {
+                    if (ch_isalnum(ch) || ch == L'_') {
                         doc->sel_anchor = word_start(&doc->gb, pos);
                         doc->cursor = word_end(&doc->gb, pos);
                     } else {
@@ -850,6 +897,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             Document *doc = current_doc();
             if (doc) {
                 bpos pos = mouse_to_pos(mx, my);
+                if (doc->is_results && find_in_files_open_at(doc, pos)) {
+                    InvalidateRect(hwnd, NULL, FALSE);
+                    return 0;
+                }
                 doc->sel_anchor = word_start(&doc->gb, pos);
                 doc->cursor = word_end(&doc->gb, pos);
                 InvalidateRect(hwnd, NULL, FALSE);
@@ -859,10 +910,34 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         break;
     }
 
+    case WM_RBUTTONDOWN: {
+        int mx = GET_X_LPARAM(lParam);
+        int my = GET_Y_LPARAM(lParam);
+        int text_r = g_editor.client_w - DPI(SCROLLBAR_W) - (g_editor.show_minimap ? DPI(MINIMAP_W) : 0);
+
+        /* Right-click a word in the editor for spelling suggestions */
+        g_editor.menu_open = -1;
+        spell_suggest_close();
+        if (current_doc() && mx < text_r &&
+            my >= DPI(TITLEBAR_H + MENUBAR_H + TABBAR_H) && my < g_editor.client_h - DPI(STATUSBAR_H)) {
+            spell_suggest_at(mouse_to_pos(mx, my));
+        }
+        InvalidateRect(hwnd, NULL, FALSE);
+        return 0;
+    }
+
     case WM_MOUSEMOVE: {
         int mx = GET_X_LPARAM(lParam);
         int my = GET_Y_LPARAM(lParam);
 
+        if (g_editor.suggest.open) {
+            int hit = spell_suggest_hit(mx, my);
+            if (hit >= 0 && hit != g_editor.suggest.hover) {
+                g_editor.suggest.hover = hit;
+                InvalidateRect(hwnd, NULL, FALSE);
+            }
+        }
+
         /* FAB hover tracking in titlebar (LEFT SIDE) */
         int old_fab_hover = g_editor.fab_hover;
         g_editor.fab_hover = -1;
@@ -1045,6 +1120,11 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         int shift = GetKeyState(VK_SHIFT) & 0x8000;
         int alt = GetKeyState(VK_MENU) & 0x8000;
 
+        if (g_editor.suggest.open) {
+            InvalidateRect(hwnd, NULL, FALSE);
+            if (spell_suggest_key(wParam)) return 0;
+        }
+
         /* Swallow Backspace/Delete while search UI is active —
          * prevent them from editing the document text underneath. */
         if (g_editor.search.active && (wParam == VK_BACK || wParam == VK_DELETE)) {
@@ -1058,6 +1138,13 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
         }
 
+        /* A tab still loading has no text to edit, search or save; only
+         * Escape and the keys that leave it or open another get through */
+        if (doc->loading && wParam != VK_ESCAPE &&
+            !(ctrl && (wParam == VK_TAB || wParam == 'N' ||
+                       wParam == 'O' || wParam == 'W' || wParam == 'T')))
+            return 0;
+
         /* Handle search mode input */
         if (g_editor.search.active && !ctrl) {
             if (wParam == VK_ESCAPE) {
@@ -1423,6 +1510,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
         case VK_RETURN:
             if (g_editor.search.active) return 0;
+            if (doc->is_results && find_in_files_open_at(doc, doc->cursor)) {
+                InvalidateRect(hwnd, NULL, FALSE);
+                return 0;
+            }
             editor_insert_char(L'\n');
             /* Auto-indent in code mode */
             if (doc->mode == MODE_CODE) {
@@ -1499,7 +1590,6 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 }
                 doc->modified = 1;
                 recalc_lines(doc);
-                update_stats(doc);
             } else if (doc->mode == MODE_CODE) {
                 editor_insert_text(L"    ", 4);
             } else {
@@ -1532,7 +1622,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
 
         /* Ctrl shortcuts */
-        case 'A': if (ctrl) { editor_select_all(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
+        case 'A': if (ctrl) { if (shift) search_toggle_all_tabs(); else editor_select_all(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'C': if (ctrl) { editor_copy(); return 0; } break;
         case 'X': if (ctrl) { editor_cut(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'V': if (ctrl) { editor_paste(); editor_ensure_cursor_visible(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
@@ -1542,10 +1632,12 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         case 'O': if (ctrl) { open_file_dialog(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'N': if (ctrl) { new_tab(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'W': if (ctrl) { close_tab(g_editor.active_tab); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
-        case 'F': if (ctrl) { toggle_search(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
+        case 'F': if (ctrl) { if (shift) find_in_files_prompt(); else toggle_search(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'H': if (ctrl) { g_editor.search.active = 1; g_editor.search.replace_active = 1; InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'G': if (ctrl) { search_next(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
+        case 'R': if (ctrl) { search_toggle_regex(); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'M': if (ctrl) { if (shift) { g_editor.show_minimap = !g_editor.show_minimap; } else { toggle_mode(); } InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
+        case 'L': if (ctrl && shift) { follow_toggle(doc); InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'D': if (ctrl) {
             if (shift && doc->mode == MODE_CODE) {
                 /* Ctrl+Shift+D: Duplicate line */
@@ -1614,15 +1706,23 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         } break;
         case 'I': if (ctrl) { g_editor.show_stats_screen = !g_editor.show_stats_screen; InvalidateRect(hwnd, NULL, FALSE); return 0; } break;
         case 'T': if (ctrl) { apply_theme(g_theme_index == 0 ? 1 : 0); return 0; } break;
-        case VK_F7: g_editor.spellcheck_enabled = !g_editor.spellcheck_enabled; InvalidateRect(hwnd, NULL, FALSE); return 0;
+        case VK_F7: spell_toggle(); InvalidateRect(hwnd, NULL, FALSE); return 0;
+        case VK_F8: spell_goto_next(shift ? -1 : 1); InvalidateRect(hwnd, NULL, FALSE); return 0;
+        }
+
+        /* Ctrl+. : Spelling suggestions for the word at the cursor */
+        if (ctrl && wParam == VK_OEM_PERIOD) {
+            spell_suggest_at(doc->cursor);
+            InvalidateRect(hwnd, NULL, FALSE);
+            return 0;
         }
 
         /* Ctrl+Tab */
         if (wParam == VK_TAB && ctrl) {
             if (shift) {
-                g_editor.active_tab = (g_editor.active_tab - 1 + g_editor.tab_count) % g_editor.tab_count;
+                activate_tab((g_editor.active_tab - 1 + g_editor.tab_count) % g_editor.tab_count);
             } else {
-                g_editor.active_tab = (g_editor.active_tab + 1) % g_editor.tab_count;
+                activate_tab((g_editor.active_tab + 1) % g_editor.tab_count);
             }
             InvalidateRect(hwnd, NULL, FALSE);
             return 0;
@@ -1723,6 +1823,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         }
 
         /* Normal text input */
+        Document *doc = current_doc();
+        if (doc && doc->loading) return 0;
         if (c >= 32 && !(GetKeyState(VK_CONTROL) & 0x8000)) {
             editor_insert_char(c);
             editor_ensure_cursor_visible();
@@ -1732,6 +1834,44 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         return 0;
     }
 
+    case WM_SEARCH_RESULTS:
+        search_on_results(lParam);
+        InvalidateRect(hwnd, NULL, FALSE);
+        return 0;
+
+    case WM_SEARCH_TAB_HITS:
+        search_on_tab_hits(lParam);
+        InvalidateRect(hwnd, NULL, FALSE);
+        return 0;
+
+    case WM_FIND_RESULTS:
+        find_in_files_on_results();
+        InvalidateRect(hwnd, NULL, FALSE);
+        return 0;
+
+    case WM_TRI_BUILT:
+        tri_on_built(lParam);
+        return 0;
+
+    case WM_SPELL_RESULTS:
+        spell_on_results(lParam);
+        InvalidateRect(hwnd, NULL, FALSE);
+        return 0;
+
+    case WM_SAVE_DONE:
+        save_on_done();
+        InvalidateRect(hwnd, NULL, FALSE);
+        return 0;
+
+    case WM_FILE_CHANGED:
+        watch_on_change();
+        return 0;
+
+    case WM_FILE_LOADED:
+        load_on_done();
+        InvalidateRect(hwnd, NULL, FALSE);
+        return 0;
+
     case WM_USER + 1: {
         /* Recreate fonts after size change */
         DeleteObject(g_editor.font_main);
@@ -1805,20 +1945,19 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
     case WM_DROPFILES: {
         HDROP hDrop = (HDROP)wParam;
-        wchar_t path[MAX_PATH];
         UINT count = DragQueryFileW(hDrop, 0xFFFFFFFF, NULL, 0);
-        for (UINT i = 0; i < count; i++) {
-            DragQueryFileW(hDrop, i, path, MAX_PATH);
-            Document *doc = doc_create();
-            load_file(doc, path);
-            if (g_editor.tab_count < MAX_TABS) {
-                g_editor.tabs[g_editor.tab_count] = doc;
-                g_editor.active_tab = g_editor.tab_count;
-                g_editor.tab_count++;
-            } else {
-                doc_free(doc);
+        if (count > MAX_TABS) count = MAX_TABS;
+        wchar_t (*paths)[MAX_PATH] = (wchar_t (*)[MAX_PATH])malloc(count * sizeof(*paths));
+        const wchar_t **list = (const wchar_t **)malloc(count * sizeof(*list));
+        if (paths && list) {
+            for (UINT i = 0; i < count; i++) {
+                DragQueryFileW(hDrop, i, paths[i], MAX_PATH);
+                list[i] = paths[i];
             }
+            open_files(list, (int)count);
         }
+        free(paths);
+        free(list);
         DragFinish(hDrop);
         InvalidateRect(hwnd, NULL, FALSE);
         return 0;
@@ -1839,12 +1978,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
     case WM_CLOSE: {
         /* Prompt per-tab for unsaved changes (user can cancel) */
+        save_flush();
         for (int i = 0; i < g_editor.tab_count; i++) {
             if (g_editor.tabs[i]->modified) {
                 if (!prompt_save_doc(i)) return 0; /* cancelled — abort close */
             }
         }
-        /* Clean exit: remove all autosave shadows */
+        /* Clean exit: finish pending writes, then remove all autosave shadows */
+        save_flush();
+        session_save();
         autosave_cleanup_all();
         autosave_cleanup_tmp();
         DestroyWindow(hwnd);